@@ -3,10 +3,12 @@
 #include "mrchem.h"
 #include "LegendreBasis.h"
 #include "InterpolatingBasis.h"
+#include "FunctionTreePool.h"
 
 using namespace std;
 
 MultiResolutionAnalysis<3> *MRA;
+FunctionTreePool<3> *TreePool;
 
 void MREnv::initializeMRCPP(int argc, char **argv) {
 #ifdef HAVE_MPI
@@ -74,7 +76,9 @@ void MREnv::initializeMRCPP(int argc, char **argv) {
 }
 
 void MREnv::finalizeMRCPP(const Timer t) {
-    // Delete global MRA
+    // Delete global tree pool and MRA
+    if (TreePool != 0) delete TreePool;
+    TreePool = 0;
     if (MRA != 0) delete MRA;
     MRA = 0;
 
@@ -124,4 +128,9 @@ void MREnv::initializeMRA() {
         MSG_FATAL("Invalid basis type!");
     }
     MRA->print();
+
+    // Initializing pool of recycled trees, a few idle trees per thread
+    // are enough for the temporaries of the parallel loops
+    size_t poolBytes = 512*1024*1024;
+    TreePool = new FunctionTreePool<3>(*MRA, poolBytes, 2*omp_get_max_threads());
 }
@@ -34,6 +34,7 @@
 #include "HyperFineCoupling.h"
 
 #include "PoissonOperator.h"
+#include "OperatorCache.h"
 #include "ABGVOperator.h"
 #include "PHOperator.h"
 
@@ -142,6 +143,7 @@ SCFDriver::SCFDriver(Getkw &input) {
     file_energy_vec = input.get<string>("Files.energy_vec");
     file_mo_mat_a = input.get<string>("Files.mo_mat_a");
     file_mo_mat_b = input.get<string>("Files.mo_mat_b");
+    file_operator_cache = input.get<string>("Files.operator_cache");
 
     r_O[0] = 0.0;
     r_O[1] = 0.0;
@@ -255,6 +257,9 @@ void SCFDriver::setup() {
     }
 
     // Setting up MW operators
+    if (file_operator_cache != "none") {
+        OperatorCache::setDirectory(file_operator_cache);
+    }
     P = new PoissonOperator(*MRA, rel_prec);
     PH_1 = new PHOperator<3>(*MRA, 1); // first derivative
     PH_2 = new PHOperator<3>(*MRA, 2); // second derivative
@@ -496,7 +501,10 @@ void SCFDriver::setupInitialGroundState() {
             OP(*phi, file_basis_set, file_mo_mat_a, file_mo_mat_b);
         }
     } else if (scf_start == "mw") {
-        NOT_IMPLEMENTED_ABORT;
+        // Restart from orbitals written by a previous calculation
+        if (not phi->loadOrbitals(file_start_orbitals)) {
+            MSG_FATAL("Unable to read orbitals from " << file_start_orbitals);
+        }
     } else {
         NOT_IMPLEMENTED_ABORT;
     }
@@ -650,7 +658,7 @@ bool SCFDriver::runGroundState() {
         delete solver;
     }
 
-    if (scf_write_orbitals) NOT_IMPLEMENTED_ABORT;
+    if (scf_write_orbitals and converged) phi->saveOrbitals(file_final_orbitals);
 
     // Compute requested properties
     if (converged) calcGroundStateProperties();
@@ -181,6 +181,7 @@ protected:
     std::string file_energy_vec;
     std::string file_mo_mat_a;
     std::string file_mo_mat_b;
+    std::string file_operator_cache;
 
     // Gauge origin
     double r_O[3];
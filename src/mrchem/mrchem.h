@@ -12,8 +12,11 @@
 #include "Getkw.h"
 #include "MultiResolutionAnalysis.h"
 
+template<int D> class FunctionTreePool;
+
 extern Getkw Input; //< Default user input
 extern MultiResolutionAnalysis<3> *MRA; //< Default MRA
+extern FunctionTreePool<3> *TreePool; //< Recycled trees on the default MRA
 
 #endif /* MRCHEM_H */
 
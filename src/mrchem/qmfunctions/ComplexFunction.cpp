@@ -1,6 +1,8 @@
 #include "ComplexFunction.h"
+#include "FunctionTreePool.h"
 
 extern MultiResolutionAnalysis<3> *MRA; // Global MRA
+extern FunctionTreePool<3> *TreePool; // Global tree pool
 
 using namespace std;
 
@@ -18,24 +20,44 @@ ComplexFunction<D>& ComplexFunction<D>::operator=(const ComplexFunction<D> &func
 template<int D>
 void ComplexFunction<D>::allocReal() {
     if (this->hasReal()) MSG_ERROR("Function not empty");
-    this->re = new FunctionTree<D>(*MRA);
+    if (TreePool != 0) {
+        this->re = TreePool->get();
+    } else {
+        this->re = new FunctionTree<3>(*MRA);
+    }
 }
 
 template<int D>
 void ComplexFunction<D>::allocImag() {
     if (this->hasImag()) MSG_ERROR("Function not empty");
-    this->im = new FunctionTree<D>(*MRA);
+    if (TreePool != 0) {
+        this->im = TreePool->get();
+    } else {
+        this->im = new FunctionTree<3>(*MRA);
+    }
 }
 
 template<int D>
 void ComplexFunction<D>::clearReal(bool free) {
-    if (this->hasReal() and free) delete this->re;
+    if (this->hasReal() and free) {
+        if (TreePool != 0) {
+            TreePool->put(this->re);
+        } else {
+            delete this->re;
+        }
+    }
     this->re = 0;
 }
 
 template<int D>
 void ComplexFunction<D>::clearImag(bool free) {
-    if (this->hasImag() and free) delete this->im;
+    if (this->hasImag() and free) {
+        if (TreePool != 0) {
+            TreePool->put(this->im);
+        } else {
+            delete this->im;
+        }
+    }
     this->im = 0;
 }
 
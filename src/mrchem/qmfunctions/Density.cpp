@@ -1,10 +1,12 @@
 #include "Density.h"
 #include "FunctionTree.h"
 #include "SerialFunctionTree.h"
+#include "FunctionTreePool.h"
 #include "TelePrompter.h"
 #include "parallel.h"
 
 extern MultiResolutionAnalysis<3> *MRA; // Global MRA
+extern FunctionTreePool<3> *TreePool; // Global tree pool
 
 using namespace std;
 
@@ -32,10 +34,17 @@ Density::~Density() {
 }
 
 void Density::clear() {
-    if (this->hasTotal()) delete this->dens_t;
-    if (this->hasSpin()) delete this->dens_s;
-    if (this->hasAlpha()) delete this->dens_a;
-    if (this->hasBeta()) delete this->dens_b;
+    if (TreePool != 0) {
+        TreePool->put(this->dens_t);
+        TreePool->put(this->dens_s);
+        TreePool->put(this->dens_a);
+        TreePool->put(this->dens_b);
+    } else {
+        if (this->hasTotal()) delete this->dens_t;
+        if (this->hasSpin()) delete this->dens_s;
+        if (this->hasAlpha()) delete this->dens_a;
+        if (this->hasBeta()) delete this->dens_b;
+    }
     this->dens_t = 0;
     this->dens_s = 0;
     this->dens_a = 0;
@@ -67,22 +76,22 @@ void Density::setDensity(int s, FunctionTree<3> *rho) {
 
 void Density::allocTotal() {
     if (this->hasTotal()) MSG_ERROR("Density not empty");
-    this->dens_t = new FunctionTree<3>(*MRA);
+    this->dens_t = TreePool->get();
 }
 
 void Density::allocSpin() {
     if (this->hasSpin()) MSG_ERROR("Density not empty");
-    this->dens_s = new FunctionTree<3>(*MRA);
+    this->dens_s = TreePool->get();
 }
 
 void Density::allocAlpha() {
     if (this->hasAlpha()) MSG_ERROR("Density not empty");
-    this->dens_a = new FunctionTree<3>(*MRA);
+    this->dens_a = TreePool->get();
 }
 
 void Density::allocBeta() {
     if (this->hasBeta()) MSG_ERROR("Density not empty");
-    this->dens_b = new FunctionTree<3>(*MRA);
+    this->dens_b = TreePool->get();
 }
 
 /*
@@ -97,6 +106,13 @@ int Density::printTreeSizes() const {
 */
 
 
+#ifdef HAVE_MPI
+/** MPI tags of the transfer of density tag. Each density gets a block with
+ * the metadata tag followed by one SerialTreeTags block per component. */
+static int getDensityTag(int tag) { return tag*(1 + 3*SerialTreeTags); }
+static int getTreeTag(int tag, int i) { return getDensityTag(tag) + 1 + i*SerialTreeTags; }
+#endif
+
 //send Density with MPI
 void Density::send_Density(int dest, int tag){
 #ifdef HAVE_MPI
@@ -114,22 +130,22 @@ void Density::send_Density(int dest, int tag){
 
   Densinfo.spin = this->isSpinDensity();
   if(this->dens_t){
-    Densinfo.NchunksTotal = this->total().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Densinfo.NchunksTotal = this->total().getSerialFunctionTree()->compact();
   }else{Densinfo.NchunksTotal = 0;}
   if(this->dens_a){
-    Densinfo.NchunksAlpha = this->alpha().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Densinfo.NchunksAlpha = this->alpha().getSerialFunctionTree()->compact();
   }else{Densinfo.NchunksAlpha = 0;}
   if(this->dens_b){
-    Densinfo.NchunksBeta = this->beta().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Densinfo.NchunksBeta = this->beta().getSerialFunctionTree()->compact();
   }else{Densinfo.NchunksBeta = 0;}
  
 
   int count=sizeof(Metadata);
-  MPI_Send(&Densinfo, count, MPI_BYTE, dest, tag, comm);
+  MPI_Send(&Densinfo, count, MPI_BYTE, dest, getDensityTag(tag), comm);
  
-  if(this->hasTotal())Send_SerialTree(this->dens_t, Densinfo.NchunksTotal, dest, tag+10000, comm);
-  if(this->hasAlpha())Send_SerialTree(this->dens_a, Densinfo.NchunksAlpha, dest, tag+20000, comm);
-  if(this->hasBeta())Send_SerialTree(this->dens_b, Densinfo.NchunksBeta, dest, tag+30000, comm);
+  if(this->hasTotal())Send_SerialTree(this->dens_t, Densinfo.NchunksTotal, dest, getTreeTag(tag, 0), comm);
+  if(this->hasAlpha())Send_SerialTree(this->dens_a, Densinfo.NchunksAlpha, dest, getTreeTag(tag, 1), comm);
+  if(this->hasBeta())Send_SerialTree(this->dens_b, Densinfo.NchunksBeta, dest, getTreeTag(tag, 2), comm);
 
 #endif
 }
@@ -150,7 +166,7 @@ void Density::Rcv_Density(int source, int tag){
   Metadata Densinfo;
 
   int count=sizeof(Metadata);
-  MPI_Recv(&Densinfo, count, MPI_BYTE, source, tag, comm, &status);
+  MPI_Recv(&Densinfo, count, MPI_BYTE, source, getDensityTag(tag), comm, &status);
 
   assert(this->isSpinDensity() == Densinfo.spin);
 
@@ -159,19 +175,19 @@ void Density::Rcv_Density(int source, int tag){
       //We must have a tree defined for receiving nodes. Define one:
       this->dens_t = new FunctionTree<3>(*MRA,MaxAllocNodes);
     }
-    Rcv_SerialTree(this->dens_t, Densinfo.NchunksTotal, source, tag+10000, comm);}
+    Rcv_SerialTree(this->dens_t, Densinfo.NchunksTotal, source, getTreeTag(tag, 0), comm);}
   if(Densinfo.NchunksAlpha>0){
     if(not this->hasAlpha()){
       //We must have a tree defined for receiving nodes. Define one:
       this->dens_a = new FunctionTree<3>(*MRA,MaxAllocNodes);
     }
-    Rcv_SerialTree(this->dens_a, Densinfo.NchunksAlpha, source, tag+20000, comm);}
+    Rcv_SerialTree(this->dens_a, Densinfo.NchunksAlpha, source, getTreeTag(tag, 1), comm);}
   if(Densinfo.NchunksBeta>0){
     if(not this->hasBeta()){
       //We must have a tree defined for receiving nodes. Define one:
       this->dens_b = new FunctionTree<3>(*MRA,MaxAllocNodes);
     }
-    Rcv_SerialTree(this->dens_b, Densinfo.NchunksBeta, source, tag+30000, comm);}
+    Rcv_SerialTree(this->dens_b, Densinfo.NchunksBeta, source, getTreeTag(tag, 2), comm);}
   
 #endif
 }
@@ -2,8 +2,10 @@
 #include "OrbitalVector.h"
 #include "Density.h"
 #include "SerialFunctionTree.h"
+#include "FunctionTreePool.h"
 
-extern MultiResolutionAnalysis<3> *MRA;
+extern MultiResolutionAnalysis<3> *MRA; // Global MRA
+extern FunctionTreePool<3> *TreePool;
 
 using namespace std;
 
@@ -32,64 +34,70 @@ void DensityProjector::operator()(Density &rho, Orbital &phi) {
 
     FunctionTreeVector<3> sum_vec;
     if (phi.hasReal()) {
-        FunctionTree<3> *real_2 = new FunctionTree<3>(*MRA);
+        FunctionTree<3> *real_2 = TreePool->get();
         this->grid(*real_2, phi.real());
         this->mult(*real_2, occ, phi.real(), phi.real(), 1);
         sum_vec.push_back(real_2);
     }
     if (phi.hasImag()) {
-        FunctionTree<3> *imag_2 = new FunctionTree<3>(*MRA);
+        FunctionTree<3> *imag_2 = TreePool->get();
         this->grid(*imag_2, phi.imag());
         this->mult(*imag_2, occ, phi.imag(), phi.imag(), 1);
         sum_vec.push_back(imag_2);
     }
 
+    // All density components share the union grid of the squared parts
+    UnionGrid<3> sum_grid(*MRA, this->grid.getMaxScale());
+    sum_grid.add(sum_vec);
     if (rho.isSpinDensity()) {
         if (phi.getSpin() == Orbital::Paired) {
             rho.allocAlpha();
             rho.allocBeta();
-            this->grid(rho.alpha(), sum_vec);
-            this->grid(rho.beta(), sum_vec);
+            sum_grid.stamp(rho.alpha());
+            sum_grid.stamp(rho.beta());
             this->add(rho.alpha(), sum_vec, 0);
             this->add(rho.beta(), sum_vec, 0);
         }
         if (phi.getSpin() == Orbital::Alpha) {
             rho.allocAlpha();
-            this->grid(rho.alpha(), sum_vec);
+            sum_grid.stamp(rho.alpha());
             this->add(rho.alpha(), sum_vec, 0);
 
             rho.allocBeta();
-            this->grid(rho.beta(), sum_vec);
+            sum_grid.stamp(rho.beta());
             rho.beta().setZero();
         }
         if (phi.getSpin() == Orbital::Beta) {
             rho.allocBeta();
-            this->grid(rho.beta(), sum_vec);
+            sum_grid.stamp(rho.beta());
             this->add(rho.beta(), sum_vec, 0);
 
             rho.allocAlpha();
-            this->grid(rho.alpha(), sum_vec);
+            sum_grid.stamp(rho.alpha());
             rho.alpha().setZero();
         }
         FunctionTreeVector<3> tot_vec;
         tot_vec.push_back(1.0, &rho.alpha());
         tot_vec.push_back(1.0, &rho.beta());
         rho.allocTotal();
-        this->grid(rho.total(), tot_vec);
+        sum_grid.stamp(rho.total());
         this->add(rho.total(), tot_vec, 0);
 
         FunctionTreeVector<3> spin_vec;
         spin_vec.push_back( 1.0, &rho.alpha());
         spin_vec.push_back(-1.0, &rho.beta());
         rho.allocSpin();
-        this->grid(rho.spin(), spin_vec);
+        sum_grid.stamp(rho.spin());
         this->add(rho.spin(), spin_vec, 0);
     } else {
         rho.allocTotal();
-        this->grid(rho.total(), sum_vec);
+        sum_grid.stamp(rho.total());
         this->add(rho.total(), sum_vec, 0);
     }
-    sum_vec.clear(true);
+    for (int i = 0; i < sum_vec.size(); i++) {
+        TreePool->put(sum_vec[i]);
+    }
+    sum_vec.clear(false);
 }
 
 void DensityProjector::operator()(Density &rho, OrbitalVector &phi) {
@@ -69,6 +69,100 @@ double NuclearFunction::evalf(const double *x) const {
     return result;
 }
 
+/** Batched evaluation, looping over nuclei in the outer loop.
+ *
+ * The potential is split into the bare Coulomb term -Z/r, which is summed
+ * over all nuclei, and the short range smoothing correction. The correction
+ * is below machine precision beyond six smoothing lengths, and is only
+ * computed for the nuclei that are that close to the points. */
+void NuclearFunction::evalfBatch(const double *points, int nPoints, double *values) const {
+    for (int n = 0; n < nPoints; n++) {
+        values[n] = 0.0;
+    }
+    for (int i = 0; i < this->x_coords.size(); i++) {
+        double x_i = this->x_coords[i];
+        double y_i = this->y_coords[i];
+        double z_i = this->z_coords[i];
+        double Z_i = this->charges[i];
+        for (int n = 0; n < nPoints; n++) {
+            const double *r = points + 3*n;
+            double dx = r[0] - x_i;
+            double dy = r[1] - y_i;
+            double dz = r[2] - z_i;
+            values[n] -= Z_i/sqrt(dx*dx + dy*dy + dz*dz);
+        }
+    }
+
+    double lb[3], ub[3];
+    for (int d = 0; d < 3; d++) {
+        lb[d] = points[d];
+        ub[d] = points[d];
+        for (int n = 1; n < nPoints; n++) {
+            lb[d] = min(lb[d], points[3*n + d]);
+            ub[d] = max(ub[d], points[3*n + d]);
+        }
+    }
+    vector<int> nucs;
+    getNuclei(lb, ub, nucs);
+    for (int j = 0; j < nucs.size(); j++) {
+        int i = nucs[j];
+        double x_i = this->x_coords[i];
+        double y_i = this->y_coords[i];
+        double z_i = this->z_coords[i];
+        double S_inv = 1.0/this->smoothParam[i];
+        double Z_S = this->charges[i]*S_inv;
+        for (int n = 0; n < nPoints; n++) {
+            const double *r = points + 3*n;
+            double dx = r[0] - x_i;
+            double dy = r[1] - y_i;
+            double dz = r[2] - z_i;
+            double r1 = sqrt(dx*dx + dy*dy + dz*dz)*S_inv;
+            if (r1 >= 6.0) continue;
+            double r2 = r1*r1;
+            double partResult = erfc(r1)/r1;
+            partResult += this->const_fac*(exp(-r2) + 16.0*exp(-4.0*r2));
+            values[n] += Z_S*partResult;
+        }
+    }
+}
+
+/** Distribute the smoothing regions (six smoothing lengths around each
+ * nucleus) on a cell list, so that the nuclei close to a node are found
+ * without looping over all nuclei. */
+void NuclearFunction::setupScreening() {
+    int nNucs = this->x_coords.size();
+    vector<double> lb(3*nNucs);
+    vector<double> ub(3*nNucs);
+    vector<const double *> lower;
+    vector<const double *> upper;
+    for (int i = 0; i < nNucs; i++) {
+        double R[3] = {this->x_coords[i], this->y_coords[i], this->z_coords[i]};
+        for (int d = 0; d < 3; d++) {
+            lb[3*i + d] = R[d] - 6.0*this->smoothParam[i];
+            ub[3*i + d] = R[d] + 6.0*this->smoothParam[i];
+        }
+        lower.push_back(&lb[3*i]);
+        upper.push_back(&ub[3*i]);
+    }
+    this->cellList.build(lower, upper);
+}
+
+/** Collect (in increasing order) the nuclei whose smoothing region may
+ * overlap [lb, ub], or all nuclei if screening is not set up. */
+void NuclearFunction::getNuclei(const double *lb,
+                                const double *ub,
+                                vector<int> &nucs) const {
+    int nNucs = this->x_coords.size();
+    if (this->cellList.getNItems() == nNucs) {
+        this->cellList.query(lb, ub, nucs);
+    } else {
+        nucs.clear();
+        for (int i = 0; i < nNucs; i++) {
+            nucs.push_back(i);
+        }
+    }
+}
+
 bool NuclearFunction::isVisibleAtScale(int scale, int nQuadPts) const {
     double minSmooth = this->smoothParam[0];
     for (int i = 1; i < this->smoothParam.size(); i++) {
@@ -85,9 +179,11 @@ bool NuclearFunction::isVisibleAtScale(int scale, int nQuadPts) const {
 }
 
 bool NuclearFunction::isZeroOnInterval(const double *a, const double *b) const {
-    int nNucs = this->x_coords.size();
+    vector<int> nucs;
+    getNuclei(a, b, nucs);
     int totSplit = 0;
-    for (int i = 0; i < nNucs; i++) {
+    for (int j = 0; j < nucs.size(); j++) {
+        int i = nucs[j];
         double x_i = this->x_coords[i];
         double y_i = this->y_coords[i];
         double z_i = this->z_coords[i];
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "RepresentableFunction.h"
+#include "CellList.h"
 
 class Nuclei;
 class Nucleus;
@@ -19,6 +20,10 @@ public:
     void push_back(double Z, const double *R, double S);
 
     double evalf(const double *r) const;
+    void evalfBatch(const double *points, int nPoints, double *values) const;
+
+    void setupScreening();
+    void clearScreening() { this->cellList.clear(); }
 
     bool isVisibleAtScale(int scale, int nQuadPts) const;
     bool isZeroOnInterval(const double *a, const double *b) const;
@@ -30,6 +35,9 @@ protected:
     std::vector<double> x_coords;
     std::vector<double> y_coords;
     std::vector<double> z_coords;
+    CellList<3> cellList;   ///< Smoothing regions, only set up during projection
+
+    void getNuclei(const double *lb, const double *ub, std::vector<int> &nucs) const;
 };
 
 #endif // NUCLEARFUNCTION_H
@@ -86,6 +86,15 @@ complex<double> Orbital::dot(Orbital &ket) {
     return ComplexFunction<3>::dot(ket);
 }
 
+#ifdef HAVE_MPI
+/** MPI tags of the transfer of orbital tag. Each orbital gets a block with
+ * the metadata tag followed by one SerialTreeTags block per component, so
+ * transfers of different orbitals never share a tag. */
+static int getOrbitalTag(int tag) { return tag*(1 + 2*SerialTreeTags); }
+static int getRealTag(int tag) { return getOrbitalTag(tag) + 1; }
+static int getImagTag(int tag) { return getOrbitalTag(tag) + 1 + SerialTreeTags; }
+#endif
+
 //send an orbital with MPI
 void Orbital::send_Orbital(int dest, int tag){
 #ifdef HAVE_MPI
@@ -106,17 +115,17 @@ void Orbital::send_Orbital(int dest, int tag){
   Orbinfo.occupancy=this->getOccupancy();
   Orbinfo.error=this->getError();
   if(this->hasReal()){
-    Orbinfo.NchunksReal = this->real().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Orbinfo.NchunksReal = this->real().getSerialFunctionTree()->compact();
   }else{Orbinfo.NchunksReal = 0;}
   if(this->hasImag()){
-    Orbinfo.NchunksImag = this->imag().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Orbinfo.NchunksImag = this->imag().getSerialFunctionTree()->compact();
   }else{Orbinfo.NchunksImag = 0;}
   
   int count=sizeof(Metadata);
-  MPI_Send(&Orbinfo, count, MPI_BYTE, dest, 0, comm);
+  MPI_Send(&Orbinfo, count, MPI_BYTE, dest, getOrbitalTag(tag), comm);
   
-  if(this->hasReal())Send_SerialTree(&this->real(), Orbinfo.NchunksReal, dest, tag, comm);
-  if(this->hasImag())Send_SerialTree(&this->imag(), Orbinfo.NchunksImag, dest, tag*10000, comm);
+  if(this->hasReal())Send_SerialTree(&this->real(), Orbinfo.NchunksReal, dest, getRealTag(tag), comm);
+  if(this->hasImag())Send_SerialTree(&this->imag(), Orbinfo.NchunksImag, dest, getImagTag(tag), comm);
   
 #endif
 }
@@ -141,18 +150,22 @@ void Orbital::Isend_Orbital(int dest, int tag){
   Orbinfo.occupancy=this->getOccupancy();
   Orbinfo.error=this->getError();
   if(this->hasReal()){
-    Orbinfo.NchunksReal = this->real().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Orbinfo.NchunksReal = this->real().getSerialFunctionTree()->compact();
   }else{Orbinfo.NchunksReal = 0;}
   if(this->hasImag()){
-    Orbinfo.NchunksImag = this->imag().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+    Orbinfo.NchunksImag = this->imag().getSerialFunctionTree()->compact();
   }else{Orbinfo.NchunksImag = 0;}
   
-  MPI_Request request;
+  std::vector<MPI_Request> requests(1);
   int count=sizeof(Metadata);
-  MPI_Isend(&Orbinfo, count, MPI_BYTE, dest, 0, comm, &request);
+  MPI_Isend(&Orbinfo, count, MPI_BYTE, dest, getOrbitalTag(tag), comm, &requests[0]);
   
-  if(this->hasReal())ISend_SerialTree(&this->real(), Orbinfo.NchunksReal, dest, tag, comm);
-  if(this->hasImag())ISend_SerialTree(&this->imag(), Orbinfo.NchunksImag, dest, tag*10000, comm);
+  if(this->hasReal())ISend_SerialTree(&this->real(), Orbinfo.NchunksReal, dest, getRealTag(tag), comm, requests);
+  if(this->hasImag())ISend_SerialTree(&this->imag(), Orbinfo.NchunksImag, dest, getImagTag(tag), comm, requests);
+
+  //the metadata is on the stack, and the trees must not change before the
+  //sends are completed
+  MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
   
 #endif
 }
@@ -173,7 +186,7 @@ void Orbital::Rcv_Orbital(int source, int tag){
   Metadata Orbinfo;
 
   int count=sizeof(Metadata);
-  MPI_Recv(&Orbinfo, count, MPI_BYTE, source, 0, comm, &status);
+  MPI_Recv(&Orbinfo, count, MPI_BYTE, source, getOrbitalTag(tag), comm, &status);
   this->setSpin(Orbinfo.spin);
   this->setOccupancy(Orbinfo.occupancy);
   this->setError(Orbinfo.error);
@@ -183,14 +196,14 @@ void Orbital::Rcv_Orbital(int source, int tag){
       //We must have a tree defined for receiving nodes. Define one:
       this->allocReal();
     }
-    Rcv_SerialTree(&this->real(), Orbinfo.NchunksReal, source, tag, comm);}
+    Rcv_SerialTree(&this->real(), Orbinfo.NchunksReal, source, getRealTag(tag), comm);}
 
   if(Orbinfo.NchunksImag>0){
     if(not this->hasImag()){
       //We must have a tree defined for receiving nodes. Define one:
       this->allocImag();
     }
-    Rcv_SerialTree(&this->imag(), Orbinfo.NchunksImag, source, tag*10000, comm);
+    Rcv_SerialTree(&this->imag(), Orbinfo.NchunksImag, source, getImagTag(tag), comm);
   }else{
     //&(this->imag())=0;
   }
@@ -217,7 +230,7 @@ void Orbital::IRcv_Orbital(int source, int tag){
   MPI_Request request;
 
   int count=sizeof(Metadata);
-  MPI_Irecv(&Orbinfo, count, MPI_BYTE, source, 0, comm, &request);
+  MPI_Irecv(&Orbinfo, count, MPI_BYTE, source, getOrbitalTag(tag), comm, &request);
 
   this->setSpin(Orbinfo.spin);
   this->setOccupancy(Orbinfo.occupancy);
@@ -228,14 +241,14 @@ void Orbital::IRcv_Orbital(int source, int tag){
       //We must have a tree defined for receiving nodes. Define one:
       this->allocReal();
     }
-    IRcv_SerialTree(&this->real(), Orbinfo.NchunksReal, source, tag, comm);}
+    IRcv_SerialTree(&this->real(), Orbinfo.NchunksReal, source, getRealTag(tag), comm);}
 
   if(Orbinfo.NchunksImag>0){
     if(not this->hasImag()){
       //We must have a tree defined for receiving nodes. Define one:
       this->allocImag();
     }
-    IRcv_SerialTree(&this->imag(), Orbinfo.NchunksImag, source, tag*10000, comm);
+    IRcv_SerialTree(&this->imag(), Orbinfo.NchunksImag, source, getImagTag(tag), comm);
   }else{
     //&(this->imag())=0;
   }
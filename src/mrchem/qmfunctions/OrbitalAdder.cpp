@@ -1,6 +1,7 @@
 #include "OrbitalAdder.h"
 #include "OrbitalVector.h"
 #include "Orbital.h"
+#include "MWRotator.h"
 
 using namespace std;
 using namespace Eigen;
@@ -234,18 +235,87 @@ void OrbitalAdder::rotate_P(OrbitalVector &out, const MatrixXd &U, OrbitalVector
  
 }
 
+/** Rotation of an orbital set: out_i = sum_j U_ij inp_j
+ *
+ * The real and imaginary parts are rotated separately, each with a single
+ * MWRotator pass over the union grid of the inputs, instead of one adaptive
+ * addition per output orbital.
+ */
 void OrbitalAdder::rotate(OrbitalVector &out, const MatrixXd &U, OrbitalVector &inp) {
     if (U.cols() != inp.size()) MSG_ERROR("Invalid arguments");
     if (U.rows() < out.size()) MSG_ERROR("Invalid arguments");
     if(MPI_size>1){
       rotate_P(out, U, inp);
     }else{
-      for (int i = 0; i < out.size(); i++) {
-        const VectorXd &c = U.row(i);
+        double prec = this->add.getPrecision();
+        if (prec < 0.0) MSG_ERROR("Negative adaptive prec");
+
+        for (int i = 0; i < out.size(); i++) {
+            Orbital &out_i = out.getOrbital(i);
+            if (out_i.hasReal() or out_i.hasImag()) MSG_ERROR("Output not empty");
+            // set output spin
+            for (int j = 0; j < inp.size(); j++) {
+                if (fabs(U(i,j)) < MachineZero) continue;
+                if (inp[j]->getOccupancy() == 0) continue;
+                out_i.setSpin(inp[j]->getSpin());
+                break;
+            }
+            // sanity check spin
+            for (int j = 0; j < inp.size(); j++) {
+                if (fabs(U(i,j)) < MachineZero) continue;
+                if (inp[j]->getOccupancy() == 0) continue;
+                if (out_i.getSpin() != inp[j]->getSpin()) MSG_FATAL("Mixing spins");
+            }
+        }
+        rotateComponent(out, U, inp, true);
+        rotateComponent(out, U, inp, false);
+    }
+}
+
+/** Rotate either the real or the imaginary parts of an orbital set
+ *
+ * Only output orbitals with a non-zero contribution get the part allocated.
+ */
+void OrbitalAdder::rotateComponent(OrbitalVector &out, const MatrixXd &U,
+                                   OrbitalVector &inp, bool real) {
+    FunctionTreeVector<3> inp_vec;
+    vector<int> inp_idx;
+    for (int j = 0; j < inp.size(); j++) {
+        Orbital &phi_j = inp.getOrbital(j);
+        if (real and phi_j.hasReal()) inp_vec.push_back(&phi_j.real());
+        if (not real and phi_j.hasImag()) inp_vec.push_back(&phi_j.imag());
+        if (inp_vec.size() > inp_idx.size()) inp_idx.push_back(j);
+    }
+    if (inp_vec.size() == 0) return;
+
+    FunctionTreeVector<3> out_vec;
+    vector<int> out_idx;
+    for (int i = 0; i < out.size(); i++) {
+        bool contrib = false;
+        for (int k = 0; k < inp_idx.size(); k++) {
+            if (fabs(U(i,inp_idx[k])) > MachineZero) contrib = true;
+        }
+        if (not contrib) continue;
         Orbital &out_i = out.getOrbital(i);
-        (*this)(out_i, c, inp, false); // Adaptive grids
-      }
+        if (real) {
+            out_i.allocReal();
+            out_vec.push_back(&out_i.real());
+        } else {
+            out_i.allocImag();
+            out_vec.push_back(&out_i.imag());
+        }
+        out_idx.push_back(i);
+    }
+    if (out_vec.size() == 0) return;
+
+    MatrixXd U_sub(out_idx.size(), inp_idx.size());
+    for (int i = 0; i < out_idx.size(); i++) {
+        for (int j = 0; j < inp_idx.size(); j++) {
+            U_sub(i,j) = U(out_idx[i], inp_idx[j]);
+        }
     }
+    MWRotator<3> rot(this->add.getPrecision(), this->add.getMaxScale());
+    rot(out_vec, U_sub, inp_vec);
 }
 
 /** In place rotation of orbital vector */
@@ -54,6 +54,9 @@ public:
 protected:
     MWAdder<3> add;
     GridGenerator<3> grid;
+
+    void rotateComponent(OrbitalVector &out, const Eigen::MatrixXd &U,
+                         OrbitalVector &inp, bool real);
 };
 
 #endif // ORBITALADDER_H
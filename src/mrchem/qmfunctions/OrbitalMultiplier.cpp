@@ -39,15 +39,13 @@ void OrbitalMultiplier::calcRealPart(Orbital &phi_ab,
     FunctionTreeVector<3> vec;
     if (phi_a.hasReal() and phi_b.hasReal()) {
         FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
-        this->grid(*tree, phi_a.real());
-        this->grid(*tree, phi_b.real());
+        this->grid(*tree, phi_a.real(), phi_b.real());
         this->mult(*tree, c, phi_a.real(), phi_b.real(), 0);
         vec.push_back(1.0, tree);
     }
     if (phi_a.hasImag() and phi_b.hasImag()) {
         FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
-        this->grid(*tree, phi_a.imag());
-        this->grid(*tree, phi_b.imag());
+        this->grid(*tree, phi_a.imag(), phi_b.imag());
         this->mult(*tree, c, phi_a.imag(), phi_b.imag(), 0);
         vec.push_back(-1.0, tree);
     }
@@ -77,15 +75,13 @@ void OrbitalMultiplier::calcImagPart(Orbital &phi_ab,
     FunctionTreeVector<3> vec;
     if (phi_a.hasReal() and phi_b.hasImag()) {
         FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
-        this->grid(*tree, phi_a.real());
-        this->grid(*tree, phi_b.imag());
+        this->grid(*tree, phi_a.real(), phi_b.imag());
         this->mult(*tree, c, phi_a.real(), phi_b.imag(), 0);
         vec.push_back(1.0, tree);
     }
     if (phi_a.hasImag() and phi_b.hasReal()) {
         FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
-        this->grid(*tree, phi_a.imag());
-        this->grid(*tree, phi_b.real());
+        this->grid(*tree, phi_a.imag(), phi_b.real());
         this->mult(*tree, c, phi_a.imag(), phi_b.real(), 0);
         if (adjoint) {
             vec.push_back(-1.0, tree);
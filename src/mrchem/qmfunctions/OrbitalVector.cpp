@@ -1,9 +1,14 @@
+#include <fstream>
+#include <sstream>
+#include <cstring>
 #include <Eigen/Eigenvalues>
 
 #include "OrbitalVector.h"
 #include "Orbital.h"
 #include "FunctionTree.h"
 #include "SerialFunctionTree.h"
+#include "FunctionTreeVector.h"
+#include "MWOverlap.h"
 #include "parallel.h"
 #include "Timer.h"
 
@@ -98,6 +103,7 @@ OrbitalVector& OrbitalVector::operator=(const OrbitalVector &inp) {
  * Deletes all orbitals in the vector
  */
 OrbitalVector::~OrbitalVector() {
+    waitSends();
     for (int i = 0; i < this->size(); i++) {
         if (this->orbitals[i] != 0) {
             delete this->orbitals[i];
@@ -493,20 +499,74 @@ MatrixXcd OrbitalVector::calcOverlapMatrix() {
     }
 }
 
-/** Calculate overlap matrix between two orbital sets */
+/** Collect the real and imaginary parts of an orbital set
+ *
+ * Returns the position of each part in the tree vector, or -1 if missing.
+ */
+static void collectOrbitalTrees(OrbitalVector &orbs,
+                                FunctionTreeVector<3> &trees,
+                                VectorXi &re_idx,
+                                VectorXi &im_idx) {
+    re_idx = VectorXi::Constant(orbs.size(), -1);
+    im_idx = VectorXi::Constant(orbs.size(), -1);
+    for (int i = 0; i < orbs.size(); i++) {
+        Orbital &orb_i = orbs.getOrbital(i);
+        if (orb_i.hasReal()) {
+            re_idx(i) = trees.size();
+            trees.push_back(&orb_i.real());
+        }
+        if (orb_i.hasImag()) {
+            im_idx(i) = trees.size();
+            trees.push_back(&orb_i.imag());
+        }
+    }
+}
+
+/** Calculate overlap matrix between two orbital sets
+ *
+ * All real and imaginary parts are handled by a single MWOverlap, which
+ * traverses the trees once and computes the inner products of all
+ * functions present at a node at once. Within one set only half the
+ * (symmetric) real overlap matrix is computed.
+ */
 MatrixXcd OrbitalVector::calcOverlapMatrix(OrbitalVector &ket) {
     OrbitalVector &bra = *this;
     Timer tottime;
+    bool symmetric = (&bra == &ket);
+
+    VectorXi bra_re, bra_im, ket_re, ket_im;
+    FunctionTreeVector<3> bra_trees, ket_trees;
+    collectOrbitalTrees(bra, bra_trees, bra_re, bra_im);
+
+    MWOverlap<3> overlap;
+    MatrixXd S_tree;
+    if (symmetric) {
+        ket_re = bra_re;
+        ket_im = bra_im;
+        S_tree = overlap(bra_trees);
+    } else {
+        collectOrbitalTrees(ket, ket_trees, ket_re, ket_im);
+        S_tree = overlap(bra_trees, ket_trees);
+    }
+
     MatrixXcd S = MatrixXcd::Zero(bra.size(), ket.size());
     for (int i = 0; i < bra.size(); i++) {
-        Orbital &bra_i = bra.getOrbital(i);
+        int bra_spin = bra.getOrbital(i).getSpin();
         for (int j = 0; j < ket.size(); j++) {
-            Orbital &ket_j = ket.getOrbital(j);
-            S(i,j) = bra_i.dot(ket_j);
+            int ket_spin = ket.getOrbital(j).getSpin();
+            if ((bra_spin == Orbital::Alpha) and (ket_spin == Orbital::Beta)) continue;
+            if ((bra_spin == Orbital::Beta) and (ket_spin == Orbital::Alpha)) continue;
+            double rDot = 0.0;
+            double iDot = 0.0;
+            if (bra_re(i) >= 0 and ket_re(j) >= 0) rDot += S_tree(bra_re(i), ket_re(j));
+            if (bra_im(i) >= 0 and ket_im(j) >= 0) rDot += S_tree(bra_im(i), ket_im(j));
+            if (bra_re(i) >= 0 and ket_im(j) >= 0) iDot += S_tree(bra_re(i), ket_im(j));
+            if (bra_im(i) >= 0 and ket_re(j) >= 0) iDot -= S_tree(bra_im(i), ket_re(j));
+            S(i,j) = complex<double>(rDot, iDot);
         }
     }
     tottime.stop();
-     return S;
+    return S;
 }
 
 /** Calculate overlap matrix between two orbital sets using MPI*/
@@ -637,6 +697,128 @@ int OrbitalVector::printTreeSizes() const {
 }
 */
 
+/** Header of the binary orbital file, followed by one entry per orbital */
+struct OrbitalFileHeader {
+    char magic[8];
+    int version;
+    int nOrbs;
+};
+
+struct OrbitalFileEntry {
+    int spin;
+    int occupancy;
+    int hasReal;
+    int hasImag;
+    double error;
+};
+
+static const char orbFileMagic[8] = {'M','R','O','R','B','S','\0','\0'};
+static const int orbFileVersion = 1;
+
+static string getOrbitalFileName(const string &file) {
+    ostringstream fname;
+    fname << file;
+    if (MPI_size > 1) fname << "-" << MPI_rank;
+    fname << ".orb";
+    return fname.str();
+}
+
+/** Write all orbitals to one binary file, for restart
+ *
+ * Spin, occupancy and error of each orbital is written, followed
+ * by the real and imaginary function trees. Argument file name will
+ * get a ".orb" file extension, and in MPI an additional "-[rank]".
+ * Only the orbitals that are available on this rank are stored.
+ */
+bool OrbitalVector::saveOrbitals(const string &file) {
+    Timer timer;
+    string fname = getOrbitalFileName(file);
+    ofstream out(fname.c_str(), ios::binary);
+    if (not out.is_open()) {
+        MSG_ERROR("Unable to open file " << fname);
+        return false;
+    }
+
+    OrbitalFileHeader header;
+    for (int i = 0; i < 8; i++) header.magic[i] = orbFileMagic[i];
+    header.version = orbFileVersion;
+    header.nOrbs = this->size();
+    out.write((const char *) &header, sizeof(OrbitalFileHeader));
+
+    for (int i = 0; i < this->size(); i++) {
+        Orbital &orb = getOrbital(i);
+        OrbitalFileEntry entry;
+        entry.spin = orb.getSpin();
+        entry.occupancy = orb.getOccupancy();
+        entry.hasReal = orb.hasReal();
+        entry.hasImag = orb.hasImag();
+        entry.error = orb.getError();
+        out.write((const char *) &entry, sizeof(OrbitalFileEntry));
+        if (orb.hasReal() and not orb.real().saveTree(out)) return false;
+        if (orb.hasImag() and not orb.imag().saveTree(out)) return false;
+    }
+    timer.stop();
+    println(0, " Orbitals written to " << fname << " in " << timer.getWallTime() << " sec");
+    return out.good();
+}
+
+/** Read orbitals from a file written by saveOrbitals
+ *
+ * The file must contain the same number of orbitals as this set.
+ * Existing functions are discarded, and spin, occupancy and error
+ * are taken from the file. The orbitals must be read with the same
+ * MRA as they were written.
+ */
+bool OrbitalVector::loadOrbitals(const string &file) {
+    Timer timer;
+    string fname = getOrbitalFileName(file);
+    ifstream in(fname.c_str(), ios::binary);
+    if (not in.is_open()) {
+        MSG_ERROR("Unable to open file " << fname);
+        return false;
+    }
+
+    OrbitalFileHeader header;
+    in.read((char *) &header, sizeof(OrbitalFileHeader));
+    if (not in.good() or memcmp(header.magic, orbFileMagic, 8) != 0) {
+        MSG_ERROR("Invalid orbital file " << fname);
+        return false;
+    }
+    if (header.version != orbFileVersion) {
+        MSG_ERROR("Unsupported orbital file version " << header.version);
+        return false;
+    }
+    if (header.nOrbs != this->size()) {
+        MSG_ERROR("Size mismatch, file contains " << header.nOrbs << " orbitals");
+        return false;
+    }
+
+    for (int i = 0; i < this->size(); i++) {
+        Orbital &orb = getOrbital(i);
+        orb.clear();
+        OrbitalFileEntry entry;
+        in.read((char *) &entry, sizeof(OrbitalFileEntry));
+        if (not in.good()) {
+            MSG_ERROR("Error reading orbital " << i);
+            return false;
+        }
+        orb.setSpin(entry.spin);
+        orb.setOccupancy(entry.occupancy);
+        orb.setError(entry.error);
+        if (entry.hasReal) {
+            orb.allocReal();
+            if (not orb.real().loadTree(in)) return false;
+        }
+        if (entry.hasImag) {
+            orb.allocImag();
+            if (not orb.imag().loadTree(in)) return false;
+        }
+    }
+    timer.stop();
+    println(0, " Orbitals read from " << fname << " in " << timer.getWallTime() << " sec");
+    return true;
+}
+
 
 struct Metadata{
   int Norbitals;
@@ -648,6 +830,15 @@ struct Metadata{
   double error[workOrbVecSize];
 };
 
+#ifdef HAVE_MPI
+/** MPI tags of orbital vector transfer tag. Each transfer gets a block with
+ * the metadata tag followed by one SerialTreeTags block per component of
+ * the workOrbVecSize orbitals, so no two trees share a tag. */
+static int getOrbVecTag(int tag) { return tag*(1 + 2*workOrbVecSize*SerialTreeTags); }
+static int getRealTag(int tag, int i) { return getOrbVecTag(tag) + 1 + 2*i*SerialTreeTags; }
+static int getImagTag(int tag, int i) { return getOrbVecTag(tag) + 1 + (2*i + 1)*SerialTreeTags; }
+#endif
+
 //send an orbitalvector with MPI
 void OrbitalVector::send_OrbVec(int dest, int tag, int* OrbsIx, int start, int maxcount){
 #ifdef HAVE_MPI
@@ -666,22 +857,22 @@ void OrbitalVector::send_OrbVec(int dest, int tag, int* OrbsIx, int start, int m
     Orbinfo.occupancy[i_out] = orb_i->getOccupancy();
     Orbinfo.error[i_out] = orb_i->getError();
     if(orb_i->hasReal()){
-      Orbinfo.NchunksReal[i_out] = orb_i->real().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+      Orbinfo.NchunksReal[i_out] = orb_i->real().getSerialFunctionTree()->compact();
     }else{Orbinfo.NchunksReal[i_out] = 0;}
     if(orb_i->hasImag()){
-      Orbinfo.NchunksImag[i_out] = orb_i->imag().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+      Orbinfo.NchunksImag[i_out] = orb_i->imag().getSerialFunctionTree()->compact();
     }else{Orbinfo.NchunksImag[i_out] = 0;}
     Orbinfo.Ix[i_out] = OrbsIx[i];
   }
 
   int count=sizeof(Metadata);
-  MPI_Send(&Orbinfo, count, MPI_BYTE, dest, tag, comm);
+  MPI_Send(&Orbinfo, count, MPI_BYTE, dest, getOrbVecTag(tag), comm);
   
   for (int i = start; i <  this->size() && (i-start<maxcount); i++) {
     int i_out=i-start;
     orb_i = &this->getOrbital(i);
-    if(orb_i->hasReal())Send_SerialTree(&orb_i->real(), Orbinfo.NchunksReal[i_out], dest, 2*i_out+1+tag, comm);
-    if(orb_i->hasImag())Send_SerialTree(&orb_i->imag(), Orbinfo.NchunksImag[i_out], dest, 2*i_out+2+tag, comm);
+    if(orb_i->hasReal())Send_SerialTree(&orb_i->real(), Orbinfo.NchunksReal[i_out], dest, getRealTag(tag, i_out), comm);
+    if(orb_i->hasImag())Send_SerialTree(&orb_i->imag(), Orbinfo.NchunksImag[i_out], dest, getImagTag(tag, i_out), comm);
   }
   
 #endif
@@ -694,6 +885,9 @@ void OrbitalVector::Isend_OrbVec(int dest, int tag, int* OrbsIx, int start, int
   MPI_Status status;
   MPI_Comm comm=MPI_COMM_WORLD;
 
+  //the buffers of the previous send are reused
+  this->waitSends();
+
   Metadata Orbinfo;
  
   Orbinfo.Norbitals = min(this->size() - start, maxcount);
@@ -706,28 +900,39 @@ void OrbitalVector::Isend_OrbVec(int dest, int tag, int* OrbsIx, int start, int
     Orbinfo.occupancy[i_out] = orb_i->getOccupancy();
     Orbinfo.error[i_out] = orb_i->getError();
     if(orb_i->hasReal()){
-      Orbinfo.NchunksReal[i_out] = orb_i->real().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+      Orbinfo.NchunksReal[i_out] = orb_i->real().getSerialFunctionTree()->compact();
     }else{Orbinfo.NchunksReal[i_out] = 0;}
     if(orb_i->hasImag()){
-      Orbinfo.NchunksImag[i_out] = orb_i->imag().getSerialFunctionTree()->nodeChunks.size();//should reduce to actual number of chunks
+      Orbinfo.NchunksImag[i_out] = orb_i->imag().getSerialFunctionTree()->compact();
     }else{Orbinfo.NchunksImag[i_out] = 0;}
     Orbinfo.Ix[i_out] = OrbsIx[i];
   }
 
-  MPI_Request request;
   int count=sizeof(Metadata);
-  MPI_Isend(&Orbinfo, count, MPI_BYTE, dest, tag, comm, &request);
+  this->sendMetadata.resize(count);
+  memcpy(this->sendMetadata.data(), &Orbinfo, count);
+  this->sendRequests.resize(1);
+  MPI_Isend(this->sendMetadata.data(), count, MPI_BYTE, dest, getOrbVecTag(tag), comm, &this->sendRequests[0]);
   
   for (int i = start; i <  this->size() && (i-start<maxcount); i++) {
     int i_out=i-start;
     orb_i = &this->getOrbital(i);
-    if(orb_i->hasReal())ISend_SerialTree(&orb_i->real(), Orbinfo.NchunksReal[i_out], dest, 2*i_out+1+tag, comm);
-    if(orb_i->hasImag())ISend_SerialTree(&orb_i->imag(), Orbinfo.NchunksImag[i_out], dest, 2*i_out+2+tag, comm);
+    if(orb_i->hasReal())ISend_SerialTree(&orb_i->real(), Orbinfo.NchunksReal[i_out], dest, getRealTag(tag, i_out), comm, this->sendRequests);
+    if(orb_i->hasImag())ISend_SerialTree(&orb_i->imag(), Orbinfo.NchunksImag[i_out], dest, getImagTag(tag, i_out), comm, this->sendRequests);
   }
   
 #endif
 }
 
+/** Complete the non-blocking sends posted by Isend_OrbVec. The sent
+ * orbitals must not be modified or deleted before this is called. */
+void OrbitalVector::waitSends(){
+#ifdef HAVE_MPI
+  MPI_Waitall(this->sendRequests.size(), this->sendRequests.data(), MPI_STATUSES_IGNORE);
+  this->sendRequests.clear();
+#endif
+}
+
 
 //receive an orbitalvector with MPI
 void OrbitalVector::Rcv_OrbVec(int source, int tag, int* OrbsIx, int& workOrbVecIx){
@@ -738,7 +943,7 @@ void OrbitalVector::Rcv_OrbVec(int source, int tag, int* OrbsIx, int& workOrbVec
   Metadata Orbinfo;
 
   int count=sizeof(Metadata);
-  MPI_Recv(&Orbinfo, count, MPI_BYTE, source, tag, comm, &status);
+  MPI_Recv(&Orbinfo, count, MPI_BYTE, source, getOrbVecTag(tag), comm, &status);
 
   Orbital* orb_i;
   for (int i = 0; i < Orbinfo.Norbitals; i++) {
@@ -759,14 +964,14 @@ void OrbitalVector::Rcv_OrbVec(int source, int tag, int* OrbsIx, int& workOrbVec
 	//We must have a tree defined for receiving nodes. Define one:
 	orb_i->allocReal();
       }
-      Rcv_SerialTree(&orb_i->real(), Orbinfo.NchunksReal[i], source, 2*i+1+tag, comm);}
+      Rcv_SerialTree(&orb_i->real(), Orbinfo.NchunksReal[i], source, getRealTag(tag, i), comm);}
     
     if(Orbinfo.NchunksImag[i]>0){
       if(not orb_i->hasImag()){
 	//We must have a tree defined for receiving nodes. Define one:
 	orb_i->allocImag();
       }
-       Rcv_SerialTree(&orb_i->imag(), Orbinfo.NchunksImag[i], source, 2*i+2+tag, comm);
+       Rcv_SerialTree(&orb_i->imag(), Orbinfo.NchunksImag[i], source, getImagTag(tag, i), comm);
     }else{
     //&(this->imag())=0;
     }
@@ -894,6 +1099,7 @@ void OrbitalVector::getOrbVecChunk_sym(int* myOrbsIx, OrbitalVector &rcvOrbs, in
       //non-blocking send first, then receive
       if(snd_MPI>=0)this->Isend_OrbVec(snd_MPI, MPI_iter, myOrbsIx, start, maxcount);
       if(rcv_MPI>=0)rcvOrbs.Rcv_OrbVec(rcv_MPI, MPI_iter, rcvOrbsIx, RcvOrbVecIx);
+      this->waitSends();
     }else{
       //own orbitals
       for (int i = start;  i < this->size() && (i-start<maxcount) ; i++){	
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "Orbital.h"
+#include "parallel.h"
 
 class OrbitalVector {
 public:
@@ -62,8 +63,12 @@ public:
 
     int printTreeSizes() const;
 
+    bool saveOrbitals(const std::string &file);
+    bool loadOrbitals(const std::string &file);
+
     void send_OrbVec(int dest, int tag, int* OrbsIx, int start, int maxcount);
     void Isend_OrbVec(int dest, int tag, int* OrbsIx, int start, int maxcount);
+    void waitSends();
     void Rcv_OrbVec(int source, int tag, int* OrbsIx, int& workOrbVecIx);
     void getOrbVecChunk(int* myOrbsIx, OrbitalVector &rcvOrbs, int* rcvOrbsIx, int size, int& iter0);
     void getOrbVecChunk_sym(int* myOrbsIx, OrbitalVector &rcvOrbs, int* rcvOrbsIx, int size, int& iter0);
@@ -97,6 +102,10 @@ protected:
     //Data
     //LUCA: ... or maybe just have two sets here?
     std::vector<Orbital *> orbitals;
+#ifdef HAVE_MPI
+    std::vector<MPI_Request> sendRequests;  //pending sends of Isend_OrbVec
+    std::vector<char> sendMetadata;         //send buffer for the metadata
+#endif
 };
 
 #endif // ORBITALVECTOR_H
@@ -4,8 +4,10 @@
 #include "GridGenerator.h"
 #include "Orbital.h"
 #include "Timer.h"
+#include "FunctionTreePool.h"
 
 extern MultiResolutionAnalysis<3> *MRA; // Global MRA
+extern FunctionTreePool<3> *TreePool; // Global tree pool
 
 using namespace std;
 
@@ -62,13 +64,13 @@ void QMPotential::calcRealPart(Orbital &Vphi, Orbital &phi) {
 
     if (Vphi.hasReal()) MSG_ERROR("Orbital not empty");
     if (V.hasReal() and phi.hasReal()) {
-        FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
+        FunctionTree<3> *tree = TreePool->get();
         grid(*tree, phi.real());
         mult(*tree, 1.0, V.real(), phi.real(), this->adap_build);
         vec.push_back(1.0, tree);
     }
     if (V.hasImag() and phi.hasImag()) {
-        FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
+        FunctionTree<3> *tree = TreePool->get();
         grid(*tree, phi.imag());
         mult(*tree, 1.0, V.imag(), phi.imag(), this->adap_build);
         vec.push_back(-1.0, tree);
@@ -81,7 +83,10 @@ void QMPotential::calcRealPart(Orbital &Vphi, Orbital &phi) {
         Vphi.allocReal();
         grid(Vphi.real(), vec);
         add(Vphi.real(), vec, 0);
-        vec.clear(true);
+        for (int i = 0; i < vec.size(); i++) {
+            TreePool->put(vec[i]);
+        }
+        vec.clear(false);
     }
 }
 
@@ -95,13 +100,13 @@ void QMPotential::calcImagPart(Orbital &Vphi, Orbital &phi, bool adjoint) {
 
     if (Vphi.hasImag()) MSG_ERROR("Orbital not empty");
     if (V.hasReal() and phi.hasImag()) {
-        FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
+        FunctionTree<3> *tree = TreePool->get();
         grid(*tree, phi.imag());
         mult(*tree, 1.0, V.real(), phi.imag(), this->adap_build);
         vec.push_back(1.0, tree);
     }
     if (V.hasImag() and phi.hasReal()) {
-        FunctionTree<3> *tree = new FunctionTree<3>(*MRA);
+        FunctionTree<3> *tree = TreePool->get();
         grid(*tree, phi.real());
         mult(*tree, 1.0, V.imag(), phi.real(), this->adap_build);
         if (adjoint) {
@@ -118,7 +123,10 @@ void QMPotential::calcImagPart(Orbital &Vphi, Orbital &phi, bool adjoint) {
         Vphi.allocImag();
         grid(Vphi.imag(), vec);
         add(Vphi.imag(), vec, 0);
-        vec.clear(true);
+        for (int i = 0; i < vec.size(); i++) {
+            TreePool->put(vec[i]);
+        }
+        vec.clear(false);
     }
 }
 
@@ -205,17 +205,16 @@ void XCOperator::setupXCOutput() {
     if (this->xcInput == 0) MSG_ERROR("XC input not initialized");
     if (this->xcInput[0] == 0) MSG_ERROR("XC input not initialized");
 
-    GridGenerator<3> grid(this->max_scale);
-
     // Alloc output trees
     int nOut = this->functional->getOutputLength(this->order);
     this->xcOutput = allocPtrArray<FunctionTree<3> >(nOut);
 
     // Copy grid from input density
     FunctionTree<3> &rho = *this->xcInput[0];
+    UnionGrid<3> rho_grid(rho, this->max_scale);
     for (int i = 0; i < nOut; i++) {
         this->xcOutput[i] = new FunctionTree<3>(*MRA);
-        grid(*this->xcOutput[i], rho);
+        rho_grid.stamp(*this->xcOutput[i]);
     }
 }
 
@@ -315,8 +314,7 @@ FunctionTree<3>* XCOperator::calcDotProduct(FunctionTreeVector<3> &vec_a,
         FunctionTree<3> &tree_a = vec_a.getFunc(d);
         FunctionTree<3> &tree_b = vec_b.getFunc(d);
         FunctionTree<3> *out_d = new FunctionTree<3>(*MRA);
-        grid(*out_d, tree_a);
-        grid(*out_d, tree_b);
+        grid(*out_d, tree_a, tree_b);
         mult(*out_d, 1.0, tree_a, tree_b, 0);
         out_vec.push_back(out_d);
     }
@@ -37,25 +37,45 @@ void HelmholtzOperatorSet::initialize(const VectorXd &energies) {
     TelePrompter::printFooter(0, timer, 2);
 }
 
+/** Changing the threshold changes the mu grid, existing operators are
+ * kept until they are no longer in use. */
+void HelmholtzOperatorSet::setThreshold(double thrs) {
+    this->threshold = thrs;
+    this->gridOperators.clear();
+}
+
+/** With a positive threshold the operators are set up on a logarithmic mu
+ * grid, with spacing such that any mu is within the (relative) threshold of
+ * its nearest grid point. Grid operators of the previous initialization are
+ * still available here, so they are reused as long as the energies stay
+ * within the same grid point between iterations. The kernel terms that do
+ * not depend on mu are shared between all operators through the term bank,
+ * so only the mu dependent terms are built for a new grid point. */
 int HelmholtzOperatorSet::initHelmholtzOperator(double energy) {
     if (energy > 0.0) MSG_ERROR("Complex Helmholtz not available");
     double mu = sqrt(-2.0*energy);
-    for (int j = 0; j < this->operators.size(); j++) {
-        double mu_j = this->operators[j]->getMu();
-        double muDiff = mu - mu_j;
-        double relDiff = muDiff/mu;
-        if (fabs(relDiff) < this->threshold) {
-            double l = -0.5*mu_j*mu_j;
+    int n = 0;
+    if (this->threshold > 0.0) {
+        double step = 2.0*log(1.0 + this->threshold);
+        n = (int) round(log(mu)/step);
+        mu = exp(n*step);
+        map<int, int>::iterator it = this->gridOperators.find(n);
+        if (it != this->gridOperators.end()) {
+            double l = -0.5*mu*mu;
             TelePrompter::printDouble(0, "Re-using operator with lambda", l);
-            return j;
+            return it->second;
         }
     }
-    TelePrompter::printDouble(0, "Creating operator with lambda", energy);
+    TelePrompter::printDouble(0, "Creating operator with lambda", -0.5*mu*mu);
 
-    HelmholtzOperator *oper = new HelmholtzOperator(*MRA, mu, this->build_prec);
+    HelmholtzOperator *oper = new HelmholtzOperator(*MRA, mu, this->build_prec, &this->bank);
     this->operators.push_back(oper);
 
-    return this->operators.size() - 1;
+    int idx = this->operators.size() - 1;
+    if (this->threshold > 0.0) {
+        this->gridOperators[n] = idx;
+    }
+    return idx;
 }
 
 void HelmholtzOperatorSet::clear() {
@@ -67,36 +87,46 @@ void HelmholtzOperatorSet::clear() {
         }
     }
     this->operators.clear();
+    this->gridOperators.clear();
     this->operIdx.clear();
     this->lambda.clear();
 }
 
+/** Delete the operators that are not in use, and drop their mu grid points.
+ * Only the operators of the last initialization are kept, so the memory
+ * does not grow as the energies drift over the grid during the SCF. */
 void HelmholtzOperatorSet::clearUnused() {
-    vector<HelmholtzOperator *> tmp;
     int nIdx = this->operIdx.size();
     int nOper = this->operators.size();
-    VectorXd nUsed = VectorXd::Zero(nOper);
+    vector<bool> keep(nOper, false);
     for (int i = 0; i < nIdx; i++) {
-        int n = this->operIdx[i];
-        nUsed(n) = nUsed(n) + 1;
+        keep[this->operIdx[i]] = true;
     }
+
+    vector<HelmholtzOperator *> tmp;
+    vector<int> newIdx(nOper, -1);
     for (int i = 0; i < nOper; i++) {
-        if (nUsed(i) == 0) {
-            delete this->operators[i];
-        } else {
+        if (keep[i]) {
             tmp.push_back(this->operators[i]);
-            int newIdx = tmp.size() - 1;
-            for (int j = 0; j < nIdx; j++) {
-                if (operIdx[j] == i) operIdx[j] = newIdx;
-            }
+            newIdx[i] = tmp.size() - 1;
+        } else {
+            delete this->operators[i];
         }
         this->operators[i] = 0;
     }
-    this->operators.clear();
-    for (int i = 0; i < tmp.size(); i++) {
-        this->operators.push_back(tmp[i]);
-        tmp[i] = 0;
+    for (int j = 0; j < nIdx; j++) {
+        this->operIdx[j] = newIdx[this->operIdx[j]];
+    }
+    map<int, int>::iterator it = this->gridOperators.begin();
+    while (it != this->gridOperators.end()) {
+        if (keep[it->second]) {
+            it->second = newIdx[it->second];
+            it++;
+        } else {
+            this->gridOperators.erase(it++);
+        }
     }
+    this->operators = tmp;
 }
 
 HelmholtzOperator& HelmholtzOperatorSet::getOperator(int i) {
@@ -3,8 +3,10 @@
 
 #include <Eigen/Core>
 #include <vector>
+#include <map>
 
 #include "HelmholtzOperator.h"
+#include "OperatorTermBank.h"
 #include "MWConvolution.h"
 
 class Orbital;
@@ -18,7 +20,7 @@ public:
     void clear();
 
     void setPrecision(double prec) { this->apply.setPrecision(prec); }
-    void setThreshold(double thrs) { this->threshold = thrs; }
+    void setThreshold(double thrs);
     double getThreshold() const { return this->threshold; }
 
     double getLambda(int i) const { return this->lambda[i]; }
@@ -31,10 +33,12 @@ private:
     double threshold; //For re-using operators. Negative means always recreate
     double build_prec;
     MWConvolution<3> apply;
+    OperatorTermBank bank; //Terms shared between the operators
 
     std::vector<int> operIdx;
     std::vector<double> lambda;
     std::vector<HelmholtzOperator *> operators;
+    std::map<int, int> gridOperators; //Operator index of each mu grid point
 
     int initHelmholtzOperator(double energy);
     void clearUnused();
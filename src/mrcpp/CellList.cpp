@@ -0,0 +1,149 @@
+/**
+ *
+ *
+ *          CTCC, University of Tromsø
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "CellList.h"
+#include "TelePrompter.h"
+
+using namespace std;
+
+/** Distribute the items on a uniform grid covering all bounded supports.
+ *
+ * The cell size follows the average support width, limited to a total of
+ * about 2*nItems cells, so that an item is found in only a few cells. */
+template<int D>
+void CellList<D>::build(const vector<const double *> &lower,
+                        const vector<const double *> &upper) {
+    if (lower.size() != upper.size()) MSG_ERROR("Invalid arguments");
+    clear();
+    this->nItems = lower.size();
+
+    int nBounded = 0;
+    double top[D], width[D];
+    for (int d = 0; d < D; d++) {
+        this->origin[d] = 0.0;
+        top[d] = 0.0;
+        width[d] = 0.0;
+    }
+    for (int i = 0; i < this->nItems; i++) {
+        if (lower[i] == 0 or upper[i] == 0) {
+            this->unbounded.push_back(i);
+            continue;
+        }
+        for (int d = 0; d < D; d++) {
+            if (nBounded == 0 or lower[i][d] < this->origin[d]) this->origin[d] = lower[i][d];
+            if (nBounded == 0 or upper[i][d] > top[d]) top[d] = upper[i][d];
+            width[d] += upper[i][d] - lower[i][d];
+        }
+        nBounded++;
+    }
+    if (nBounded == 0) return;
+
+    int maxCells = (int) ceil(pow(2.0*nBounded, 1.0/D));
+    int totCells = 1;
+    for (int d = 0; d < D; d++) {
+        double length = top[d] - this->origin[d];
+        double avgWidth = width[d]/nBounded;
+        int n = maxCells;
+        if (avgWidth > 0.0) n = (int) ceil(length/avgWidth);
+        n = max(1, min(n, maxCells));
+        if (length <= 0.0) {
+            n = 1;
+            length = 1.0;
+        }
+        this->nCells[d] = n;
+        this->cellSize[d] = length/n;
+        totCells *= n;
+    }
+    this->cells.resize(totCells);
+
+    int lo[D], hi[D], cIdx[D];
+    for (int i = 0; i < this->nItems; i++) {
+        if (lower[i] == 0 or upper[i] == 0) continue;
+        getCellRange(lower[i], upper[i], lo, hi);
+        for (int d = 0; d < D; d++) {
+            cIdx[d] = lo[d];
+        }
+        // Loop over all cells in the range, first direction running fastest
+        while (true) {
+            int n = 0;
+            for (int d = D - 1; d >= 0; d--) {
+                n = n*this->nCells[d] + cIdx[d];
+            }
+            this->cells[n].push_back(i);
+            int d = 0;
+            while (d < D and cIdx[d] == hi[d]) {
+                cIdx[d] = lo[d];
+                d++;
+            }
+            if (d == D) break;
+            cIdx[d]++;
+        }
+    }
+}
+
+template<int D>
+void CellList<D>::clear() {
+    this->nItems = 0;
+    this->unbounded.clear();
+    this->cells.clear();
+}
+
+/** Find the cells touched by the box [lb, ub]. Returns false if the box is
+ * outside the grid, in which case only unbounded items can overlap it. */
+template<int D>
+bool CellList<D>::getCellRange(const double *lb,
+                               const double *ub,
+                               int *lo,
+                               int *hi) const {
+    for (int d = 0; d < D; d++) {
+        double a = (lb[d] - this->origin[d])/this->cellSize[d];
+        double b = (ub[d] - this->origin[d])/this->cellSize[d];
+        if (b < 0.0 or a > this->nCells[d]) return false;
+        lo[d] = min(this->nCells[d] - 1, max(0, (int) floor(a)));
+        hi[d] = min(this->nCells[d] - 1, max(0, (int) floor(b)));
+    }
+    return true;
+}
+
+/** Collect all items that may overlap the box [lb, ub], in increasing order */
+template<int D>
+void CellList<D>::query(const double *lb,
+                        const double *ub,
+                        vector<int> &idx) const {
+    idx = this->unbounded;
+
+    int lo[D], hi[D], cIdx[D];
+    if (this->cells.size() > 0 and getCellRange(lb, ub, lo, hi)) {
+        for (int d = 0; d < D; d++) {
+            cIdx[d] = lo[d];
+        }
+        while (true) {
+            int n = 0;
+            for (int d = D - 1; d >= 0; d--) {
+                n = n*this->nCells[d] + cIdx[d];
+            }
+            const vector<int> &cell = this->cells[n];
+            idx.insert(idx.end(), cell.begin(), cell.end());
+            int d = 0;
+            while (d < D and cIdx[d] == hi[d]) {
+                cIdx[d] = lo[d];
+                d++;
+            }
+            if (d == D) break;
+            cIdx[d]++;
+        }
+    }
+    sort(idx.begin(), idx.end());
+    idx.erase(unique(idx.begin(), idx.end()), idx.end());
+}
+
+template class CellList<1>;
+template class CellList<2>;
+template class CellList<3>;
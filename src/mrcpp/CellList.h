@@ -0,0 +1,47 @@
+/**
+ *
+ *
+ *          CTCC, University of Tromsø
+ *
+ */
+
+#ifndef CELLLIST_H
+#define CELLLIST_H
+
+#include <vector>
+
+/** Uniform grid of cells for fast lookup of items with bounded support.
+ *
+ * Each item is given by the lower and upper corner of its support, or null
+ * pointers if it is unbounded. Items are registered in all cells they
+ * overlap, and a query returns all items that may overlap a given box: the
+ * ones in the cells touched by the box and all unbounded ones. The result is
+ * sorted, so sums over the items are done in the original order.
+ */
+template<int D>
+class CellList {
+public:
+    CellList() : nItems(0) { }
+    virtual ~CellList() { }
+
+    void build(const std::vector<const double *> &lower,
+               const std::vector<const double *> &upper);
+    void clear();
+
+    int getNItems() const { return this->nItems; }
+    int getNCells() const { return this->cells.size(); }
+
+    void query(const double *lb, const double *ub, std::vector<int> &idx) const;
+
+protected:
+    int nItems;
+    int nCells[D];
+    double origin[D];
+    double cellSize[D];
+    std::vector<int> unbounded;
+    std::vector<std::vector<int> > cells;
+
+    bool getCellRange(const double *lb, const double *ub, int *lo, int *hi) const;
+};
+
+#endif // CELLLIST_H
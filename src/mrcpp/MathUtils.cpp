@@ -258,24 +258,225 @@ VectorXd MathUtils::getBinomialCoefs(unsigned int order) {
     return coefs;
 }
 
+/** Fixed size kernel for applyFilter, with K = kp1 and N = kp1_dm1.
+ *
+ * The output is computed in blocks of R rows and C columns, accumulated in
+ * registers. The matching columns of the input are first transposed into a
+ * local block, so that both the accumulation and the stores to the output
+ * run over contiguous data, which the compiler can vectorize for given K.
+ * Kept out of line, so that applyFilter and mwTransform3D run the very same
+ * code: with -Ofast the rounding could otherwise depend on the call site.
+ */
+template<int K>
+__attribute__((noinline))
+static void applyFilterKernel(double *out, const double *in,
+                              const double *filter, int N, double fac) {
+    const int R = 8;
+    const int C = 4;
+    int r = 0;
+    for (; r + R <= N; r += R) {
+        double x[K][R];
+        for (int j = 0; j < R; j++) {
+            for (int k = 0; k < K; k++) {
+                x[k][j] = in[(r + j)*K + k];
+            }
+        }
+        int c = 0;
+        for (; c + C <= K; c += C) {
+            double y[C][R];
+            for (int i = 0; i < C; i++) {
+                for (int j = 0; j < R; j++) {
+                    y[i][j] = 0.0;
+                }
+            }
+            for (int k = 0; k < K; k++) {
+                for (int i = 0; i < C; i++) {
+                    const double f = filter[(c + i)*K + k];
+                    for (int j = 0; j < R; j++) {
+                        y[i][j] += x[k][j]*f;
+                    }
+                }
+            }
+            for (int i = 0; i < C; i++) {
+                double *o = out + (c + i)*N + r;
+                if (fac == 0.0) {
+                    for (int j = 0; j < R; j++) o[j] = y[i][j];
+                } else {
+                    for (int j = 0; j < R; j++) o[j] = fac*o[j] + y[i][j];
+                }
+            }
+        }
+        for (; c < K; c++) {
+            double y[R];
+            for (int j = 0; j < R; j++) {
+                y[j] = 0.0;
+            }
+            for (int k = 0; k < K; k++) {
+                const double f = filter[c*K + k];
+                for (int j = 0; j < R; j++) {
+                    y[j] += x[k][j]*f;
+                }
+            }
+            double *o = out + c*N + r;
+            if (fac == 0.0) {
+                for (int j = 0; j < R; j++) o[j] = y[j];
+            } else {
+                for (int j = 0; j < R; j++) o[j] = fac*o[j] + y[j];
+            }
+        }
+    }
+    for (; r < N; r++) {
+        const double *x = in + r*K;
+        for (int c = 0; c < K; c++) {
+            const double *f = filter + c*K;
+            double y = 0.0;
+            for (int k = 0; k < K; k++) {
+                y += x[k]*f[k];
+            }
+            double *o = out + c*N + r;
+            if (fac == 0.0) {
+                *o = y;
+            } else {
+                *o = fac*(*o) + y;
+            }
+        }
+    }
+}
+
+/** Apply a filter in one direction, and rotate the directions of the output.
+ *
+ * The input is interpreted as a kp1 x kp1_dm1 column major matrix, and the
+ * output as kp1_dm1 x kp1, such that out = fac*out + in^T*filter. Low
+ * orders are handled by fixed size kernels, that avoid the call overhead
+ * of a general matrix multiplication on these small matrices. From kp1 = 7
+ * and up the general gemm is as fast or faster, and is used instead.
+ */
 void MathUtils::applyFilter(double *out, double *in,
                             const MatrixXd &filter,
                             int kp1, int kp1_dm1, double fac) {
+#define APPLY_FILTER_KERNEL(K) \
+    case K: applyFilterKernel<K>(out, in, filter.data(), kp1_dm1, fac); return;
+
+    switch (kp1) {
+        APPLY_FILTER_KERNEL(2)
+        APPLY_FILTER_KERNEL(3)
+        APPLY_FILTER_KERNEL(4)
+        APPLY_FILTER_KERNEL(5)
+        APPLY_FILTER_KERNEL(6)
+    default:
+        applyFilterGemm(out, in, filter.data(), kp1, kp1_dm1, fac);
+    }
+#undef APPLY_FILTER_KERNEL
+}
+
+/** General version of applyFilter, using BLAS if available. */
+void MathUtils::applyFilterGemm(double *out, double *in,
+                                const double *filter,
+                                int kp1, int kp1_dm1, double fac) {
 #ifdef HAVE_BLAS
     cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans,
-                kp1_dm1, kp1, kp1, 1.0, in, kp1, filter.data(),
+                kp1_dm1, kp1, kp1, 1.0, in, kp1, filter,
                 kp1, fac, out, kp1_dm1);
 #else
     Eigen::Map<MatrixXd> f(in, kp1, kp1_dm1);
     Eigen::Map<MatrixXd> g(out, kp1_dm1, kp1);
+    Eigen::Map<const MatrixXd> h(filter, kp1, kp1);
     if (fac < MachineZero) {
-        g = f.transpose() * filter;
+        g = f.transpose() * h;
     } else {
-        g += f.transpose() * filter;
+        g += f.transpose() * h;
     }
 #endif
 }
 
+/** One direction of the fused 3D transform, for fixed K = kp1.
+ *
+ * The eight blocks come in nPairs pairs that differ only in the bit of
+ * direction dir, and each output of a pair gets the low input block first
+ * and then the high one, using the sub-filter order of getSubFilter. This
+ * is the same sequence of kernel calls as applyFilter would make for the
+ * non-zero (gt, ft) combinations, without testing all 64 of them.
+ */
+template<int K>
+static void mwTransformDirection(int dir, int kp1, double *out, int out_stride,
+                                 double *in, int in_stride, const double *filters,
+                                 int nPairs, bool hasHigh, double fac) {
+    const int N = K*K;
+    const int bit = 1 << dir;
+    for (int p = 0; p < nPairs; p++) {
+        int t_lo = ((p & ~(bit - 1)) << 1) | (p & (bit - 1));
+        int t_hi = t_lo | bit;
+        double *o_lo = out + t_lo*out_stride;
+        double *o_hi = out + t_hi*out_stride;
+        const double *in_lo = in + t_lo*in_stride;
+        const double *in_hi = in + t_hi*in_stride;
+        applyFilterKernel<K>(o_lo, in_lo, filters, N, fac);
+        applyFilterKernel<K>(o_hi, in_lo, filters + 2*N, N, fac);
+        if (hasHigh) {
+            applyFilterKernel<K>(o_lo, in_hi, filters + N, N, 1.0);
+            applyFilterKernel<K>(o_hi, in_hi, filters + 3*N, N, 1.0);
+        }
+    }
+}
+
+/** One direction of the fused 3D transform, for general kp1. */
+static void mwTransformDirectionGemm(int dir, int kp1, double *out, int out_stride,
+                                     double *in, int in_stride, const double *filters,
+                                     int nPairs, bool hasHigh, double fac) {
+    const int N = kp1*kp1;
+    const int bit = 1 << dir;
+    for (int p = 0; p < nPairs; p++) {
+        int t_lo = ((p & ~(bit - 1)) << 1) | (p & (bit - 1));
+        int t_hi = t_lo | bit;
+        double *o_lo = out + t_lo*out_stride;
+        double *o_hi = out + t_hi*out_stride;
+        double *in_lo = in + t_lo*in_stride;
+        double *in_hi = in + t_hi*in_stride;
+        MathUtils::applyFilterGemm(o_lo, in_lo, filters, kp1, N, fac);
+        MathUtils::applyFilterGemm(o_hi, in_lo, filters + 2*N, kp1, N, fac);
+        if (hasHigh) {
+            MathUtils::applyFilterGemm(o_lo, in_hi, filters + N, kp1, N, 1.0);
+            MathUtils::applyFilterGemm(o_hi, in_hi, filters + 3*N, kp1, N, 1.0);
+        }
+    }
+}
+
+/** Complete multiwavelet transform of the eight blocks of a 3D node.
+ *
+ * Fused version of the direction by direction transform in MWNode and
+ * SerialTree, with the four sub-filters of the operation packed as in
+ * MWFilter::getPackedSubFilters. Input and output blocks are separated by
+ * in_stride and out_stride, and out may be the same array as in. With
+ * scalingOnly only the first input block is read, as for GenNodes. In the
+ * last direction out = fac*out + result. The result is bit for bit the same
+ * as with repeated applyFilter calls over all block combinations.
+ */
+void MathUtils::mwTransform3D(double *out, int out_stride, double *in, int in_stride,
+                              const MatrixXd &filters, int kp1,
+                              bool scalingOnly, double fac) {
+    typedef void (*TransformDirection)(int, int, double *, int, double *, int,
+                                       const double *, int, bool, double);
+    TransformDirection transform;
+    switch (kp1) {
+    case 2: transform = mwTransformDirection<2>; break;
+    case 3: transform = mwTransformDirection<3>; break;
+    case 4: transform = mwTransformDirection<4>; break;
+    case 5: transform = mwTransformDirection<5>; break;
+    case 6: transform = mwTransformDirection<6>; break;
+    default: transform = mwTransformDirectionGemm;
+    }
+
+    int kp1_d = kp1*kp1*kp1;
+    double tmp_1[8*kp1_d];
+    double tmp_2[8*kp1_d];
+    const double *f = filters.data();
+    bool hasHigh = not scalingOnly;
+
+    transform(0, kp1, tmp_1, kp1_d, in, in_stride, f, scalingOnly ? 1 : 4, hasHigh, 0.0);
+    transform(1, kp1, tmp_2, kp1_d, tmp_1, kp1_d, f, scalingOnly ? 2 : 4, hasHigh, 0.0);
+    transform(2, kp1, out, out_stride, tmp_2, kp1_d, f, 4, hasHigh, fac);
+}
+
 /** Make a nD-representation from 1D-representations of separable functions.
  *
  * This method uses the "output" vector as initial input, in order to
@@ -56,6 +56,11 @@ public:
 
     static void applyFilter(double *out, double *in, const Eigen::MatrixXd &filter,
                             int kp1, int kp1_dm1, double fac);
+    static void applyFilterGemm(double *out, double *in, const double *filter,
+                                int kp1, int kp1_dm1, double fac);
+    static void mwTransform3D(double *out, int out_stride, double *in, int in_stride,
+                              const Eigen::MatrixXd &filters, int kp1,
+                              bool scalingOnly, double fac);
 
     static void tensorExpandCoefs(int dim, int dir, int kp1, int kp1_d,
                                   const Eigen::MatrixXd &primitive, Eigen::VectorXd &expanded);
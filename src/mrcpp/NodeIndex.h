@@ -18,6 +18,7 @@
 #include "TelePrompter.h"
 
 template<int D> class NodeIndexComp;
+template<int D> class NodeIndexHash;
 
 template<int D>
 class NodeIndex {
@@ -42,6 +43,7 @@ public:
     template<int T>
     friend std::ostream& operator<<(std::ostream &o, const NodeIndex<T> &idx);
     friend class NodeIndexComp<D>;
+    friend class NodeIndexHash<D>;
 
 private:
     short int N;
@@ -161,4 +163,17 @@ public:
     }
 };
 
+/** Hash function for NodeIndex, for use in unordered containers. */
+template<int D>
+class NodeIndexHash {
+public:
+    size_t operator()(const NodeIndex<D> &idx) const {
+        size_t h = (size_t) idx.N;
+        for (int d = 0; d < D; d++) {
+            h ^= (size_t) idx.L[d] + 0x9e3779b9 + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+};
+
 #endif /* NODEINDEX_H_ */
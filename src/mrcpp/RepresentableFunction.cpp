@@ -8,6 +8,8 @@
  *
  */
 
+#include <vector>
+
 #include "RepresentableFunction.h"
 
 using namespace std;
@@ -70,6 +72,46 @@ RepresentableFunction<D>::~RepresentableFunction() {
     this->B = 0;
 }
 
+/** Evaluate the function in a batch of points.
+ *
+ * The coordinates of point i are stored in points[i*D + d], i.e. the points
+ * are the columns of a column major (D x nPoints) matrix. The default
+ * implementation calls the single point evalf for each point, override for
+ * functions that can be evaluated more efficiently in batches. */
+template<int D>
+void RepresentableFunction<D>::evalfBatch(const double *points,
+                                          int nPoints,
+                                          double *values) const {
+    for (int i = 0; i < nPoints; i++) {
+        values[i] = evalf(points + i*D);
+    }
+}
+
+/** Evaluate the function on a tensor product grid.
+ *
+ * The grid is given by nPts coordinates in each direction, stored as
+ * pts[d*nPts + i]. The nPts^D values are ordered with the first direction
+ * running fastest. The default implementation expands the grid and calls
+ * evalfBatch, override for separable functions. */
+template<int D>
+void RepresentableFunction<D>::evalfTensor(const double *pts,
+                                           int nPts,
+                                           double *values) const {
+    int nTot = 1;
+    for (int d = 0; d < D; d++) {
+        nTot *= nPts;
+    }
+    vector<double> points(D*nTot);
+    for (int n = 0; n < nTot; n++) {
+        int idx = n;
+        for (int d = 0; d < D; d++) {
+            points[n*D + d] = pts[d*nPts + idx%nPts];
+            idx /= nPts;
+        }
+    }
+    evalfBatch(points.data(), nTot, values);
+}
+
 template<int D>
 void RepresentableFunction<D>::setBounds(const double *a, const double *b) {
     if (a == 0 or b == 0) {
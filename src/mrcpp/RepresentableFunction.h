@@ -24,6 +24,8 @@ public:
     virtual ~RepresentableFunction();
 
     virtual double evalf(const double *r) const = 0;
+    virtual void evalfBatch(const double *points, int nPoints, double *values) const;
+    virtual void evalfTensor(const double *pts, int nPts, double *values) const;
 
     void setBounds(const double *a, const double *b);
     void clearBounds();
@@ -37,6 +39,9 @@ public:
     const double *getLowerBounds() const { return this->A; }
     const double *getUpperBounds() const { return this->B; }
 
+    virtual void setupScreening() { }
+    virtual void clearScreening() { }
+
     virtual bool isVisibleAtScale(int scale, int nQuadPts) const { return true; }
     virtual bool isZeroOnInterval(const double *a, const double *b) const { return false; }
 
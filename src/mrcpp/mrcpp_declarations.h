@@ -10,11 +10,13 @@ template <int D> class NodeIndex;
 template <int D> class NodeIndexComp;
 
 template <int D> class RepresentableFunction;
+template <int D> class Gaussian;
 template <int D> class MultiResolutionAnalysis;
 
 template <int D> class MWTree;
 template <int D> class FunctionTree;
 template <int D> class FunctionTreeVector;
+template <int D> class FunctionTreePool;
 class OperatorTree;
 
 template <int D> class MWNode;
@@ -37,6 +39,7 @@ template <int D> class DerivativeConvolution;
 template <int D> class ConvolutionOperator;
 class PoissonOperator;
 class HelmholtzOperator;
+class OperatorTermBank;
 template<int D> class DerivativeOperator;
 template<int D> class ABGVOperator;
 template<int D> class PHOperator;
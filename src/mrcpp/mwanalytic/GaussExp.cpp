@@ -106,6 +106,106 @@ double GaussExp<D>::evalf(const double *r) const {
     return val;
 }
 
+/** Batched evaluation, only the terms that overlap the bounding box of the
+ * points are evaluated. */
+template<int D>
+void GaussExp<D>::evalfBatch(const double *points, int nPoints, double *values) const {
+    Map<ArrayXd> vals(values, nPoints);
+    vals.setZero();
+    if (nPoints < 1) return;
+
+    double lb[D], ub[D];
+    for (int d = 0; d < D; d++) {
+        Map<const ArrayXd, 0, InnerStride<D> > r_d(points + d, nPoints);
+        lb[d] = r_d.minCoeff();
+        ub[d] = r_d.maxCoeff();
+    }
+    ArrayXd tmp(nPoints);
+    vector<int> terms;
+    getTerms(lb, ub, terms);
+    for (int n = 0; n < terms.size(); n++) {
+        const Gaussian<D> &gauss = this->getFunc(terms[n]);
+        gauss.evalfBatch(points, nPoints, tmp.data());
+        vals += tmp;
+    }
+}
+
+/** Evaluation on a tensor product grid, as a sum of separable terms. Only
+ * the terms that overlap the grid are evaluated. */
+template<int D>
+void GaussExp<D>::evalfTensor(const double *pts, int nPts, double *values) const {
+    int nTot = 1;
+    for (int d = 0; d < D; d++) {
+        nTot *= nPts;
+    }
+    Map<ArrayXd> vals(values, nTot);
+    vals.setZero();
+    if (nPts < 1) return;
+
+    double lb[D], ub[D];
+    for (int d = 0; d < D; d++) {
+        Map<const ArrayXd> r_d(pts + d*nPts, nPts);
+        lb[d] = r_d.minCoeff();
+        ub[d] = r_d.maxCoeff();
+    }
+    ArrayXd tmp(nTot);
+    vector<int> terms;
+    getTerms(lb, ub, terms);
+    for (int n = 0; n < terms.size(); n++) {
+        const Gaussian<D> &gauss = this->getFunc(terms[n]);
+        gauss.evalfTensor(pts, nPts, tmp.data());
+        vals += tmp;
+    }
+}
+
+/** Distribute the screened terms on a cell list, so that the terms that
+ * overlap a node are found without looping over the full expansion. */
+template<int D>
+void GaussExp<D>::setupScreening() {
+    vector<const double *> lower;
+    vector<const double *> upper;
+    for (int i = 0; i < this->size(); i++) {
+        const Gaussian<D> &gauss = this->getFunc(i);
+        if (gauss.getScreen()) {
+            lower.push_back(gauss.getLowerBounds());
+            upper.push_back(gauss.getUpperBounds());
+        } else {
+            lower.push_back(0);
+            upper.push_back(0);
+        }
+    }
+    this->cellList.build(lower, upper);
+}
+
+/** Collect (in increasing order) the terms that can be nonzero in [lb, ub].
+ * Screened terms outside the box are excluded. */
+template<int D>
+void GaussExp<D>::getTerms(const double *lb,
+                           const double *ub,
+                           vector<int> &terms) const {
+    vector<int> candidates;
+    if (this->cellList.getNItems() == this->size()) {
+        this->cellList.query(lb, ub, candidates);
+    } else {
+        for (int i = 0; i < this->size(); i++) {
+            candidates.push_back(i);
+        }
+    }
+    terms.clear();
+    for (int n = 0; n < candidates.size(); n++) {
+        const Gaussian<D> &gauss = this->getFunc(candidates[n]);
+        if (gauss.getScreen()) {
+            bool outside = false;
+            for (int d = 0; d < D; d++) {
+                if (ub[d] < gauss.getLowerBound(d)) outside = true;
+                if (lb[d] > gauss.getUpperBound(d)) outside = true;
+            }
+            if (outside) continue;
+        }
+        terms.push_back(candidates[n]);
+    }
+}
+
 template<int D>
 bool GaussExp<D>::isVisibleAtScale(int scale, int nPts) const {
     for (unsigned int i = 0; i < this->size(); i++) {
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include "RepresentableFunction.h"
+#include "CellList.h"
 
 template<int D> class Gaussian;
 template<int D> class GaussFunc;
@@ -48,10 +49,14 @@ public:
     void normalize();
 
     void calcScreening(double nStdDev = defaultScreening);
+    void setupScreening();
+    void clearScreening() { this->cellList.clear(); }
     bool isVisibleAtScale(int scale, int nPts) const;
     bool isZeroOnInterval(const double *lb, const double *ub) const;
 
     double evalf(const double *r) const;
+    void evalfBatch(const double *points, int nPoints, double *values) const;
+    void evalfTensor(const double *pts, int nPts, double *values) const;
 
     GaussExp<D> differentiate(int dir);
 
@@ -123,6 +128,9 @@ protected:
     static double defaultScreening;
     double screening;
     double squareNorm;
+    CellList<D> cellList;   ///< Screened terms, only set up during projection
+
+    void getTerms(const double *lb, const double *ub, std::vector<int> &terms) const;
 };
 
 #endif /* GAUSSEXP_H_ */
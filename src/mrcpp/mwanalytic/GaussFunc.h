@@ -39,6 +39,7 @@ public:
 
     double evalf(const double *r) const;
     double evalf(double r, int dim) const;
+    void evalfBatch(const double *points, int nPoints, double *values) const;
 
     static double calcOverlap(GaussFunc<D> &a, GaussFunc<D> &b);
     double calcOverlap(GaussFunc<D> &b);
@@ -106,6 +106,25 @@ double GaussPoly<D>::evalf(const double *r) const {
     return this->coef * p2 * exp(-this->alpha * q2);
 }
 
+/** Batched evaluation, the exponentials are computed in one vectorized
+ * pass over all points. */
+template<int D>
+void GaussPoly<D>::evalfBatch(const double *points, int nPoints, double *values) const {
+    Map<ArrayXd> vals(values, nPoints);
+    ArrayXd q2 = ArrayXd::Zero(nPoints);
+    vals = ArrayXd::Constant(nPoints, this->coef);
+    for (int d = 0; d < D; d++) {
+        Map<const ArrayXd, 0, InnerStride<D> > r_d(points + d, nPoints);
+        ArrayXd q = r_d - this->pos[d];
+        q2 += q.square();
+        for (int i = 0; i < nPoints; i++) {
+            values[i] *= poly[d]->evalf(q(i));
+        }
+    }
+    vals *= (-this->alpha * q2).exp();
+    this->applyScreen(points, nPoints, values);
+}
+
 /** NOTE!
  *	This function evaluation will give the first dimension the full coef
  *	amplitude, leaving all other directions with amplitude 1.0. This is to
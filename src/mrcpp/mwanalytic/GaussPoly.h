@@ -31,6 +31,7 @@ public:
 
     double evalf(const double *r) const;
     double evalf(double r, int dim) const;
+    void evalfBatch(const double *points, int nPoints, double *values) const;
 
     double calcOverlap(GaussFunc<D> &b);
     double calcOverlap(GaussPoly<D> &b);
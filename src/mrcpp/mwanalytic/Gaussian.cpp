@@ -113,6 +113,23 @@ bool Gaussian<D>::isZeroOnInterval(const double *a, const double *b) const {
     return false;
 }
 
+/** Zero the values of points outside the screening bounds */
+template<int D>
+void Gaussian<D>::applyScreen(const double *points,
+                              int nPoints,
+                              double *values) const {
+    if (not this->getScreen()) return;
+    for (int i = 0; i < nPoints; i++) {
+        const double *r = points + i*D;
+        for (int d = 0; d < D; d++) {
+            if (r[d] < this->A[d] or r[d] > this->B[d]) {
+                values[i] = 0.0;
+                break;
+            }
+        }
+    }
+}
+
 template<int D>
 void Gaussian<D>::evalf(const MatrixXd &points, MatrixXd &values) const {
     assert(points.cols() == D);
@@ -125,6 +142,32 @@ void Gaussian<D>::evalf(const MatrixXd &points, MatrixXd &values) const {
     }
 }
 
+/** Evaluation on a tensor product grid, using that the Gaussian is a product
+ * of one dimensional factors. Only D*nPts exponentials are computed, and the
+ * values are formed as an outer product of the factors. */
+template<int D>
+void Gaussian<D>::evalfTensor(const double *pts, int nPts, double *values) const {
+    MatrixXd points = Map<const MatrixXd>(pts, nPts, D);
+    MatrixXd factors(nPts, D);
+    evalf(points, factors);
+
+    int len = nPts;
+    for (int i = 0; i < nPts; i++) {
+        values[i] = factors(i, 0);
+    }
+    for (int d = 1; d < D; d++) {
+        // Blocks are filled from the top, block zero is overwritten last
+        for (int j = nPts - 1; j >= 0; j--) {
+            double fac = factors(j, d);
+            double *block = values + j*len;
+            for (int k = 0; k < len; k++) {
+                block[k] = fac*values[k];
+            }
+        }
+        len *= nPts;
+    }
+}
+
 template class Gaussian<1>;
 template class Gaussian<2>;
 template class Gaussian<3>;
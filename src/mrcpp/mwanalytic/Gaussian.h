@@ -29,7 +29,9 @@ public:
 
     virtual double evalf(const double *r) const = 0;
     virtual double evalf(double r, int dim) const = 0;
+    virtual void evalfBatch(const double *points, int nPoints, double *values) const = 0;
     void evalf(const Eigen::MatrixXd &points, Eigen::MatrixXd &values) const;
+    void evalfTensor(const double *pts, int nPts, double *values) const;
 
     virtual double calcSquareNorm() = 0;
     virtual double calcOverlap(GaussFunc<D> &b) = 0;
@@ -104,6 +106,8 @@ protected:
 
     bool isVisibleAtScale(int scale, int nQuadPts) const;
     bool isZeroOnInterval(const double *a, const double *b) const;
+
+    void applyScreen(const double *points, int nPoints, double *values) const;
 };
 
 #endif /* GAUSSIAN_H_ */
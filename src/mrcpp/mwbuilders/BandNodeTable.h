@@ -0,0 +1,78 @@
+#ifndef BANDNODETABLE_H
+#define BANDNODETABLE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "MWTree.h"
+#include "MWNode.h"
+#include "NodeIndex.h"
+
+/** Table of the input tree nodes within reach of an operator, at one scale.
+ *
+ * The nodes are kept in contiguous arrays together with their component
+ * norms, and are found by NodeIndex. The table is filled before the parallel
+ * node loop of a calculator: indices are added serially, and the nodes are
+ * then fetched from the tree (generating missing nodes) in parallel. After
+ * that the table is read-only and can be searched concurrently.
+ */
+template<int D>
+class BandNodeTable {
+public:
+    BandNodeTable() { }
+    virtual ~BandNodeTable() { }
+
+    int size() const { return this->indices.size(); }
+
+    /** Position of a node in the table, or -1 if not present */
+    int find(const NodeIndex<D> &idx) const {
+        typename IndexMap::const_iterator it = this->index.find(idx);
+        if (it == this->index.end()) {
+            return -1;
+        }
+        return it->second;
+    }
+
+    /** Add an index to the table, the node is retrieved by fetchNodes */
+    void add(const NodeIndex<D> &idx) {
+        if (find(idx) >= 0) {
+            return;
+        }
+        this->index[idx] = this->indices.size();
+        this->indices.push_back(idx);
+        this->nodes.push_back(0);
+        for (int t = 0; t < nComp; t++) {
+            this->norms.push_back(-1.0);
+        }
+    }
+
+    /** Retrieve all nodes that have been added since the last call */
+    void fetchNodes(MWTree<D> &tree) {
+        int nNodes = this->indices.size();
+#pragma omp parallel for schedule(guided)
+        for (int n = 0; n < nNodes; n++) {
+            if (this->nodes[n] != 0) {
+                continue;
+            }
+            MWNode<D> &node = tree.getNode(this->indices[n]);
+            for (int t = 0; t < nComp; t++) {
+                this->norms[n*nComp + t] = node.getComponentNorm(t);
+            }
+            this->nodes[n] = &node;
+        }
+    }
+
+    MWNode<D> &getNode(int n) const { return *this->nodes[n]; }
+    const double *getComponentNorms(int n) const { return &this->norms[n*nComp]; }
+
+protected:
+    typedef std::unordered_map<NodeIndex<D>, int, NodeIndexHash<D> > IndexMap;
+    static const int nComp = (1 << D);
+
+    IndexMap index;
+    std::vector<NodeIndex<D> > indices;
+    std::vector<MWNode<D> *> nodes;
+    std::vector<double> norms;
+};
+
+#endif // BANDNODETABLE_H
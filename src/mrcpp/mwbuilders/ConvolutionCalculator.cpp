@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+
 #include "ConvolutionCalculator.h"
 #include "ConvolutionOperator.h"
 #include "OperatorState.h"
@@ -5,6 +8,7 @@
 #include "OperatorNode.h"
 #include "BandWidth.h"
 #include "Timer.h"
+#include "MathUtils.h"
 #include "eigen_disable_warnings.h"
 
 #ifdef HAVE_BLAS
@@ -24,9 +28,14 @@ ConvolutionCalculator<D>::ConvolutionCalculator(double p,
         : maxDepth(depth),
           prec(p),
           oper(&o),
-          fTree(&f) {
+          fTree(&f),
+          ownNodeMap(false) {
     if (this->maxDepth > MaxDepth) MSG_FATAL("Beyond MaxDepth");
+    initNodeMap();
     initBandSizes();
+    initBandTables();
+    initBatches();
+    initTermFactors();
     initTimers();
 }
 
@@ -37,6 +46,21 @@ ConvolutionCalculator<D>::~ConvolutionCalculator() {
     for (int i = 0; i < this->bandSizes.size(); i++) {
         delete this->bandSizes[i];
     }
+    for (int i = 0; i < this->bandTables.size(); i++) {
+        if (this->bandTables[i] != 0) delete this->bandTables[i];
+    }
+    if (this->ownNodeMap) this->fTree->getSerialFunctionTree()->disableNodeMap();
+}
+
+/** The band nodes of f are looked up by NodeIndex, index them in the node
+ map of f for the lifetime of the calculator, unless it already has one */
+template<int D>
+void ConvolutionCalculator<D>::initNodeMap() {
+    SerialFunctionTree<D> &sTree = *this->fTree->getSerialFunctionTree();
+    if (not sTree.hasNodeMap()) {
+        sTree.enableNodeMap();
+        this->ownNodeMap = true;
+    }
 }
 
 template<int D>
@@ -49,6 +73,46 @@ void ConvolutionCalculator<D>::initTimers() {
     }
 }
 
+/** Allocate the per-depth tables of band nodes (filled on demand),
+ and the per-thread band buffers */
+template<int D>
+void ConvolutionCalculator<D>::initBandTables() {
+    this->bandTables.assign(this->maxDepth + 1, 0);
+    this->bandSlots.resize(omp_get_max_threads());
+}
+
+/** Allocate the per-thread batch buffers, sized for all operator terms */
+template<int D>
+void ConvolutionCalculator<D>::initBatches() {
+    int nThreads = omp_get_max_threads();
+    int nTerms = this->oper->size();
+    int kp1 = this->fTree->getKp1();
+    int kp1_dm1 = MathUtils::ipow(kp1, D - 1);
+    this->batchTerms.resize(nThreads);
+    this->batchFactors.resize(nThreads);
+    this->batchOper.resize(nThreads);
+    this->batchProd.resize(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        this->batchTerms[i].reserve(nTerms * D);
+        this->batchFactors[i].reserve(nTerms);
+        this->batchOper[i] = MatrixXd(kp1, nTerms * kp1);
+        this->batchProd[i] = MatrixXd(kp1_dm1, nTerms * kp1);
+    }
+}
+
+/** Precompute the D-dimensional scaling of the operator terms at each depth */
+template<int D>
+void ConvolutionCalculator<D>::initTermFactors() {
+    this->termFactors.resize(this->maxDepth + 1);
+    for (int depth = 0; depth <= this->maxDepth; depth++) {
+        int nTerms = this->oper->getNTerms(depth);
+        for (int n = 0; n < nTerms; n++) {
+            double fac = this->oper->getTermFactor(depth, n, D);
+            this->termFactors[depth].push_back(fac);
+        }
+    }
+}
+
 template<int D>
 void ConvolutionCalculator<D>::clearTimers() {
     this->band_t.clear();
@@ -125,64 +189,145 @@ void ConvolutionCalculator<D>::calcBandSizeFactor(MatrixXi &bs,
     bs(depth, this->nComp2) = bs.row(depth).maxCoeff();
 }
 
-/** Return a vector of nodes in F affected by O, given a node in G */
+/** Step to the next translation in a box of nodes, first direction fastest */
 template<int D>
-MWNodeVector* ConvolutionCalculator<D>::makeOperBand(const MWNode<D> &gNode) {
-    MWNodeVector *band = new MWNodeVector();
+static void nextBandTranslation(int *l, const int *l_start, const int *nbox) {
+    for (int d = 0; d < D; d++) {
+        if (++l[d] < l_start[d] + nbox[d]) {
+            return;
+        }
+        l[d] = l_start[d];
+    }
+}
 
+/** Find the box of nodes in F affected by O, given a node in G. Returns
+ false if the operator has no band at this depth. */
+template<int D>
+bool ConvolutionCalculator<D>::getBandBox(const MWNode<D> &gNode,
+                                          int *l_start,
+                                          int *nbox) const {
     int depth = gNode.getDepth();
     int width = this->oper->getMaxBandWidth(depth);
-    if (width >= 0) {
-        const NodeBox<D> &fWorld = this->fTree->getRootBox();
-        const NodeIndex<D> &cIdx = fWorld.getCornerIndex();
-        const NodeIndex<D> &gIdx = gNode.getNodeIndex();
+    if (width < 0) {
+        return false;
+    }
+    const NodeBox<D> &fWorld = this->fTree->getRootBox();
+    const NodeIndex<D> &cIdx = fWorld.getCornerIndex();
+    const NodeIndex<D> &gIdx = gNode.getNodeIndex();
+
+    for (int i = 0; i < D; i++) {
+        l_start[i] = gIdx.getTranslation(i) - width;
+        int l_end = gIdx.getTranslation(i) + width;
+        // We need to consider the world borders
+        int nboxes = fWorld.size(i) * (1 << depth);
+        int c_i = cIdx.getTranslation(i) * (1 << depth);
+        if (l_start[i] < c_i) {
+            l_start[i] = c_i;
+        }
+        if (l_end > c_i + nboxes - 1) {
+            l_end = c_i + nboxes - 1;
+        }
+        nbox[i] = l_end - l_start[i] + 1;
+    }
+    return true;
+}
 
+/** Add the nodes in F within the bandwidth of the given nodes in G to the
+ band table of their depth, and retrieve them (generating missing nodes).
+ This is done once for each node in F, before the parallel g-node loop,
+ so that the band of each g-node is later found by lookups only.
+
+ The band indices are collected in parallel, in sorted per-thread lists
+ without duplicates, which are then merged into the table of each depth.
+ The band of a g-node is always traversed in translation order, so the
+ result does not depend on the order of the table entries. */
+template<int D>
+void ConvolutionCalculator<D>::fillBandTables(const MWNodeVector &nodeVec) {
+    int nNodes = nodeVec.size();
+    int nDepths = this->bandTables.size();
+    int nThreads = omp_get_max_threads();
+    vector<vector<vector<NodeIndex<D> > > > bandIdx(nThreads);
+
+#pragma omp parallel shared(nodeVec, bandIdx)
+{
+    vector<vector<NodeIndex<D> > > &myIdx = bandIdx[omp_get_thread_num()];
+    myIdx.resize(nDepths);
+#pragma omp for schedule(static)
+    for (int n = 0; n < nNodes; n++) {
+        const MWNode<D> &gNode = *nodeVec[n];
         int l_start[D];
-        int l_end[D];
         int nbox[D];
-        for (int i = 0; i < D; i++) {
-            l_start[i] = gIdx.getTranslation(i) - width;
-            l_end[i] = gIdx.getTranslation(i) + width;
-            // We need to consider the world borders
-            int nboxes = fWorld.size(i) * (1 << depth);
-            int c_i = cIdx.getTranslation(i) * (1 << depth);
-            if (l_start[i] < c_i) {
-                l_start[i] = c_i;
+        if (not getBandBox(gNode, l_start, nbox)) {
+            continue;
+        }
+        vector<NodeIndex<D> > &depthIdx = myIdx[gNode.getDepth()];
+        NodeIndex<D> idx(gNode.getScale(), l_start);
+        int *l = idx.getTranslation();
+        int nBand = 1;
+        for (int d = 0; d < D; d++) {
+            nBand *= nbox[d];
+        }
+        for (int i = 0; i < nBand; i++) {
+            depthIdx.push_back(idx);
+            nextBandTranslation<D>(l, l_start, nbox);
+        }
+    }
+    // neighbouring g-nodes share most of their bands
+    for (int depth = 0; depth < nDepths; depth++) {
+        vector<NodeIndex<D> > &depthIdx = myIdx[depth];
+        sort(depthIdx.begin(), depthIdx.end(), NodeIndexComp<D>());
+        depthIdx.erase(unique(depthIdx.begin(), depthIdx.end()), depthIdx.end());
+    }
+#pragma omp barrier
+#pragma omp for schedule(dynamic)
+    for (int depth = 0; depth < nDepths; depth++) {
+        for (int t = 0; t < nThreads; t++) {
+            if (bandIdx[t].size() == 0) continue;//thread not in the team
+            const vector<NodeIndex<D> > &depthIdx = bandIdx[t][depth];
+            if (depthIdx.size() == 0) continue;
+            if (this->bandTables[depth] == 0) {
+                this->bandTables[depth] = new BandNodeTable<D>;
             }
-            if (l_end[i] > c_i + nboxes - 1) {
-                l_end[i] = c_i + nboxes - 1;
+            BandNodeTable<D> &table = *this->bandTables[depth];
+            for (int i = 0; i < depthIdx.size(); i++) {
+                table.add(depthIdx[i]);
             }
-            nbox[i] = l_end[i] - l_start[i] + 1;
         }
-
-        int scale = gNode.getScale();
-        NodeIndex<D> idx(scale, l_start);
-
-        fillOperBand(band, idx, nbox, D-1);
     }
-    return band;
+}
+    for (int i = 0; i < this->bandTables.size(); i++) {
+        if (this->bandTables[i] != 0) {
+            this->bandTables[i]->fetchNodes(*this->fTree);
+        }
+    }
 }
 
-/** Recursively retrieve all reachable f-nodes within the bandwidth. */
+/** Collect the band table positions of the nodes in F affected by O, given
+ a node in G. The band vector is reused, so this does not allocate once it
+ has grown to the largest band size. */
 template<int D>
-void ConvolutionCalculator<D>::fillOperBand(MWNodeVector *band,
-                                                NodeIndex<D> &idx,
-                                                const int *nbox,
-                                                int dim) {
+void ConvolutionCalculator<D>::makeOperBand(const MWNode<D> &gNode,
+                                            vector<int> &band) const {
+    band.clear();
+    int l_start[D];
+    int nbox[D];
+    if (not getBandBox(gNode, l_start, nbox)) {
+        return;
+    }
+    const BandNodeTable<D> &table = *this->bandTables[gNode.getDepth()];
+
+    NodeIndex<D> idx(gNode.getScale(), l_start);
     int *l = idx.getTranslation();
-    int l_start = l[dim];
-    for (int j = 0; j < nbox[dim]; j++) {
-        // Recurse until dim == 0
-        if (dim > 0) {
-            fillOperBand(band, idx, nbox, dim - 1);
-            l[dim]++;
-            continue;
-        }
-        MWNode<D> &fNode = this->fTree->getNode(idx);
-        band->push_back(&fNode);
-        l[dim]++;
+    int nNodes = 1;
+    for (int d = 0; d < D; d++) {
+        nNodes *= nbox[d];
+    }
+    for (int i = 0; i < nNodes; i++) {
+        int n = table.find(idx);
+        assert(n >= 0);
+        band.push_back(n);
+        nextBandTranslation<D>(l, l_start, nbox);
     }
-    l[dim] = l_start;
 }
 
 template<int D>
@@ -207,7 +352,9 @@ void ConvolutionCalculator<D>::calcNode(MWNode<D> &node) {
 
     // Get all nodes in f within the bandwith of O in g
     this->band_t[omp_get_thread_num()].resume();
-    MWNodeVector *fBand = makeOperBand(gNode);
+    vector<int> &fBand = this->bandSlots[omp_get_thread_num()];
+    makeOperBand(gNode, fBand);
+    const BandNodeTable<D> *fTable = this->bandTables[depth];
     this->band_t[omp_get_thread_num()].stop();
 
     MWTree<D> &gTree = gNode.getMWTree();
@@ -219,12 +366,12 @@ void ConvolutionCalculator<D>::calcNode(MWNode<D> &node) {
     os.gThreshold = gThrs;
 
     this->calc_t[omp_get_thread_num()].resume();
-    for (int n = 0; n < fBand->size(); n++) {
-        MWNode<D> &fNode = *(*fBand)[n];
+    for (int n = 0; n < fBand.size(); n++) {
+        MWNode<D> &fNode = fTable->getNode(fBand[n]);
+        const double *fNorms = fTable->getComponentNorms(fBand[n]);
         os.setFNode(fNode);
         for (int ft = 0; ft < this->nComp; ft++) {
-            double fNorm = fNode.getComponentNorm(ft);
-            if (fNorm < MachineZero) {
+            if (fNorms[ft] < MachineZero) {
                 continue;
             }
             os.setFComponent(ft);
@@ -241,30 +388,54 @@ void ConvolutionCalculator<D>::calcNode(MWNode<D> &node) {
     this->norm_t[omp_get_thread_num()].resume();
     gNode.calcNorms();
     this->norm_t[omp_get_thread_num()].stop();
-    delete fBand;
 }
 
-/** Apply each component (term) of the operator expansion to a node in f */
+/** Apply each component (term) of the operator expansion to a node in f.
+ *
+ * Only the terms that are active at this depth are considered, with the
+ * components that are proportional to a term merged into it (see
+ * MWOperator::calcTerms). The terms are sorted by decreasing band width,
+ * so the loop ends at the first term that cannot reach the f-node. The
+ * terms that survive the screening are collected and applied as one
+ * batch, see tensorApplyOperBatch. */
 template<int D>
 void ConvolutionCalculator<D>::applyOperComp(OperatorState<D> &os) {
     int depth = os.gNode->getDepth();
     double fNorm = os.fNode->getComponentNorm(os.ft);
-    for (int i = 0; i < this->oper->size(); i++) {
+    double **oData = os.getOperData();
+    vector<double *> &terms = this->batchTerms[omp_get_thread_num()];
+    vector<double> &factors = this->batchFactors[omp_get_thread_num()];
+    terms.clear();
+    factors.clear();
+    int nTerms = this->oper->getNTerms(depth);
+    for (int n = 0; n < nTerms; n++) {
+        int i = this->oper->getTerm(depth, n);
         const OperatorTree &ot = this->oper->getComponent(i);
         const BandWidth &bw = ot.getBandWidth();
         if (os.getMaxDeltaL() > bw.getMaxWidth(depth)) {
-            continue;
+            break;
         }
+        // merged factors can be negative, the sign only enters the product
+        double fac = this->termFactors[depth][n];
         os.oTree = &ot;
-        os.fThreshold = getBandSizeFactor(i, depth, os) * fNorm;
-        applyOperator(os);
+        os.fThreshold = std::abs(fac) * getBandSizeFactor(i, depth, os) * fNorm;
+        if (applyOperator(os)) {
+            for (int d = 0; d < D; d++) {
+                terms.push_back(oData[d]);
+            }
+            factors.push_back(fac);
+        }
+    }
+    if (terms.size() > 0) {
+        tensorApplyOperBatch(os, terms, factors);
     }
 }
 
-/** Apply a single operator component (term) to a single f-node. Whether the
-operator actualy is applied is determined by a screening threshold. */
+/** Screen a single operator component (term) against a single f-node.
+Returns true if the operator should be applied, in which case the operator
+data of each direction is left in the OperatorState. */
 template<int D>
-void ConvolutionCalculator<D>::applyOperator(OperatorState<D> &os) {
+bool ConvolutionCalculator<D>::applyOperator(OperatorState<D> &os) {
     const OperatorTree &oTree = *os.oTree;
     MWNode<D> &gNode = *os.gNode;
     MWNode<D> &fNode = *os.fNode;
@@ -286,7 +457,7 @@ void ConvolutionCalculator<D>::applyOperator(OperatorState<D> &os) {
         int idx = (a << 1) + b;
         int w = oTree.getBandWidth().getWidth(depth, idx);
         if (abs(oTransl) > w) {
-            return;
+            return false;
         }
 
         const OperatorNode &oNode = oTree.getNode(depth, oTransl);
@@ -297,19 +468,91 @@ void ConvolutionCalculator<D>::applyOperator(OperatorState<D> &os) {
     double upperBound = oNorm * os.fThreshold;
     if (upperBound > os.gThreshold) {
         this->operStat.incrementFNodeCounters(fNode, os.ft, os.gt);
+        return true;
+    }
+    return false;
+}
+
+/** Apply a batch of operator components to the same f-node component.
+ *
+ * All terms act on the same input in the first direction, so their first
+ * direction operators are packed side by side and applied in one matrix
+ * product, which gives the first intermediate of every term. The remaining
+ * directions are then done term by term. The terms argument holds the D
+ * operator data pointers of each term, and factors the scaling of each
+ * term, which is applied to its first direction operator. */
+template<int D>
+void ConvolutionCalculator<D>::tensorApplyOperBatch(OperatorState<D> &os,
+                                                    const vector<double *> &terms,
+                                                    const vector<double> &factors) {
+    double **aux = os.getAuxData();
+    double **oData = os.getOperData();
+    int nTerms = terms.size() / D;
+    if (nTerms == 1 and factors[0] == 1.0) {
+        for (int d = 0; d < D; d++) {
+            oData[d] = terms[d];
+        }
         tensorApplyOperComp(os);
+        return;
+    }
+
+    int kp1 = os.kp1;
+    int kp1_2 = os.kp1_2;
+    int kp1_d = os.kp1_d;
+    int kp1_dm1 = os.kp1_dm1;
+    int nCols = nTerms * kp1;
+
+    MatrixXd &opers = this->batchOper[omp_get_thread_num()];
+    MatrixXd &prods = this->batchProd[omp_get_thread_num()];
+    for (int t = 0; t < nTerms; t++) {
+        const double *o_t = terms[t*D];
+        double *p_t = opers.data() + t*kp1_2;
+        double fac = factors[t];
+        for (int j = 0; j < kp1_2; j++) {
+            p_t[j] = fac * o_t[j];
+        }
     }
+#ifdef HAVE_BLAS
+    cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+            kp1_dm1, nCols, kp1, 1.0, aux[0],
+            kp1, opers.data(), kp1, 0.0, prods.data(), kp1_dm1);
+#else
+    Map<MatrixXd> f(aux[0], kp1, kp1_dm1);
+    prods.leftCols(nCols).noalias() = f.transpose() * opers.leftCols(nCols);
+#endif
+
+    if (D == 1) {
+        // The product is already the last direction: add up into g
+        for (int t = 0; t < nTerms; t++) {
+            const double *p_t = prods.data() + t*kp1_d;
+            for (int j = 0; j < kp1_d; j++) {
+                aux[D][j] += p_t[j];
+            }
+        }
+        return;
+    }
+    double *aux_1 = aux[1];
+    for (int t = 0; t < nTerms; t++) {
+        for (int d = 0; d < D; d++) {
+            oData[d] = terms[t*D + d];
+        }
+        aux[1] = prods.data() + t*kp1_d;
+        tensorApplyOperComp(os, 1);
+    }
+    aux[1] = aux_1;
 }
 
 /** Perorm the required linear algebra operations in order to apply an
-operator component to a f-node in a n-dimensional tesor space. */
+operator component to a f-node in a n-dimensional tesor space. The first
+dStart directions are assumed to be done already, with the intermediate
+result in aux[dStart]. */
 template<int D>
-void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorState<D> &os) {
+void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorState<D> &os, int dStart) {
     double **aux = os.getAuxData();
     double **oData = os.getOperData();
 #ifdef HAVE_BLAS
     double mult = 0.0;
-    for (int i = 0; i < D; i++) {
+    for (int i = dStart; i < D; i++) {
         if (oData[i] != 0) {
             if (i == D - 1) { // Last dir: Add up into g
                 mult = 1.0;
@@ -333,7 +576,7 @@ void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorState<D> &os) {
         }
     }
 #else
-    for (int i = 0; i < D; i++) {
+    for (int i = dStart; i < D; i++) {
         Map<MatrixXd> f(aux[i], os.kp1, os.kp1_dm1);
         Map<MatrixXd> g(aux[i + 1], os.kp1_dm1, os.kp1);
         if (oData[i] != 0) {
@@ -355,6 +598,40 @@ void ConvolutionCalculator<D>::tensorApplyOperComp(OperatorState<D> &os) {
 #endif
 }
 
+/** Fill the band tables for the new nodes before computing them */
+template<int D>
+void ConvolutionCalculator<D>::calcNodeVector(MWNodeVector &nodeVec) {
+    Timer table_t;
+    fillBandTables(nodeVec);
+    table_t.stop();
+    println(20, "Time band tables    " << table_t);
+    TreeCalculator<D>::calcNodeVector(nodeVec);
+}
+
+/** Estimate the cost of each g-node as the number of f-nodes in its band
+ times the number of operator terms active at its depth. Nodes near the
+ world borders have smaller bands, and the number of terms grows with
+ depth, so the cost varies by orders of magnitude over the work vector. */
+template<int D>
+void ConvolutionCalculator<D>::getNodeCosts(const MWNodeVector &nodeVec,
+                                            vector<double> &costs) const {
+    costs.resize(nodeVec.size());
+    for (int n = 0; n < nodeVec.size(); n++) {
+        const MWNode<D> &gNode = *nodeVec[n];
+        costs[n] = 1.0;
+        int l_start[D];
+        int nbox[D];
+        if (not getBandBox(gNode, l_start, nbox)) {
+            continue;
+        }
+        double nBand = 1.0;
+        for (int d = 0; d < D; d++) {
+            nBand *= nbox[d];
+        }
+        costs[n] += nBand * this->oper->getNTerms(gNode.getDepth());
+    }
+}
+
 template<int D>
 MWNodeVector* ConvolutionCalculator<D>::getInitialWorkVector(MWTree<D> &tree) const {
     MWNodeVector *nodeVec = new MWNodeVector;
@@ -2,6 +2,7 @@
 #define CONVOLUTIONCALCULATOR_H
 
 #include "TreeCalculator.h"
+#include "BandNodeTable.h"
 #include "OperatorStatistics.h"
 #include "mrcpp_declarations.h"
 
@@ -15,12 +16,14 @@ public:
     virtual ~ConvolutionCalculator();
 
     virtual MWNodeVector* getInitialWorkVector(MWTree<D> &tree) const;
+    virtual void calcNodeVector(MWNodeVector &nodeVec);
 
 protected:
     int maxDepth;
     double prec;
     ConvolutionOperator<D> *oper;
     FunctionTree<D> *fTree;
+    bool ownNodeMap;
     std::vector<Timer> band_t;
     std::vector<Timer> calc_t;
     std::vector<Timer> norm_t;
@@ -28,21 +31,41 @@ protected:
     OperatorStatistics<D> operStat;
     std::vector<Eigen::MatrixXi *> bandSizes;
 
+    // Nodes of f within the operator band, per depth, and per-thread bands
+    std::vector<BandNodeTable<D> *> bandTables;
+    std::vector<std::vector<int> > bandSlots;
+
+    // Per-thread work space for the batched operator application
+    std::vector<std::vector<double *> > batchTerms;
+    std::vector<std::vector<double> > batchFactors;
+    std::vector<Eigen::MatrixXd> batchOper;
+    std::vector<Eigen::MatrixXd> batchProd;
+
+    // Scaling of each (merged) operator term per depth, see MWOperator
+    std::vector<std::vector<double> > termFactors;
+
     static const int nComp = (1 << D);
     static const int nComp2 = (1 << D) * (1 << D);
 
-    MWNodeVector* makeOperBand(const MWNode<D> &gNode);
-    void fillOperBand(MWNodeVector *band, NodeIndex<D> &idx, const int *nbox, int dim);
+    bool getBandBox(const MWNode<D> &gNode, int *l_start, int *nbox) const;
+    void fillBandTables(const MWNodeVector &nodeVec);
+    void makeOperBand(const MWNode<D> &gNode, std::vector<int> &band) const;
 
+    void initNodeMap();
     void initTimers();
     void clearTimers();
     void printTimers() const;
 
+    void initBatches();
+    void initTermFactors();
+    void initBandTables();
     void initBandSizes();
     int getBandSizeFactor(int i, int depth,const OperatorState<D> &os) const;
     void calcBandSizeFactor(Eigen::MatrixXi &bs, int depth, const BandWidth &bw);
 
     virtual void calcNode(MWNode<D> &node);
+    virtual void getNodeCosts(const MWNodeVector &nodeVec,
+                              std::vector<double> &costs) const;
     virtual void postProcess() {
         printTimers();
         clearTimers();
@@ -50,8 +73,11 @@ protected:
     }
 
     void applyOperComp(OperatorState<D> &os);
-    void applyOperator(OperatorState<D> &os);
-    void tensorApplyOperComp(OperatorState<D> &os);
+    bool applyOperator(OperatorState<D> &os);
+    void tensorApplyOperComp(OperatorState<D> &os, int dStart = 0);
+    void tensorApplyOperBatch(OperatorState<D> &os,
+                              const std::vector<double *> &terms,
+                              const std::vector<double> &factors);
 };
 
 
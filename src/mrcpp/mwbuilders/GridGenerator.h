@@ -5,6 +5,7 @@
 #include "DefaultCalculator.h"
 #include "AnalyticAdaptor.h"
 #include "CopyAdaptor.h"
+#include "UnionGrid.h"
 
 template<int D>
 class GridGenerator {
@@ -26,9 +27,17 @@ public:
         println(10, std::endl);
     }
 
+    /** Extend the grid of out with the grid of inp. Without an iteration
+      * limit the grid is copied directly by UnionGrid, otherwise the tree is
+      * refined max_iter times by TreeBuilder. */
     void operator()(FunctionTree<D> &out,
                     FunctionTree<D> &inp,
                     int max_iter = -1) const {
+        if (max_iter < 0) {
+            UnionGrid<D> grid(inp, this->maxScale);
+            grid.stamp(out);
+            return;
+        }
         TreeBuilder<D> builder;
         CopyAdaptor<D> adaptor(inp, this->maxScale, 0);
         DefaultCalculator<D> calculator;
@@ -36,9 +45,26 @@ public:
         println(10, std::endl);
     }
 
+    /** Extend the grid of out with the union of the grids of inp_a and inp_b */
+    void operator()(FunctionTree<D> &out,
+                    FunctionTree<D> &inp_a,
+                    FunctionTree<D> &inp_b) const {
+        FunctionTreeVector<D> inp_vec;
+        inp_vec.push_back(&inp_a);
+        inp_vec.push_back(&inp_b);
+        UnionGrid<D> grid(inp_vec, this->maxScale);
+        grid.stamp(out);
+    }
+
+    /** Extend the grid of out with the union of the grids in inp */
     void operator()(FunctionTree<D> &out,
                     FunctionTreeVector<D> &inp,
                     int max_iter = -1) const {
+        if (max_iter < 0 and inp.size() > 0) {
+            UnionGrid<D> grid(inp, this->maxScale);
+            grid.stamp(out);
+            return;
+        }
         TreeBuilder<D> builder;
         CopyAdaptor<D> adaptor(inp, this->maxScale, 0);
         DefaultCalculator<D> calculator;
@@ -0,0 +1,183 @@
+#include "MWOverlap.h"
+#include "MWNode.h"
+#include "HilbertPath.h"
+#include "eigen_disable_warnings.h"
+
+using namespace std;
+using namespace Eigen;
+
+/** Overlap matrix between the functions of bra (rows) and ket (columns) */
+template<int D>
+MatrixXd MWOverlap<D>::operator()(FunctionTreeVector<D> &bra,
+                                  FunctionTreeVector<D> &ket) const {
+    return calcOverlap(bra, ket, false);
+}
+
+/** Symmetric overlap matrix within a set of functions */
+template<int D>
+MatrixXd MWOverlap<D>::operator()(FunctionTreeVector<D> &bra) const {
+    return calcOverlap(bra, bra, true);
+}
+
+template<int D>
+MatrixXd MWOverlap<D>::calcOverlap(FunctionTreeVector<D> &bra,
+                                   FunctionTreeVector<D> &ket,
+                                   bool symmetric) const {
+    int nBra = bra.size();
+    int nKet = ket.size();
+    MatrixXd S = MatrixXd::Zero(nBra, nKet);
+    if (nBra == 0 or nKet == 0) return S;
+
+    const MultiResolutionAnalysis<D> &mra = bra.getFunc(0).getMRA();
+    for (int i = 0; i < nBra; i++) {
+        if (bra.getFunc(i).getMRA() != mra) MSG_ERROR("Trees not compatible");
+    }
+    for (int j = 0; j < nKet; j++) {
+        if (ket.getFunc(j).getMRA() != mra) MSG_ERROR("Trees not compatible");
+    }
+
+    NodeTable table;
+    int nRoots = mra.getWorldBox().size();
+    for (int rIdx = 0; rIdx < nRoots; rIdx++) {
+        vector<const MWNode<D> *> braNodes;
+        vector<const MWNode<D> *> ketNodes;
+        vector<int> braIds;
+        vector<int> ketIds;
+        for (int i = 0; i < nBra; i++) {
+            braNodes.push_back(&bra.getFunc(i).getRootBox().getNode(rIdx));
+            braIds.push_back(i);
+        }
+        if (not symmetric) {
+            for (int j = 0; j < nKet; j++) {
+                ketNodes.push_back(&ket.getFunc(j).getRootBox().getNode(rIdx));
+                ketIds.push_back(j);
+            }
+        }
+        collectNodes(table, braNodes, braIds, ketNodes, ketIds, symmetric);
+    }
+
+    int nGroups = table.groups.size();
+    int nP = min(this->nParts, nGroups);
+    vector<MatrixXd> partS(nP);
+#pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < nP; p++) {
+        int gStart = (p*nGroups)/nP;
+        int gEnd = ((p + 1)*nGroups)/nP;
+        MatrixXd &S_p = partS[p];
+        S_p = MatrixXd::Zero(nBra, nKet);
+
+        MatrixXd braCoefs, ketCoefs, prod;
+        for (int g = gStart; g < gEnd; g++) {
+            const NodeGroup &group = table.groups[g];
+            const int *bIds = &table.ids[group.braStart];
+            const int *kIds = &table.ids[group.ketStart];
+            gatherCoefs(braCoefs, table, group.braStart, group.nBra);
+            if (symmetric) {
+                prod = MatrixXd::Zero(group.nBra, group.nBra);
+                prod.selfadjointView<Lower>().rankUpdate(braCoefs.transpose());
+                for (int j = 0; j < group.nBra; j++) {
+                    for (int i = j; i < group.nBra; i++) {
+                        S_p(bIds[i], bIds[j]) += prod(i, j);
+                    }
+                }
+            } else {
+                gatherCoefs(ketCoefs, table, group.ketStart, group.nKet);
+                prod.noalias() = braCoefs.transpose() * ketCoefs;
+                for (int j = 0; j < group.nKet; j++) {
+                    for (int i = 0; i < group.nBra; i++) {
+                        S_p(bIds[i], kIds[j]) += prod(i, j);
+                    }
+                }
+            }
+        }
+    }
+    for (int p = 0; p < nP; p++) {
+        S += partS[p];
+    }
+    if (symmetric) {
+        S.triangularView<StrictlyUpper>() = S.transpose();
+    }
+    for (int i = 0; i < nBra; i++) {
+        for (int j = 0; j < nKet; j++) {
+            S(i, j) *= bra.getCoef(i) * ket.getCoef(j);
+        }
+    }
+    return S;
+}
+
+/** Collect the nodes of each node index in the union of the grids.
+ *
+ * The trees are traversed together, top down with children in Hilbert order.
+ * Nodes are only included from trees where they are not GenNodes, and the
+ * recursion stops when no bra or no ket function is left. Function ids are
+ * kept in increasing order. */
+template<int D>
+void MWOverlap<D>::collectNodes(NodeTable &table,
+                                const vector<const MWNode<D> *> &braNodes,
+                                const vector<int> &braIds,
+                                const vector<const MWNode<D> *> &ketNodes,
+                                const vector<int> &ketIds,
+                                bool symmetric) const {
+    if (braNodes.size() == 0) return;
+    if (not symmetric and ketNodes.size() == 0) return;
+
+    NodeGroup group;
+    group.braStart = table.nodes.size();
+    group.nBra = braNodes.size();
+    table.nodes.insert(table.nodes.end(), braNodes.begin(), braNodes.end());
+    table.ids.insert(table.ids.end(), braIds.begin(), braIds.end());
+    if (symmetric) {
+        group.ketStart = group.braStart;
+        group.nKet = group.nBra;
+    } else {
+        group.ketStart = table.nodes.size();
+        group.nKet = ketNodes.size();
+        table.nodes.insert(table.nodes.end(), ketNodes.begin(), ketNodes.end());
+        table.ids.insert(table.ids.end(), ketIds.begin(), ketIds.end());
+    }
+    table.groups.push_back(group);
+
+    const HilbertPath<D> &h = braNodes[0]->getHilbertPath();
+    for (int n = 0; n < (1 << D); n++) {
+        int cIdx = h.getZIndex(n);
+        vector<const MWNode<D> *> braChildren;
+        vector<const MWNode<D> *> ketChildren;
+        vector<int> braChildIds;
+        vector<int> ketChildIds;
+        for (int i = 0; i < braNodes.size(); i++) {
+            if (braNodes[i]->isEndNode()) continue;
+            braChildren.push_back(&braNodes[i]->getMWChild(cIdx));
+            braChildIds.push_back(braIds[i]);
+        }
+        for (int j = 0; j < ketNodes.size(); j++) {
+            if (ketNodes[j]->isEndNode()) continue;
+            ketChildren.push_back(&ketNodes[j]->getMWChild(cIdx));
+            ketChildIds.push_back(ketIds[j]);
+        }
+        collectNodes(table, braChildren, braChildIds, ketChildren, ketChildIds, symmetric);
+    }
+}
+
+/** Copy the coefficients of nNodes nodes of the table into the columns of
+ * a matrix. Root nodes include the scaling part, other nodes contribute only
+ * with their wavelet part. */
+template<int D>
+void MWOverlap<D>::gatherCoefs(MatrixXd &coefs,
+                               const NodeTable &table,
+                               int start,
+                               int nNodes) const {
+    const MWNode<D> &first = *table.nodes[start];
+    int kp1_d = first.getKp1_d();
+    int offset = (first.isRootNode()) ? 0 : kp1_d;
+    int size = first.getTDim()*kp1_d - offset;
+    coefs.resize(size, nNodes);
+    for (int n = 0; n < nNodes; n++) {
+        const MWNode<D> &node = *table.nodes[start + n];
+        assert(node.hasCoefs());
+        coefs.col(n) = Map<const VectorXd>(node.getCoefs() + offset, size);
+    }
+}
+
+template class MWOverlap<1>;
+template class MWOverlap<2>;
+template class MWOverlap<3>;
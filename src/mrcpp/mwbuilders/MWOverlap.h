@@ -0,0 +1,67 @@
+#ifndef MWOVERLAP_H
+#define MWOVERLAP_H
+
+#include <vector>
+
+#include "mrcpp_declarations.h"
+#include "FunctionTreeVector.h"
+
+/** Overlap matrix between two sets of functions.
+ *
+ * All trees are traversed together, node index by node index, over the
+ * union of their grids. At each node the coefficient blocks of the functions
+ * present are gathered into matrices, and the block of inner products is
+ * computed with a single matrix product. For a single set only the lower
+ * triangle is computed (the matrix is symmetric).
+ *
+ * The nodes are processed in a fixed number of contiguous parts, each summed
+ * into its own partial matrix, and the parts are added in order. The result
+ * is therefore independent of the number of threads.
+ *
+ * The coefficients of the tree vectors are included: S_ij = c_i c_j <f_i|f_j>
+ */
+template<int D>
+class MWOverlap {
+public:
+    MWOverlap(int np = 16) : nParts(np) { }
+    virtual ~MWOverlap() { }
+
+    Eigen::MatrixXd operator()(FunctionTreeVector<D> &bra,
+                               FunctionTreeVector<D> &ket) const;
+    Eigen::MatrixXd operator()(FunctionTreeVector<D> &bra) const;
+
+protected:
+    int nParts;
+
+    // Functions present at one node index, stored in the flat arrays below
+    struct NodeGroup {
+        int braStart;
+        int nBra;
+        int ketStart;
+        int nKet;
+    };
+
+    struct NodeTable {
+        std::vector<NodeGroup> groups;
+        std::vector<const MWNode<D> *> nodes;
+        std::vector<int> ids;
+    };
+
+    Eigen::MatrixXd calcOverlap(FunctionTreeVector<D> &bra,
+                                FunctionTreeVector<D> &ket,
+                                bool symmetric) const;
+
+    void collectNodes(NodeTable &table,
+                      const std::vector<const MWNode<D> *> &braNodes,
+                      const std::vector<int> &braIds,
+                      const std::vector<const MWNode<D> *> &ketNodes,
+                      const std::vector<int> &ketIds,
+                      bool symmetric) const;
+
+    void gatherCoefs(Eigen::MatrixXd &coefs,
+                     const NodeTable &table,
+                     int start,
+                     int nNodes) const;
+};
+
+#endif // MWOVERLAP_H
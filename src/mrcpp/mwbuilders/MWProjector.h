@@ -33,7 +33,9 @@ public:
         WaveletAdaptor<D> adaptor(this->prec, this->maxScale);
         ProjectionCalculator<D> calculator(inp);
 
+        inp.setupScreening();
         builder.build(out, calculator, adaptor, maxIter);
+        inp.clearScreening();
 
         Timer trans_t;
         out.mwTransform(BottomUp);
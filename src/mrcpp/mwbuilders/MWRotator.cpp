@@ -0,0 +1,117 @@
+#include "MWRotator.h"
+#include "UnionGrid.h"
+#include "MWNode.h"
+#include "Timer.h"
+#include "eigen_disable_warnings.h"
+
+using namespace std;
+using namespace Eigen;
+
+template<int D>
+void MWRotator<D>::operator()(FunctionTreeVector<D> &out,
+                              const MatrixXd &U,
+                              FunctionTreeVector<D> &inp) const {
+    if (U.rows() != out.size()) MSG_ERROR("Invalid arguments");
+    if (U.cols() != inp.size()) MSG_ERROR("Invalid arguments");
+    if (out.size() == 0) return;
+    for (int i = 0; i < out.size(); i++) {
+        const FunctionTree<D> &out_i = out.getFunc(i);
+        if (out_i.getNNodes() != out_i.getRootBox().size()) MSG_ERROR("Output not empty");
+    }
+
+    // Inputs that contribute to any output, with coefficients included
+    FunctionTreeVector<D> act_inp;
+    vector<int> act_idx;
+    for (int j = 0; j < inp.size(); j++) {
+        if (U.col(j).cwiseAbs().maxCoeff() < MachineZero) continue;
+        act_inp.push_back(inp.getCoef(j), &inp.getFunc(j));
+        act_idx.push_back(j);
+    }
+    MatrixXd U_t = MatrixXd::Zero(act_inp.size(), out.size());
+    for (int j = 0; j < act_inp.size(); j++) {
+        U_t.row(j) = act_inp.getCoef(j) * U.col(act_idx[j]).transpose();
+    }
+
+    Timer grid_t;
+    UnionGrid<D> grid(out.getFunc(0).getMRA(), this->maxScale);
+    grid.add(act_inp);
+    for (int i = 0; i < out.size(); i++) {
+        grid.stamp(out.getFunc(i));
+    }
+    grid_t.stop();
+
+    Timer calc_t;
+    calcEndNodes(out, U_t, act_inp);
+    calc_t.stop();
+
+    Timer trans_t;
+    for (int i = 0; i < out.size(); i++) {
+        FunctionTree<D> &out_i = out.getFunc(i);
+        out_i.mwTransform(BottomUp);
+        out_i.calcSquareNorm();
+        if (this->prec >= 0.0) {
+            out_i.crop(this->prec, 1.0, false);
+        }
+    }
+    trans_t.stop();
+
+    Timer clean_t;
+    for (int j = 0; j < act_inp.size(); j++) {
+        act_inp.getFunc(j).deleteGenerated();
+    }
+    clean_t.stop();
+
+    println(10, "Time grid           " << grid_t);
+    println(10, "Time rotate         " << calc_t);
+    println(10, "Time transform      " << trans_t);
+    println(10, "Time cleaning       " << clean_t);
+    println(10, std::endl);
+}
+
+/** Compute the end node coefficients of all outputs.
+ *
+ * All outputs have the same grid, so their end node tables are aligned. At
+ * each end node the input coefficients are stacked as columns (GenNodes only
+ * carry scaling coefficients, the rest is zero) and multiplied by U_t. */
+template<int D>
+void MWRotator<D>::calcEndNodes(FunctionTreeVector<D> &out,
+                                const MatrixXd &U_t,
+                                FunctionTreeVector<D> &inp) const {
+    FunctionTree<D> &out_0 = out.getFunc(0);
+    int nOut = out.size();
+    int nInp = inp.size();
+    int nNodes = out_0.getNEndNodes();
+    for (int i = 1; i < nOut; i++) {
+        if (out.getFunc(i).getNEndNodes() != nNodes) MSG_FATAL("Grid mismatch");
+    }
+
+#pragma omp parallel shared(out, inp)
+{
+    MatrixXd inpCoefs;
+    MatrixXd outCoefs;
+#pragma omp for schedule(guided)
+    for (int n = 0; n < nNodes; n++) {
+        const NodeIndex<D> &idx = out_0.getEndMWNode(n).getNodeIndex();
+        int nCoefs = out_0.getEndMWNode(n).getNCoefs();
+        inpCoefs = MatrixXd::Zero(nCoefs, nInp);
+        for (int j = 0; j < nInp; j++) {
+            // This generates missing nodes
+            const MWNode<D> &node_j = inp.getFunc(j).getNode(idx);
+            int nCoefs_j = node_j.getNCoefs();
+            inpCoefs.col(j).head(nCoefs_j) = Map<const VectorXd>(node_j.getCoefs(), nCoefs_j);
+        }
+        outCoefs.noalias() = inpCoefs * U_t;
+        for (int i = 0; i < nOut; i++) {
+            MWNode<D> &node_i = out.getFunc(i).getEndMWNode(n);
+            assert(node_i.getNodeIndex() == idx);
+            Map<VectorXd>(node_i.getCoefs(), nCoefs) = outCoefs.col(i);
+            node_i.setHasCoefs();
+            node_i.calcNorms();
+        }
+    }
+}
+}
+
+template class MWRotator<1>;
+template class MWRotator<2>;
+template class MWRotator<3>;
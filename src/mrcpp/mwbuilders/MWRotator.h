@@ -0,0 +1,44 @@
+#ifndef MWROTATOR_H
+#define MWROTATOR_H
+
+#include "mrcpp_declarations.h"
+#include "FunctionTreeVector.h"
+
+/** Linear transformation of a set of functions: out_i = sum_j U_ij c_j inp_j
+ *
+ * Instead of one adaptive addition per output, the union grid of the inputs
+ * is built once and copied to all outputs. At each end node the coefficients
+ * of all inputs are stacked into a matrix and all outputs are computed with
+ * a single matrix product. The outputs are finally transformed to compressed
+ * form and, if a precision is given, cropped.
+ *
+ * The output trees must be empty (root nodes only). Inputs whose column of U
+ * is zero are ignored, also in the union grid.
+ */
+template<int D>
+class MWRotator {
+public:
+    MWRotator(double pr = -1.0, int ms = MaxScale)
+        : prec(pr), maxScale(ms) { }
+    virtual ~MWRotator() { }
+
+    double getPrecision() const { return this->prec; }
+    int getMaxScale() const { return this->maxScale; }
+
+    void setPrecision(double pr) { this->prec = pr; }
+    void setMaxScale(int ms) { this->maxScale = ms; }
+
+    void operator()(FunctionTreeVector<D> &out,
+                    const Eigen::MatrixXd &U,
+                    FunctionTreeVector<D> &inp) const;
+
+protected:
+    double prec;
+    int maxScale;
+
+    void calcEndNodes(FunctionTreeVector<D> &out,
+                      const Eigen::MatrixXd &U_t,
+                      FunctionTreeVector<D> &inp) const;
+};
+
+#endif // MWROTATOR_H
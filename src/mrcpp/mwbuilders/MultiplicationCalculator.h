@@ -1,6 +1,9 @@
 #ifndef MULTIPLICATIONCALCULATOR_H
 #define MULTIPLICATIONCALCULATOR_H
 
+#include <algorithm>
+#include <vector>
+
 #include "TreeCalculator.h"
 #include "FunctionTreeVector.h"
 
@@ -11,25 +14,43 @@ class MultiplicationCalculator : public TreeCalculator<D> {
 public:
     friend class MWMultiplier<D>;
 protected:
-    MultiplicationCalculator(FunctionTreeVector<D> &inp) : prod_vec(&inp) { }
+    MultiplicationCalculator(FunctionTreeVector<D> &inp)
+        : prod_vec(&inp),
+          scratch(omp_get_max_threads()) { }
     virtual ~MultiplicationCalculator() { }
 
+    /** Pointwise product on the quadrature grid of the output node.
+     *
+     * The first function is reconstructed and transformed to values directly
+     * in the output node, the remaining ones in a per-thread scratch array
+     * which is multiplied in, so no temporary nodes are allocated. There is
+     * one transform back to compressed coefficients per output node. */
     virtual void calcNode(MWNode<D> &node_o) {
         const NodeIndex<D> &idx = node_o.getNodeIndex();
+        int n_coefs = node_o.getNCoefs();
         double *coefs_o = node_o.getCoefs();
-        for (int j = 0; j < node_o.getNCoefs(); j++) {
-            coefs_o[j] = 1.0;
-        }
+
+        Eigen::VectorXd &buffer = this->scratch[omp_get_thread_num()];
+        if (buffer.size() < n_coefs) buffer.resize(n_coefs);
+        double *coefs_i = buffer.data();
+
         for (int i = 0; i < this->prod_vec->size(); i++) {
             double c_i = this->prod_vec->getCoef(i);
             FunctionTree<D> &func_i = this->prod_vec->getFunc(i);
             // This generates missing nodes
-            MWNode<D> node_i = func_i.getNode(idx); // Copy node
-            node_i.mwTransform(Reconstruction);
-            node_i.cvTransform(Forward);
-            const double *coefs_i = node_i.getCoefs();
-            for (int j = 0; j < node_i.getNCoefs(); j++) {
-                coefs_o[j] *= c_i * coefs_i[j];
+            const MWNode<D> &node_i = func_i.getNode(idx);
+            double *values = (i == 0) ? coefs_o : coefs_i;
+            copyCoefs(node_i, values, n_coefs);
+            node_i.mwTransformCoefs(Reconstruction, values);
+            node_i.cvTransformCoefs(Forward, values);
+            if (i == 0) {
+                for (int j = 0; j < n_coefs; j++) {
+                    coefs_o[j] *= c_i;
+                }
+            } else {
+                for (int j = 0; j < n_coefs; j++) {
+                    coefs_o[j] *= c_i * coefs_i[j];
+                }
             }
         }
         node_o.cvTransform(Backward);
@@ -38,8 +59,25 @@ protected:
         node_o.calcNorms();
     }
 
+    /** Copy the coefficients of a node, padded with zeros (GenNodes carry
+     * only scaling coefficients). */
+    static void copyCoefs(const MWNode<D> &node, double *coefs, int n_coefs) {
+        int n_node = 0;
+        if (node.hasCoefs()) {
+            n_node = std::min(node.getNCoefs(), n_coefs);
+            const double *c = node.getCoefs();
+            for (int j = 0; j < n_node; j++) {
+                coefs[j] = c[j];
+            }
+        }
+        for (int j = n_node; j < n_coefs; j++) {
+            coefs[j] = 0.0;
+        }
+    }
+
 private:
     FunctionTreeVector<D> *prod_vec;
+    std::vector<Eigen::VectorXd> scratch; ///< Per-thread function values
 };
 
 #endif // MULTIPLICATIONCALCULATOR_H
@@ -8,19 +8,21 @@ using namespace Eigen;
 
 template<int D>
 void ProjectionCalculator<D>::calcNode(MWNode<D> &node) {
-    MatrixXd exp_pts;
-    node.getExpandedChildPts(exp_pts);
-
-    assert(exp_pts.cols() == node.getNCoefs());
+    MatrixXd prim_pts;
+    node.getPrimitiveChildPts(prim_pts);
 
     int kp1 = node.getKp1();
-    int np1 = node.getScale() + 1;
-    double two_np1 = pow(2.0, -np1);
+    int kp1_d = node.getKp1_d();
 
+    // The quadrature points of each child form a tensor product grid
+    MatrixXd child_pts(kp1, D);
     double *coefs = node.getCoefs();
-    for (int i = 0; i < node.getNCoefs(); i++) {
-        const double *r = exp_pts.col(i).data();
-        coefs[i] = this->func->evalf(r);
+    for (int t = 0; t < node.getTDim(); t++) {
+        for (int d = 0; d < D; d++) {
+            int idx = (t>>d)&1;
+            child_pts.col(d) = prim_pts.block(d, idx*kp1, 1, kp1).transpose();
+        }
+        this->func->evalfTensor(child_pts.data(), kp1, coefs + t*kp1_d);
     }
     node.cvTransform(Backward);
     node.mwTransform(Compression);
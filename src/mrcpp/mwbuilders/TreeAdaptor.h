@@ -1,8 +1,14 @@
 #ifndef TREEADAPTOR_H
 #define TREEADAPTOR_H
 
+#include <vector>
+
 #include "mrcpp_declarations.h"
 #include "TelePrompter.h"
+#include "MWTree.h"
+#include "MWNode.h"
+#include "SerialTree.h"
+#include "parallel.h"
 
 template<int D>
 class TreeAdaptor {
@@ -12,19 +18,56 @@ public:
 
     void setMaxScale(int ms) { this->maxScale = ms; }
 
+    /** Split the nodes of inp and collect the new children in out.
+      *
+      * The split decisions are made in parallel. Children are created in
+      * parallel when the serial tree allows concurrent allocation, each
+      * thread collecting its children in a contiguous range of inp. The
+      * thread vectors are merged in thread order, so that out keeps the
+      * order of inp regardless of the number of threads.
+      *
+      * The children of each node are collected along the Hilbert path, so
+      * if inp is ordered along the Hilbert curve (as the end node table is)
+      * so is out. Contiguous ranges of the work vector, as handed out to the
+      * threads in the next round, are then spatially compact, and each
+      * thread allocates the children of its own range. */
     void splitNodeVector(MWNodeVector &out, MWNodeVector &inp) const {
-        for (int n = 0; n < inp.size(); n++) {
-            MWNode<D> &node = *inp[n];
+        int nNodes = inp.size();
+        if (nNodes == 0) return;
+
+        std::vector<char> split(nNodes, 0);
+#pragma omp parallel for schedule(guided)
+        for (int n = 0; n < nNodes; n++) {
+            const MWNode<D> &node = *inp[n];
             // Can be BranchNode in operator application
             if (node.isBranchNode()) continue;
             if (node.getScale() + 2 > this->maxScale) continue;
-            if (splitNode(node)) {
-                node.createChildren();
-                for (int i = 0; i < node.getNChildren(); i++) {
-                    out.push_back(&node.getMWChild(i));
-                }
+            if (splitNode(node)) split[n] = 1;
+        }
+
+        MWTree<D> &tree = inp[0]->getMWTree();
+        SerialTree<D> &sTree = *tree.getSerialTree();
+        bool parallel = sTree.isThreadSafe();
+        std::vector<MWNodeVector> threadOut(omp_get_max_threads());
+#pragma omp parallel if(parallel)
+{
+        MWNodeVector &myOut = threadOut[omp_get_thread_num()];
+#pragma omp for schedule(static)
+        for (int n = 0; n < nNodes; n++) {
+            if (not split[n]) continue;
+            MWNode<D> &node = *inp[n];
+            node.createChildren();
+            const HilbertPath<D> &h = node.getHilbertPath();
+            for (int hIdx = 0; hIdx < node.getNChildren(); hIdx++) {
+                int cIdx = h.getZIndex(hIdx);
+                myOut.push_back(&node.getMWChild(cIdx));
             }
         }
+}
+        tree.updateNodeCounts();
+        for (int t = 0; t < threadOut.size(); t++) {
+            out.insert(out.end(), threadOut[t].begin(), threadOut[t].end());
+        }
     }
 
 protected:
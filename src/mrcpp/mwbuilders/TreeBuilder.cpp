@@ -100,24 +100,45 @@ int TreeBuilder<D>::clear(MWTree<D> &tree,
     return nSplit;
 }
 
+/** Sum of squared norms over a node vector, in parallel.
+  *
+  * Partial sums are taken over fixed blocks of nodes and then added in block
+  * order, so the result does not depend on the number of threads. */
 template<int D>
-double TreeBuilder<D>::calcScalingNorm(const MWNodeVector &vec) const {
-    double sNorm = 0.0;
-    for (int i = 0; i < vec.size(); i++) {
-        const MWNode<D> &node = *vec[i];
-        sNorm += node.getScalingNorm();
+double TreeBuilder<D>::calcNorm(const MWNodeVector &vec, bool scaling) const {
+    const int blockSize = 256;
+    int nNodes = vec.size();
+    int nBlocks = (nNodes + blockSize - 1)/blockSize;
+    vector<double> blockNorms(nBlocks, 0.0);
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < nBlocks; b++) {
+        int nEnd = min(nNodes, (b + 1)*blockSize);
+        double norm = 0.0;
+        for (int n = b*blockSize; n < nEnd; n++) {
+            const MWNode<D> &node = *vec[n];
+            if (scaling) {
+                norm += node.getScalingNorm();
+            } else {
+                norm += node.getWaveletNorm();
+            }
+        }
+        blockNorms[b] = norm;
     }
-    return sNorm;
+    double totNorm = 0.0;
+    for (int b = 0; b < nBlocks; b++) {
+        totNorm += blockNorms[b];
+    }
+    return totNorm;
+}
+
+template<int D>
+double TreeBuilder<D>::calcScalingNorm(const MWNodeVector &vec) const {
+    return calcNorm(vec, true);
 }
 
 template<int D>
 double TreeBuilder<D>::calcWaveletNorm(const MWNodeVector &vec) const {
-    double wNorm = 0.0;
-    for (int i = 0; i < vec.size(); i++) {
-        const MWNode<D> &node = *vec[i];
-        wNorm += node.getWaveletNorm();
-    }
-    return wNorm;
+    return calcNorm(vec, false);
 }
 
 template class TreeBuilder<1>;
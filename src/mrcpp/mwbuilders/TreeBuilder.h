@@ -20,6 +20,7 @@ public:
 protected:
     double calcScalingNorm(const MWNodeVector &vec) const;
     double calcWaveletNorm(const MWNodeVector &vec) const;
+    double calcNorm(const MWNodeVector &vec, bool scaling) const;
 };
 
 #endif // TREEBUILDER_H
@@ -1,7 +1,12 @@
 #ifndef TREECALCULATOR_H
 #define TREECALCULATOR_H
 
+#include <vector>
+#include <algorithm>
+
 #include "MWNode.h"
+#include "Timer.h"
+#include "parallel.h"
 #include "mrcpp_declarations.h"
 
 template<int D>
@@ -15,6 +20,11 @@ public:
     }
 
     virtual void calcNodeVector(MWNodeVector &nodeVec) {
+        std::vector<double> costs;
+        getNodeCosts(nodeVec, costs);
+        if (costs.size() > 0 and costs.size() == nodeVec.size()) {
+            calcBalancedNodeVector(nodeVec, costs);
+        } else {
 #pragma omp parallel shared(nodeVec)
 {
         int nNodes = nodeVec.size();
@@ -24,11 +34,80 @@ public:
             calcNode(node);
         }
 }
+        }
         postProcess();
     }
 protected:
     virtual void calcNode(MWNode<D> &node) = 0;
     virtual void postProcess() { }
+
+    /** Estimated (relative) cost of each node in the work vector. Leave the
+     * costs empty if the cost is uniform, which gives a guided schedule. */
+    virtual void getNodeCosts(const MWNodeVector &nodeVec,
+                              std::vector<double> &costs) const { }
+
+    /** Compute the nodes as tasks of about equal estimated cost.
+     *
+     * The work vector is split into contiguous tasks, several per thread, and
+     * the tasks are started in order of decreasing cost. Idle threads pick up
+     * the remaining tasks, so expensive nodes do not end up at the tail of
+     * a single thread. The busy time of each thread is used to report the
+     * remaining load imbalance. */
+    void calcBalancedNodeVector(MWNodeVector &nodeVec,
+                                const std::vector<double> &costs) {
+        int nNodes = nodeVec.size();
+        int nThreads = omp_get_max_threads();
+        int nTasks = std::min(nNodes, 8*nThreads);
+
+        double totCost = 0.0;
+        for (int n = 0; n < nNodes; n++) {
+            totCost += costs[n];
+        }
+        double taskCost = totCost/nTasks;
+
+        std::vector<int> first(1, 0);
+        std::vector<std::pair<double, int> > tasks;
+        double cost = 0.0;
+        for (int n = 0; n < nNodes; n++) {
+            cost += costs[n];
+            if (cost >= taskCost or n == nNodes - 1) {
+                tasks.push_back(std::make_pair(-cost, (int) tasks.size()));
+                first.push_back(n + 1);
+                cost = 0.0;
+            }
+        }
+        std::sort(tasks.begin(), tasks.end());
+
+        std::vector<double> busy(nThreads, 0.0);
+#pragma omp parallel shared(nodeVec, tasks, first, busy)
+{
+#pragma omp single
+{
+        for (int i = 0; i < tasks.size(); i++) {
+            int t = tasks[i].second;
+#pragma omp task firstprivate(t)
+{
+            Timer task_t;
+            for (int n = first[t]; n < first[t + 1]; n++) {
+                calcNode(*nodeVec[n]);
+            }
+            task_t.stop();
+            busy[omp_get_thread_num()] += task_t.getWallTime();
+}
+        }
+}
+}
+        double maxBusy = 0.0;
+        double sumBusy = 0.0;
+        for (int i = 0; i < nThreads; i++) {
+            maxBusy = std::max(maxBusy, busy[i]);
+            sumBusy += busy[i];
+        }
+        if (sumBusy > 0.0) {
+            double imbalance = maxBusy*nThreads/sumBusy;
+            println(20, "Load imbalance      " << imbalance << " (" << tasks.size() << " tasks)");
+        }
+    }
 };
 
 #endif // TREECALCULATOR_H
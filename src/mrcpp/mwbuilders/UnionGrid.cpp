@@ -0,0 +1,137 @@
+#include "UnionGrid.h"
+#include "MWNode.h"
+
+using namespace std;
+
+template<int D>
+UnionGrid<D>::UnionGrid(const MultiResolutionAnalysis<D> &mra, int ms)
+        : maxScale(ms),
+          MRA(&mra) {
+}
+
+template<int D>
+UnionGrid<D>::UnionGrid(FunctionTree<D> &inp, int ms)
+        : maxScale(ms),
+          MRA(&inp.getMRA()) {
+    add(inp);
+}
+
+template<int D>
+UnionGrid<D>::UnionGrid(FunctionTreeVector<D> &inp, int ms)
+        : maxScale(ms),
+          MRA(0) {
+    if (inp.size() == 0) MSG_ERROR("Empty tree vector");
+    this->MRA = &inp.getFunc(0).getMRA();
+    add(inp);
+}
+
+template<int D>
+void UnionGrid<D>::add(FunctionTree<D> &inp) {
+    FunctionTreeVector<D> inp_vec;
+    inp_vec.push_back(&inp);
+    add(inp_vec);
+}
+
+/** Extend the grid with the union of the grids of the input trees */
+template<int D>
+void UnionGrid<D>::add(FunctionTreeVector<D> &inp) {
+    for (int i = 0; i < inp.size(); i++) {
+        if (inp.getFunc(i).getMRA() != *this->MRA) MSG_ERROR("Trees not compatible");
+    }
+    vector<char> flags;
+    int pos = (this->splitFlags.size() > 0) ? 0 : -1;
+    int scale = this->MRA->getWorldBox().getScale();
+    int nRoots = this->MRA->getWorldBox().size();
+    for (int rIdx = 0; rIdx < nRoots; rIdx++) {
+        vector<const MWNode<D> *> roots;
+        for (int i = 0; i < inp.size(); i++) {
+            roots.push_back(&inp.getFunc(i).getRootMWNode(rIdx));
+        }
+        mergeNode(flags, pos, scale, roots);
+    }
+    this->splitFlags.swap(flags);
+}
+
+/** Depth first walk over the current grid and the input nodes together.
+ *
+ * pos is the position of the node in the current flags, or negative if the
+ * current grid does not reach this node. A node is split if it is split in
+ * the current grid or in any of the inputs, limited by maxScale as in
+ * TreeAdaptor. */
+template<int D>
+void UnionGrid<D>::mergeNode(vector<char> &flags,
+                             int &pos,
+                             int scale,
+                             const vector<const MWNode<D> *> &nodes) const {
+    bool oldSplit = false;
+    if (pos >= 0) {
+        oldSplit = this->splitFlags[pos];
+        pos++;
+    }
+    bool inpSplit = false;
+    for (int i = 0; i < nodes.size(); i++) {
+        if (not nodes[i]->isEndNode()) inpSplit = true;
+    }
+    if (scale + 2 > this->maxScale) inpSplit = false;
+
+    bool split = (oldSplit or inpSplit);
+    flags.push_back(split);
+    if (not split) return;
+
+    for (int cIdx = 0; cIdx < (1 << D); cIdx++) {
+        vector<const MWNode<D> *> children;
+        for (int i = 0; i < nodes.size(); i++) {
+            if (nodes[i]->isEndNode()) continue;
+            children.push_back(&nodes[i]->getMWChild(cIdx));
+        }
+        if (oldSplit) {
+            mergeNode(flags, pos, scale + 1, children);
+        } else {
+            int noPos = -1;
+            mergeNode(flags, noPos, scale + 1, children);
+        }
+    }
+}
+
+/** Refine the output tree to (at least) the union grid.
+ *
+ * As with GridGenerator, all end nodes of the resulting grid are left
+ * without coefficients. */
+template<int D>
+void UnionGrid<D>::stamp(FunctionTree<D> &out) const {
+    if (out.getMRA() != *this->MRA) MSG_ERROR("Trees not compatible");
+    out.deleteGenerated();
+    if (this->splitFlags.size() > 0) {
+        int pos = 0;
+        for (int rIdx = 0; rIdx < out.getRootBox().size(); rIdx++) {
+            stampNode(out.getRootMWNode(rIdx), pos);
+        }
+        assert(pos == this->splitFlags.size());
+    }
+    out.resetEndNodeTable();
+    for (int n = 0; n < out.getNEndNodes(); n++) {
+        MWNode<D> &node = out.getEndMWNode(n);
+        node.clearHasCoefs();
+        node.clearNorms();
+    }
+    out.clearSquareNorm();
+}
+
+template<int D>
+void UnionGrid<D>::stampNode(MWNode<D> &node, int &pos) const {
+    bool split = this->splitFlags[pos];
+    pos++;
+    if (not split) return;
+    if (node.isLeafNode()) {
+        node.clearHasCoefs();
+        node.clearNorms();
+        node.createChildren();
+    }
+    for (int cIdx = 0; cIdx < node.getTDim(); cIdx++) {
+        stampNode(node.getMWChild(cIdx), pos);
+    }
+}
+
+template class UnionGrid<1>;
+template class UnionGrid<2>;
+template class UnionGrid<3>;
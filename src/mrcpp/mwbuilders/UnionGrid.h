@@ -0,0 +1,48 @@
+#ifndef UNIONGRID_H
+#define UNIONGRID_H
+
+#include <vector>
+
+#include "mrcpp_declarations.h"
+#include "FunctionTreeVector.h"
+#include "constants.h"
+
+/** Union of the grids of a set of trees, as a reusable template.
+ *
+ * The input trees are traversed together in a single depth first walk, and
+ * a node of the union grid is split if it is split (not an EndNode) in any
+ * of the inputs. No node lookups are needed. The grid is stored as one
+ * split flag per node in depth first order, and can be stamped onto any
+ * number of output trees. Stamping only adds nodes, so the output keeps its
+ * own grid as well, as with repeated calls to GridGenerator.
+ */
+template<int D>
+class UnionGrid {
+public:
+    UnionGrid(const MultiResolutionAnalysis<D> &mra, int ms = MaxScale);
+    UnionGrid(FunctionTree<D> &inp, int ms = MaxScale);
+    UnionGrid(FunctionTreeVector<D> &inp, int ms = MaxScale);
+    virtual ~UnionGrid() { }
+
+    int getNNodes() const { return this->splitFlags.size(); }
+
+    void add(FunctionTree<D> &inp);
+    void add(FunctionTreeVector<D> &inp);
+
+    void stamp(FunctionTree<D> &out) const;
+
+protected:
+    int maxScale;
+    const MultiResolutionAnalysis<D> *MRA;
+
+    // Split flag per node, depth first starting from each root node
+    std::vector<char> splitFlags;
+
+    void mergeNode(std::vector<char> &flags,
+                   int &pos,
+                   int scale,
+                   const std::vector<const MWNode<D> *> &nodes) const;
+    void stampNode(MWNode<D> &node, int &pos) const;
+};
+
+#endif // UNIONGRID_H
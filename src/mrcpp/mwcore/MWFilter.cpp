@@ -84,6 +84,15 @@ void MWFilter::fillFilterBlocks() {
     this->G1t = this->G1.transpose();
     this->H0t = this->H0.transpose();
     this->H1t = this->H1.transpose();
+
+    this->compressionBlocks = MatrixXd(K*K, 4);
+    this->reconstructionBlocks = MatrixXd(K*K, 4);
+    for (int i = 0; i < 4; i++) {
+        const MatrixXd &cBlock = getCompressionSubFilter(i);
+        const MatrixXd &rBlock = getReconstructionSubFilter(i);
+        this->compressionBlocks.col(i) = Map<const VectorXd>(cBlock.data(), K*K);
+        this->reconstructionBlocks.col(i) = Map<const VectorXd>(rBlock.data(), K*K);
+    }
 }
 
 const MatrixXd& MWFilter::getSubFilter(int i, int oper) const {
@@ -121,6 +130,21 @@ const MatrixXd& MWFilter::getSubFilter(int i, int oper) const {
     }
 }
 
+/** All four sub-filters of an operation in one (K*K x 4) matrix.
+ *
+ * Column i holds the column major data of getSubFilter(i, oper), so that
+ * a complete transform can be run from a single contiguous array. */
+const MatrixXd& MWFilter::getPackedSubFilters(int oper) const {
+    switch (oper) {
+    case (Compression):
+        return this->compressionBlocks;
+    case (Reconstruction):
+        return this->reconstructionBlocks;
+    default:
+        MSG_FATAL("Invalid wavelet transformation");
+    }
+}
+
 const MatrixXd& MWFilter::getCompressionSubFilter(int i) const {
     switch (i) {
     case (0):
@@ -35,6 +35,7 @@ public:
     const Eigen::MatrixXd &getSubFilter(int i, int oper = 0) const;
     const Eigen::MatrixXd &getCompressionSubFilter(int i) const;
     const Eigen::MatrixXd &getReconstructionSubFilter(int i) const;
+    const Eigen::MatrixXd &getPackedSubFilters(int oper) const;
 
     static void setDefaultLibrary(const std::string &dir);
     static const std::string &getDefaultLibrary() { return default_filter_lib; }
@@ -54,6 +55,9 @@ protected:
     Eigen::MatrixXd G1t;
     Eigen::MatrixXd H0t;
     Eigen::MatrixXd H1t;
+    // Sub-filters of each operation packed as columns, in getSubFilter order
+    Eigen::MatrixXd compressionBlocks;
+    Eigen::MatrixXd reconstructionBlocks;
 
     std::string H_path;
     std::string G_path;
@@ -1,4 +1,6 @@
 #include "ConvolutionOperator.h"
+#include "OperatorCache.h"
+#include "OperatorTermBank.h"
 #include "CrossCorrelationCalculator.h"
 #include "OperatorAdaptor.h"
 #include "GridGenerator.h"
@@ -12,20 +14,74 @@
 using namespace std;
 using namespace Eigen;
 
+/** If a term bank is given, the operator trees are taken from, or added to,
+  * the bank, and shared with the other operators using the same bank. */
 template<int D>
-ConvolutionOperator<D>::ConvolutionOperator(const MultiResolutionAnalysis<D> &mra, double pr)
+ConvolutionOperator<D>::ConvolutionOperator(const MultiResolutionAnalysis<D> &mra,
+                                            double pr,
+                                            OperatorTermBank *bank)
     : MWOperator(mra.getOperatorMRA()),
       kern_mra(mra.getKernelMRA()),
-      prec(pr) {
+      prec(pr),
+      termBank(bank) {
 }
 
 template<int D>
 ConvolutionOperator<D>::~ConvolutionOperator() {
     this->clearKernel();
+    if (this->termBank != 0) {
+        for (int i = 0; i < this->oper_exp.size(); i++) {
+            this->termBank->release(this->oper_exp[i]);
+        }
+        this->clear(false);
+    }
 }
 
+/** Set up one operator tree per term of the kernel expansion. The trees are
+  * taken from the term bank if it holds them, else from the OperatorCache if
+  * it is enabled and holds this operator, and are otherwise built. */
 template<int D>
 void ConvolutionOperator<D>::initializeOperator(GreensKernel &greens_kernel) {
+    calcCacheKey(greens_kernel);
+    int nTerms = greens_kernel.size();
+    int nPrefix = this->cacheKey.size() - 3*nTerms;
+
+    OperatorTreeVector cached;
+    if (OperatorCache::isEnabled()) {
+        OperatorCache::load(this->cacheKey, this->oper_mra, this->prec, cached);
+    }
+    for (int i = 0; i < nTerms; i++) {
+        vector<double> termKey(this->cacheKey.begin(), this->cacheKey.begin() + nPrefix);
+        termKey.insert(termKey.end(), this->cacheKey.begin() + nPrefix + 3*i,
+                                      this->cacheKey.begin() + nPrefix + 3*i + 3);
+        OperatorTree *o_tree = 0;
+        if (this->termBank != 0) {
+            o_tree = this->termBank->get(termKey);
+        }
+        if (o_tree == 0) {
+            if (cached.size() > 0) {
+                o_tree = cached[i];
+                cached[i] = 0;
+            } else {
+                o_tree = buildTerm(*greens_kernel[i]);
+            }
+            if (this->termBank != 0) {
+                this->termBank->add(termKey, o_tree);
+            }
+        }
+        this->oper_exp.push_back(o_tree);
+    }
+    for (int i = 0; i < cached.size(); i++) {
+        if (cached[i] != 0) delete cached[i];
+    }
+    if (OperatorCache::isEnabled() and cached.size() == 0) {
+        OperatorCache::save(this->cacheKey, this->oper_exp);
+    }
+}
+
+/** Expand a single kernel term into a 2D operator tree */
+template<int D>
+OperatorTree* ConvolutionOperator<D>::buildTerm(Gaussian<1> &k_func) {
     int max_scale = this->oper_mra.getMaxScale();
     GridGenerator<1> G(max_scale);
     MWProjector<1> Q(this->prec/10.0, max_scale);
@@ -33,27 +89,55 @@ void ConvolutionOperator<D>::initializeOperator(GreensKernel &greens_kernel) {
     TreeBuilder<2> builder;
     OperatorAdaptor adaptor(this->prec, max_scale);
 
-    for (int i = 0; i < greens_kernel.size(); i++) {
-        Gaussian<1> &k_func = *greens_kernel[i];
-        FunctionTree<1> *k_tree = new FunctionTree<1>(this->kern_mra, MaxAllocNodes1D);
-        G(*k_tree, k_func); //Generate empty grid to hold narrow Gaussian
-        Q(*k_tree, k_func); //Project Gaussian starting from the empty grid
-        CrossCorrelationCalculator calculator(*k_tree);
+    FunctionTree<1> *k_tree = new FunctionTree<1>(this->kern_mra, MaxAllocNodes1D);
+    G(*k_tree, k_func); //Generate empty grid to hold narrow Gaussian
+    Q(*k_tree, k_func); //Project Gaussian starting from the empty grid
+    CrossCorrelationCalculator calculator(*k_tree);
 
-        OperatorTree *o_tree = new OperatorTree(this->oper_mra, this->prec, MaxAllocOperNodes);
-        builder.build(*o_tree, calculator, adaptor, -1); //Expand 1D kernel into 2D operator
+    OperatorTree *o_tree = new OperatorTree(this->oper_mra, this->prec, MaxAllocOperNodes);
+    builder.build(*o_tree, calculator, adaptor, -1); //Expand 1D kernel into 2D operator
 
-        Timer trans_t;
-        o_tree->mwTransform(BottomUp);
-        o_tree->calcSquareNorm();
-        o_tree->setupOperNodeCache();
-        trans_t.stop();
+    Timer trans_t;
+    o_tree->mwTransform(BottomUp);
+    o_tree->calcSquareNorm();
+    o_tree->setupOperNodeCache();
+    trans_t.stop();
 
-        println(10, "Time transform      " << trans_t);
-        println(10, std::endl);
+    println(10, "Time transform      " << trans_t);
+    println(10, std::endl);
 
-        this->kern_exp.push_back(k_tree);
-        this->oper_exp.push_back(o_tree);
+    this->kern_exp.push_back(k_tree);
+    return o_tree;
+}
+
+/** Collect everything the operator trees depend on: the operator and kernel
+  * MRAs, the build precision and the terms of the kernel expansion. */
+template<int D>
+void ConvolutionOperator<D>::calcCacheKey(const GreensKernel &greens_kernel) {
+    vector<double> &key = this->cacheKey;
+    key.clear();
+    const BoundingBox<2> &o_box = this->oper_mra.getWorldBox();
+    key.push_back(this->oper_mra.getScalingBasis().getScalingType());
+    key.push_back(this->oper_mra.getOrder());
+    key.push_back(this->oper_mra.getMaxDepth());
+    key.push_back(o_box.getScale());
+    for (int d = 0; d < 2; d++) {
+        key.push_back(o_box.getCornerIndex().getTranslation(d));
+        key.push_back(o_box.size(d));
+    }
+    const BoundingBox<1> &k_box = this->kern_mra.getWorldBox();
+    key.push_back(this->kern_mra.getScalingBasis().getScalingType());
+    key.push_back(this->kern_mra.getOrder());
+    key.push_back(this->kern_mra.getMaxDepth());
+    key.push_back(k_box.getScale());
+    key.push_back(k_box.getCornerIndex().getTranslation(0));
+    key.push_back(k_box.size(0));
+    key.push_back(this->prec);
+    for (int i = 0; i < greens_kernel.size(); i++) {
+        const Gaussian<1> &k_func = *greens_kernel[i];
+        key.push_back(k_func.getExp());
+        key.push_back(k_func.getCoef());
+        key.push_back(k_func.getPos()[0]);
     }
 }
 
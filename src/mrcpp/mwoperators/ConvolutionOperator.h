@@ -7,16 +7,23 @@
 template<int D>
 class ConvolutionOperator : public MWOperator {
 public:
-    ConvolutionOperator(const MultiResolutionAnalysis<D> &mra, double pr);
+    ConvolutionOperator(const MultiResolutionAnalysis<D> &mra, double pr,
+                        OperatorTermBank *bank = 0);
     virtual ~ConvolutionOperator();
 
+    const std::vector<double> &getCacheKey() const { return this->cacheKey; }
+
 protected:
     MultiResolutionAnalysis<1> kern_mra;
     FunctionTreeVector<1> kern_exp;
     double prec;
+    std::vector<double> cacheKey;
+    OperatorTermBank *termBank;
 
     void initializeOperator(GreensKernel &greens_kernel);
     void clearKernel();
+    OperatorTree *buildTerm(Gaussian<1> &k_func);
+    void calcCacheKey(const GreensKernel &greens_kernel);
 
     double calcMinDistance(const MultiResolutionAnalysis<D> &MRA, double epsilon) const;
     double calcMaxDistance(const MultiResolutionAnalysis<D> &MRA) const;
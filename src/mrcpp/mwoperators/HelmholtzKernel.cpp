@@ -16,6 +16,14 @@
 using namespace std;
 
 /** generate an approximation of the 3d helmholtz kernel expanded in gaussian functions
+ *
+ * With aligned quadrature the points of the trapezoidal rule are placed on a
+ * fixed grid (integer multiples of the step size) instead of starting at the
+ * mu dependent lower limit. The exponents are then the same for all mu, and
+ * the narrow terms, where the mu dependent factor exp(-mu^2/(4 alpha)) of
+ * the coefficient differs from one by less than epsilon/10, are made exactly
+ * mu independent. Such terms are identical between kernels with different
+ * mu, and can be shared (see OperatorTermBank).
  */
 void HelmholtzKernel::initializeKernel() {
     //Constructed on [rMin/rMax, 1.0], and then rescaled to [rMin,rMax]
@@ -33,12 +41,24 @@ void HelmholtzKernel::initializeKernel() {
     // for given MU
     double h = 1.0 / (0.20L - 0.47L * log10(this->epsilon));
     int n_exp = (int) ceil((s2 - s1) / h) + 1;
+    int i_0 = 0;
+    if (this->aligned) {
+        i_0 = (int) floor(s1 / h);
+        n_exp = (int) ceil(s2 / h) - i_0 + 1;
+    }
     if (n_exp > MaxSepRank) MSG_FATAL("Maximum separation rank exceeded.");
 
     for (int i = 0; i < n_exp; i++) {
         double arg = s1 + h * i;
+        if (this->aligned) {
+            arg = h * (i_0 + i);
+        }
         double temp = -arg * 2.0;
-        double temp2 = -mu_tilde * mu_tilde * exp(temp) / 4.0 + arg;
+        double mu_fac = mu_tilde * mu_tilde * exp(temp) / 4.0;
+        if (this->aligned and mu_fac < this->epsilon/10.0) {
+            mu_fac = 0.0;
+        }
+        double temp2 = -mu_fac + arg;
         double beta = (h * (2.0 / root_pi) * exp(temp2));
         double temp3 = 2.0L * arg;
         double alpha = exp(temp3);
@@ -15,14 +15,17 @@
 
 class HelmholtzKernel: public GreensKernel {
 public:
-    HelmholtzKernel(double m, double eps, double r_min, double r_max)
+    HelmholtzKernel(double m, double eps, double r_min, double r_max,
+                    bool align = false)
             : GreensKernel(eps, r_min, r_max),
-              mu(m) {
+              mu(m),
+              aligned(align) {
         initializeKernel();
     }
     virtual ~HelmholtzKernel() { }
 protected:
     const double mu; /**< exponent */
+    const bool aligned; /**< mu independent quadrature grid */
     virtual void initializeKernel();
 };
 
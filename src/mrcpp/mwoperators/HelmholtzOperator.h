@@ -4,16 +4,21 @@
 #include "ConvolutionOperator.h"
 #include "HelmholtzKernel.h"
 
+/** With a term bank, the kernel is expanded on a mu independent quadrature
+  * grid, and the operator shares its mu independent terms with the other
+  * Helmholtz operators of the bank. */
 class HelmholtzOperator : public ConvolutionOperator<3> {
 public:
     HelmholtzOperator(const MultiResolutionAnalysis<3> &mra,
-                      double m, double pr = -1.0)
-            : ConvolutionOperator<3>(mra, pr), mu(m) {
+                      double m, double pr = -1.0,
+                      OperatorTermBank *bank = 0)
+            : ConvolutionOperator<3>(mra, pr, bank), mu(m) {
         int oldlevel = TelePrompter::setPrintLevel(0);
         double epsilon = this->prec/10.0;
         double r_min = calcMinDistance(mra, epsilon);
         double r_max = calcMaxDistance(mra);
-        HelmholtzKernel helmholtz_kernel(this->mu, epsilon, r_min, r_max);
+        bool aligned = (bank != 0);
+        HelmholtzKernel helmholtz_kernel(this->mu, epsilon, r_min, r_max, aligned);
         // Rescale for application in 3D
         helmholtz_kernel.rescale(3);
         initializeOperator(helmholtz_kernel);
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cmath>
+
 #include "MWOperator.h"
+#include "OperatorNode.h"
 #include "BandWidth.h"
 #include "Timer.h"
 
@@ -40,6 +44,8 @@ void MWOperator::clearBandWidths() {
     for (unsigned int i = 0; i < this->oper_exp.size(); i++) {
         this->oper_exp[i]->clearBandWidth();
     }
+    this->terms.clear();
+    this->termWeights.clear();
 }
 
 void MWOperator::calcBandWidths(double prec) {
@@ -70,4 +76,131 @@ void MWOperator::calcBandWidths(double prec) {
         }
     }
     println(20, "  Maximum bandwidths:\n" << this->band_max << std::endl);
+    calcTerms(prec);
+}
+
+/** Number of (merged) terms to apply at the given depth */
+int MWOperator::getNTerms(int depth) const {
+    if (depth < 0 or depth >= this->terms.size()) {
+        return 0;
+    }
+    return this->terms[depth].size();
+}
+
+/** Scaling of term i at the given depth in a dim-dimensional application.
+ *
+ * Each merged component j has operator nodes lambda_j times those of the
+ * term at this depth, so its separable dim-dimensional product contributes
+ * lambda_j^dim times the product of the term itself. */
+double MWOperator::getTermFactor(int depth, int i, int dim) const {
+    const VectorXd &lambda = this->termWeights[depth][i];
+    double fac = 0.0;
+    for (int j = 0; j < lambda.size(); j++) {
+        fac += pow(lambda(j), dim);
+    }
+    return fac;
+}
+
+/** Set up a reduced, scale dependent list of operator terms.
+ *
+ * At each depth only the components with a non-empty band width are kept.
+ * Components whose operator nodes at this depth are proportional (within
+ * a fraction of prec) to those of an already kept component with at least
+ * the same band width are merged into that one. This happens at coarse
+ * scales, where narrow kernel terms all look like delta functions. The
+ * terms are sorted by decreasing band width, so that the application can
+ * stop at the first term that cannot reach a given node. Merging can be
+ * switched off with setMergeTerms(false). */
+void MWOperator::calcTerms(double prec) {
+    int nDepths = this->band_max.size();
+    this->terms.clear();
+    this->termWeights.clear();
+    this->terms.resize(nDepths);
+    this->termWeights.resize(nDepths);
+
+    int nMerged = 0;
+    for (int depth = 0; depth < nDepths; depth++) {
+        vector<pair<int, int> > comps;
+        for (int i = 0; i < this->oper_exp.size(); i++) {
+            int w = this->oper_exp[i]->getBandWidth().getMaxWidth(depth);
+            if (w >= 0) {
+                comps.push_back(make_pair(-w, i));
+            }
+        }
+        // Widest first, original order among equal widths
+        stable_sort(comps.begin(), comps.end());
+
+        vector<int> &t_idx = this->terms[depth];
+        vector<vector<double> > t_wgt;
+        for (int n = 0; n < comps.size(); n++) {
+            int i = comps[n].second;
+            bool merged = false;
+            for (int m = 0; m < t_idx.size() and this->mergeTerms; m++) {
+                double lambda = 0.0;
+                if (calcTermWeight(i, t_idx[m], depth, prec, lambda)) {
+                    t_wgt[m].push_back(lambda);
+                    merged = true;
+                    nMerged++;
+                    break;
+                }
+            }
+            if (not merged) {
+                t_idx.push_back(i);
+                t_wgt.push_back(vector<double>(1, 1.0));
+            }
+        }
+        for (int m = 0; m < t_wgt.size(); m++) {
+            VectorXd lambda(t_wgt[m].size());
+            for (int j = 0; j < t_wgt[m].size(); j++) {
+                lambda(j) = t_wgt[m][j];
+            }
+            this->termWeights[depth].push_back(lambda);
+        }
+    }
+    println(20, "  Merged operator terms: " << nMerged << std::endl);
+}
+
+/** Check if component i is proportional to component j at the given depth.
+ *
+ * The nodes of i within its band width are fitted to lambda times the
+ * nodes of j within the (at least as large) band of j. Returns true if the
+ * residual of the fit is below prec/100 relative to the norm of i, which
+ * keeps the error of the merged separable product well below prec. */
+bool MWOperator::calcTermWeight(int i, int j, int depth, double prec,
+                                double &lambda) const {
+    const OperatorTree &oTree_i = *this->oper_exp[i];
+    const OperatorTree &oTree_j = *this->oper_exp[j];
+    int w_i = oTree_i.getBandWidth().getMaxWidth(depth);
+    int w_j = oTree_j.getBandWidth().getMaxWidth(depth);
+    if (w_i > w_j) {
+        return false;
+    }
+
+    double ii = 0.0;
+    double ij = 0.0;
+    double jj = 0.0;
+    for (int l = -w_j; l <= w_j; l++) {
+        const OperatorNode &node_j = oTree_j.getNode(depth, l);
+        const double *c_j = node_j.getCoefs();
+        int nCoefs = node_j.getNCoefs();
+        for (int k = 0; k < nCoefs; k++) {
+            jj += c_j[k]*c_j[k];
+        }
+        if (abs(l) > w_i) {
+            continue;
+        }
+        const OperatorNode &node_i = oTree_i.getNode(depth, l);
+        const double *c_i = node_i.getCoefs();
+        for (int k = 0; k < nCoefs; k++) {
+            ii += c_i[k]*c_i[k];
+            ij += c_i[k]*c_j[k];
+        }
+    }
+    if (ii <= 0.0 or jj <= 0.0) {
+        return false;
+    }
+    lambda = ij/jj;
+    double res2 = ii - 2.0*lambda*ij + lambda*lambda*jj;
+    double thrs = 0.01*prec;
+    return (res2 <= thrs*thrs*ii);
 }
@@ -8,7 +8,7 @@
 
 class MWOperator {
 public:
-    MWOperator(MultiResolutionAnalysis<2> mra) : oper_mra(mra) { }
+    MWOperator(MultiResolutionAnalysis<2> mra) : oper_mra(mra), mergeTerms(true) { }
     virtual ~MWOperator() { this->clear(true); }
 
     int size() const { return this->oper_exp.size(); }
@@ -21,6 +21,13 @@ public:
     void calcBandWidths(double prec);
     void clearBandWidths();
 
+    void setMergeTerms(bool merge) { this->mergeTerms = merge; }
+    bool getMergeTerms() const { return this->mergeTerms; }
+
+    int getNTerms(int depth) const;
+    int getTerm(int depth, int i) const { return this->terms[depth][i]; }
+    double getTermFactor(int depth, int i, int dim) const;
+
     OperatorTree &getComponent(int i);
     const OperatorTree &getComponent(int i) const;
 
@@ -31,6 +38,15 @@ protected:
     MultiResolutionAnalysis<2> oper_mra;
     OperatorTreeVector oper_exp;
     Eigen::VectorXi band_max;
+    bool mergeTerms;
+
+    // Per depth: the components to apply, sorted by decreasing band width,
+    // and the weights of the components that are merged into each of them
+    std::vector<std::vector<int> > terms;
+    std::vector<std::vector<Eigen::VectorXd> > termWeights;
+
+    void calcTerms(double prec);
+    bool calcTermWeight(int i, int j, int depth, double prec, double &lambda) const;
 };
 
 #endif // MWOPERATOR_H
@@ -0,0 +1,128 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "OperatorCache.h"
+#include "OperatorTree.h"
+#include "Timer.h"
+#include "parallel.h"
+
+using namespace std;
+
+string OperatorCache::directory;
+
+/** Header of the operator cache file, followed by the key and the trees */
+struct OperCacheFileHeader {
+    char magic[8];
+    int version;
+    int nKey;
+    int nTrees;
+};
+
+static const char operCacheMagic[8] = {'M','W','O','P','C','A','C','H'};
+static const int operCacheVersion = 1;
+
+/** The file name is a 64 bit FNV-1a hash of the key */
+string OperatorCache::getFileName(const vector<double> &key) {
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char *bytes = (const unsigned char *) key.data();
+    for (int i = 0; i < key.size()*sizeof(double); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    ostringstream fname;
+    fname << directory << "/oper-" << hex << setfill('0') << setw(16) << hash << ".mwop";
+    return fname.str();
+}
+
+/** Read the operator trees stored with the given key, if present. On success
+  * the trees are appended to oper_exp, ready for use (the operator node
+  * cache is set up). Returns false if there is no matching file, in which
+  * case oper_exp is unchanged. */
+bool OperatorCache::load(const vector<double> &key,
+                         const MultiResolutionAnalysis<2> &mra,
+                         double prec,
+                         OperatorTreeVector &oper_exp) {
+    string fname = getFileName(key);
+    ifstream in(fname.c_str(), ios::binary);
+    if (not in.is_open()) {
+        return false;
+    }
+    Timer load_t;
+    OperCacheFileHeader header;
+    in.read((char *) &header, sizeof(OperCacheFileHeader));
+    if (not in.good() or memcmp(header.magic, operCacheMagic, 8) != 0 or
+        header.version != operCacheVersion or header.nKey != key.size()) {
+        MSG_WARN("Ignoring invalid operator cache file " << fname);
+        return false;
+    }
+    vector<double> fileKey(header.nKey);
+    in.read((char *) fileKey.data(), header.nKey*sizeof(double));
+    if (not in.good() or fileKey != key) {
+        MSG_WARN("Ignoring operator cache file with different key " << fname);
+        return false;
+    }
+
+    OperatorTreeVector trees;
+    for (int i = 0; i < header.nTrees; i++) {
+        OperatorTree *o_tree = new OperatorTree(mra, prec, MaxAllocOperNodes);
+        trees.push_back(o_tree);
+        if (not o_tree->loadTree(in)) {
+            MSG_WARN("Ignoring invalid operator cache file " << fname);
+            for (int j = 0; j < trees.size(); j++) {
+                delete trees[j];
+            }
+            return false;
+        }
+        o_tree->setupOperNodeCache();
+    }
+    for (int i = 0; i < trees.size(); i++) {
+        oper_exp.push_back(trees[i]);
+    }
+    load_t.stop();
+    println(10, "Operator read from " << fname << " " << load_t);
+    return true;
+}
+
+/** Store the operator trees under the given key. Only the master rank
+  * writes, and the file is written under a temporary name and then renamed,
+  * so that concurrent jobs never see a partially written file. */
+bool OperatorCache::save(const vector<double> &key,
+                         const OperatorTreeVector &oper_exp) {
+    if (MPI_rank != 0) {
+        return true;
+    }
+    string fname = getFileName(key);
+    ostringstream tmpname;
+    tmpname << fname << ".tmp" << getpid();
+    ofstream out(tmpname.str().c_str(), ios::binary);
+    if (not out.is_open()) {
+        MSG_WARN("Unable to write operator cache file " << fname);
+        return false;
+    }
+    OperCacheFileHeader header;
+    for (int i = 0; i < 8; i++) header.magic[i] = operCacheMagic[i];
+    header.version = operCacheVersion;
+    header.nKey = key.size();
+    header.nTrees = oper_exp.size();
+    out.write((const char *) &header, sizeof(OperCacheFileHeader));
+    out.write((const char *) key.data(), key.size()*sizeof(double));
+    bool ok = out.good();
+    for (int i = 0; ok and i < oper_exp.size(); i++) {
+        ok = oper_exp[i]->saveTree(out);
+    }
+    out.close();
+    if (ok) {
+        ok = (rename(tmpname.str().c_str(), fname.c_str()) == 0);
+    }
+    if (not ok) {
+        MSG_WARN("Unable to write operator cache file " << fname);
+        remove(tmpname.str().c_str());
+        return false;
+    }
+    println(10, "Operator written to " << fname);
+    return true;
+}
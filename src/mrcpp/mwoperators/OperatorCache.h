@@ -0,0 +1,42 @@
+/**
+*
+*
+*  \brief On-disk cache of the operator trees of convolution operators.
+*
+*  The operator trees of a ConvolutionOperator depend only on the MRA, the
+*  build precision and the Gaussian expansion of the Green's kernel. These
+*  are collected into a key, and the trees are stored in a file in the cache
+*  directory named by a hash of the key. The full key is stored in the file
+*  and compared on reading. The cache is disabled as long as no directory
+*  has been set.
+*
+*/
+
+#ifndef OPERATORCACHE_H
+#define OPERATORCACHE_H
+
+#include <string>
+#include <vector>
+
+#include "MultiResolutionAnalysis.h"
+#include "mrcpp_declarations.h"
+
+class OperatorCache {
+public:
+    static void setDirectory(const std::string &dir) { directory = dir; }
+    static const std::string &getDirectory() { return directory; }
+    static bool isEnabled() { return not directory.empty(); }
+    static std::string getFileName(const std::vector<double> &key);
+
+    static bool load(const std::vector<double> &key,
+                     const MultiResolutionAnalysis<2> &mra,
+                     double prec,
+                     OperatorTreeVector &oper_exp);
+    static bool save(const std::vector<double> &key,
+                     const OperatorTreeVector &oper_exp);
+
+protected:
+    static std::string directory;
+};
+
+#endif // OPERATORCACHE_H
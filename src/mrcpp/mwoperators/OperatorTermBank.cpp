@@ -0,0 +1,46 @@
+#include "OperatorTermBank.h"
+#include "OperatorTree.h"
+
+using namespace std;
+
+OperatorTermBank::~OperatorTermBank() {
+    if (this->entries.size() > 0) {
+        MSG_WARN("Operator terms still in use");
+    }
+    map<OperatorTree *, Entry>::iterator it;
+    for (it = this->entries.begin(); it != this->entries.end(); it++) {
+        delete it->first;
+    }
+}
+
+/** Return the tree stored with the given key, or a null pointer. A
+  * returned tree is counted as in use until it is released. */
+OperatorTree *OperatorTermBank::get(const vector<double> &key) {
+    map<vector<double>, OperatorTree *>::iterator it = this->trees.find(key);
+    if (it == this->trees.end()) {
+        return 0;
+    }
+    this->entries[it->second].refCount++;
+    return it->second;
+}
+
+/** Hand a tree over to the bank, it is counted as in use by the caller */
+void OperatorTermBank::add(const vector<double> &key, OperatorTree *tree) {
+    if (this->trees.find(key) != this->trees.end()) MSG_FATAL("Term already in bank");
+    Entry &entry = this->entries[tree];
+    entry.key = key;
+    entry.refCount = 1;
+    this->trees[key] = tree;
+}
+
+/** Release a tree obtained by get or add, deleting it if no longer used */
+void OperatorTermBank::release(OperatorTree *tree) {
+    map<OperatorTree *, Entry>::iterator it = this->entries.find(tree);
+    if (it == this->entries.end()) MSG_FATAL("Term not in bank");
+    if (--it->second.refCount > 0) {
+        return;
+    }
+    this->trees.erase(it->second.key);
+    this->entries.erase(it);
+    delete tree;
+}
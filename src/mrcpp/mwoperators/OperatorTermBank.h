@@ -0,0 +1,45 @@
+/**
+*
+*
+*  \brief Operator trees shared between convolution operators.
+*
+*  Each term of a Gaussian kernel expansion is expanded into its own
+*  OperatorTree, which depends only on the MRA, the build precision and the
+*  exponent and coefficient of the term. Operators that are constructed with
+*  the same bank look up their terms here before building them, such that
+*  identical terms of different operators (e.g. the mu independent, narrow
+*  terms of Helmholtz operators) are built and stored only once. The trees
+*  are reference counted, and deleted when released by the last operator.
+*  The bank must outlive the operators using it.
+*
+*/
+
+#ifndef OPERATORTERMBANK_H
+#define OPERATORTERMBANK_H
+
+#include <map>
+#include <vector>
+
+#include "mrcpp_declarations.h"
+
+class OperatorTermBank {
+public:
+    OperatorTermBank() { }
+    virtual ~OperatorTermBank();
+
+    int size() const { return this->trees.size(); }
+
+    OperatorTree *get(const std::vector<double> &key);
+    void add(const std::vector<double> &key, OperatorTree *tree);
+    void release(OperatorTree *tree);
+
+protected:
+    struct Entry {
+        std::vector<double> key;
+        int refCount;
+    };
+    std::map<std::vector<double>, OperatorTree *> trees;
+    std::map<OperatorTree *, Entry> entries;
+};
+
+#endif // OPERATORTERMBANK_H
@@ -0,0 +1,91 @@
+/**
+*
+* \brief Append-only table of chunk pointers for the serial trees.
+*
+* Entries are stored in segments of doubling size that never move once
+* allocated, so existing entries can be read without locking while another
+* thread (holding the tree lock) appends to the table. The number of entries
+* is atomic: an index below size(), or one handed over under the tree lock,
+* always refers to a fully written entry. It provides the subset of the
+* std::vector interface used for the chunk lists.
+*/
+
+#ifndef CHUNKTABLE_H_
+#define CHUNKTABLE_H_
+
+#include <cassert>
+#include <atomic>
+
+template<class T>
+class ChunkTable {
+public:
+    ChunkTable() : nEntries(0) {
+        for (int s = 0; s < MaxSegments; s++) {
+            this->segments[s] = 0;
+        }
+    }
+    virtual ~ChunkTable() {
+        for (int s = 0; s < MaxSegments; s++) {
+            if (this->segments[s] != 0) delete[] this->segments[s];
+        }
+    }
+
+    int size() const { return this->nEntries.load(std::memory_order_acquire); }
+
+    T &operator[](int i) {
+        assert(i >= 0 and i < size());
+        int s, pos;
+        locate(i, s, pos);
+        return this->segments[s][pos];
+    }
+    const T &operator[](int i) const {
+        assert(i >= 0 and i < size());
+        int s, pos;
+        locate(i, s, pos);
+        return this->segments[s][pos];
+    }
+
+    /** Append an entry. The new size is published with release semantics
+      * after the entry is written, so a reader that sees the new size (with
+      * the acquire in size()) also sees the entry. */
+    void push_back(const T &entry) {
+        int n = this->nEntries.load(std::memory_order_relaxed);
+        int s, pos;
+        locate(n, s, pos);
+        assert(s < MaxSegments);
+        if (this->segments[s] == 0) {
+            this->segments[s] = new T[FirstSize << s];
+        }
+        this->segments[s][pos] = entry;
+        this->nEntries.store(n + 1, std::memory_order_release);
+    }
+
+    /** Remove the last entry. Must not be called while other threads read
+      * the table. Segment storage is kept for later entries. */
+    void pop_back() {
+        int n = this->nEntries.load(std::memory_order_relaxed);
+        assert(n > 0);
+        this->nEntries.store(n - 1, std::memory_order_release);
+    }
+
+protected:
+    static const int FirstSize = 16;    //size of the first segment
+    static const int MaxSegments = 26;  //room for about 2^30 entries
+
+    T *segments[MaxSegments];
+    std::atomic<int> nEntries;
+
+    /** Segment s holds the entries [FirstSize*(2^s-1), FirstSize*(2^(s+1)-1)) */
+    static void locate(int i, int &s, int &pos) {
+        int b = i/FirstSize + 1;
+        s = 0;
+        while (b >> (s + 1)) s++;
+        pos = i - FirstSize*((1 << s) - 1);
+    }
+
+private:
+    ChunkTable(const ChunkTable<T> &table) { }
+    ChunkTable<T> &operator=(const ChunkTable<T> &table) { return *this; }
+};
+
+#endif /* CHUNKTABLE_H_ */
@@ -163,15 +163,7 @@ double FunctionNode<D>::dotScaling(const FunctionNode<D> &ket) const {
     const double *b = ket.getCoefs();
 
     int size = bra.getKp1_d();
-#ifdef HAVE_BLAS
-    return cblas_ddot(size, a, 1, b, 1);
-#else
-    double result = 0.0;
-    for (int i = 0; i < size; i++) {
-        result += a[i]*b[i];
-    }
-    return result;
-#endif
+    return dotCoefs(a, b, size);
 }
 
 /** Inner product of the functions represented by the wavelet basis of the nodes.
@@ -195,12 +187,18 @@ double FunctionNode<D>::dotWavelet(const FunctionNode<D> &ket) const {
 
     int start = bra.getKp1_d();
     int size = (bra.getTDim() - 1) * start;
+    return dotCoefs(&a[start], &b[start], size);
+}
+
+/** Dot product of two coefficient vectors. */
+template<int D>
+double FunctionNode<D>::dotCoefs(const double *a, const double *b, int size) {
 #ifdef HAVE_BLAS
-    return cblas_ddot(size, &a[start], 1, &b[start], 1);
+    return cblas_ddot(size, a, 1, b, 1);
 #else
     double result = 0.0;
     for (int i = 0; i < size; i++) {
-        result += a[start+i]*b[start+i];
+        result += a[i]*b[i];
     }
     return result;
 #endif
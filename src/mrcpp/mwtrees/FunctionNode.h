@@ -29,6 +29,7 @@ protected:
     double integrate() const;
     double dotScaling(const FunctionNode<D> &ket) const;
     double dotWavelet(const FunctionNode<D> &ket) const;
+    static double dotCoefs(const double *a, const double *b, int size);
 
     double evalScaling(const double *r) const;
     double integrateLegendre() const;
@@ -4,11 +4,15 @@
  *          CTCC, University of Tromsø
  */
 
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
 #include "FunctionTree.h"
 #include "SerialFunctionTree.h"
 #include "FunctionNode.h"
 #include "ProjectedNode.h"
-#include "HilbertIterator.h"
+#include "HilbertPath.h"
 
 using namespace std;
 using namespace Eigen;
@@ -35,18 +39,76 @@ FunctionTree<D>::~FunctionTree() {
     delete this->serialTree_p;
 }
 
-/** Leaves the tree inn the same state as after construction*/
+/** Leaves the tree inn the same state as after construction, i.e. the root
+  * nodes representing the zero function. The node and coefficient chunks of
+  * the serial tree are kept, so the tree can be rebuilt without new
+  * allocations. */
 template<int D>
 void FunctionTree<D>::clear() {
-    NOT_IMPLEMENTED_ABORT;
+    this->getSerialFunctionTree()->clear();
+    this->resetEndNodeTable();
+    this->name = "nn";
+}
+
+/** Header of the binary tree format. The MRA parameters are stored for
+  * validation only, the tree must be read into a tree with the same MRA.
+  * Data is stored in native byte order. */
+struct TreeFileHeader {
+    char magic[8];
+    int version;
+    int dim;
+    int scalingType;
+    int order;
+    int rootScale;
+    int rootCorner[3];
+    int rootBoxes[3];
+    int maxNodesPerChunk;
+    int sizeNodeCoeff;
+    int nNormsPerNode;
+    int nChunks;
+    int nSlots;             //number of node slots stored
+    double squareNorm;
+};
+
+static const char treeFileMagic[8] = {'M','W','T','R','E','E','\0','\0'};
+static const int treeFileVersion = 1;
+
+template<int D>
+static void setTreeFileHeader(TreeFileHeader &header, const MultiResolutionAnalysis<D> &mra) {
+    for (int i = 0; i < 8; i++) header.magic[i] = treeFileMagic[i];
+    header.version = treeFileVersion;
+    header.dim = D;
+    header.scalingType = mra.getScalingBasis().getScalingType();
+    header.order = mra.getOrder();
+
+    const BoundingBox<D> &world = mra.getWorldBox();
+    header.rootScale = world.getScale();
+    for (int d = 0; d < 3; d++) {
+        header.rootCorner[d] = (d < D) ? world.getCornerIndex().getTranslation(d) : 0;
+        header.rootBoxes[d] = (d < D) ? world.size(d) : 1;
+    }
+}
+
+static string getTreeFileName(const string &file) {
+    ostringstream fname;
+    fname << file;
+    if (MPI_size > 1) fname << "-" << MPI_rank;
+    fname << ".tree";
+    return fname.str();
 }
 
 /** Write the tree structure to disk, for later use.
   * Argument file name will get a ".tree" file extension, and in MPI an
-  * additional "-[rank]". */
+  * additional "-[rank]". The tree is compacted, see saveTree(ostream). */
 template<int D>
 bool FunctionTree<D>::saveTree(const string &file) {
-    NOT_IMPLEMENTED_ABORT;
+    string fname = getTreeFileName(file);
+    ofstream out(fname.c_str(), ios::binary);
+    if (not out.is_open()) {
+        MSG_ERROR("Unable to open file " << fname);
+        return false;
+    }
+    return saveTree(out);
 }
 
 /** Read a previously stored tree structure from disk.
@@ -54,7 +116,148 @@ bool FunctionTree<D>::saveTree(const string &file) {
   * additional "-[rank]". */
 template<int D>
 bool FunctionTree<D>::loadTree(const string &file) {
-    NOT_IMPLEMENTED_ABORT;
+    string fname = getTreeFileName(file);
+    ifstream in(fname.c_str(), ios::binary);
+    if (not in.is_open()) {
+        MSG_ERROR("Unable to open file " << fname);
+        return false;
+    }
+    return loadTree(in);
+}
+
+/** Write the tree to a binary stream. The serial tree is compacted first,
+  * and the node metadata and the coefficients of the occupied chunks are
+  * written as they are stored, such that the tree can be read back without
+  * traversal. GenNodes are not stored.
+  *
+  * NB: compacting modifies the tree. GenNodes are deleted and the nodes are
+  * relocated, so any node pointers or node tables (makeNodeTable,
+  * copyEndNodeTable) taken before the call are invalid afterwards. The
+  * function represented by the tree is unchanged. */
+template<int D>
+bool FunctionTree<D>::saveTree(ostream &out) {
+    SerialFunctionTree<D> &sTree = *this->getSerialFunctionTree();
+    int nChunks = sTree.compact();
+    sTree.packNodeData(nChunks);
+
+    TreeFileHeader header;
+    setTreeFileHeader(header, this->getMRA());
+    header.maxNodesPerChunk = sTree.maxNodesPerChunk;
+    header.sizeNodeCoeff = sTree.sizeNodeCoeff;
+    header.nNormsPerNode = sTree.getNNormsPerNode();
+    header.nChunks = nChunks;
+    header.nSlots = min(sTree.nNodes, nChunks*sTree.maxNodesPerChunk);
+    header.squareNorm = this->squareNorm;
+
+    int nSlots = header.nSlots;
+    out.write((const char *) &header, sizeof(TreeFileHeader));
+    out.write((const char *) sTree.nodeStatus.data(), nSlots*sizeof(unsigned char));
+    out.write((const char *) sTree.nodeParentIx.data(), nSlots*sizeof(int));
+    out.write((const char *) sTree.nodeChildIx.data(), nSlots*sizeof(int));
+    out.write((const char *) sTree.nodeNorms.data(), nSlots*header.nNormsPerNode*sizeof(double));
+    for (int iChunk = 0; iChunk < nChunks; iChunk++) {
+        int n = min(nSlots - iChunk*sTree.maxNodesPerChunk, sTree.maxNodesPerChunk);
+        out.write((const char *) sTree.nodeCoeffChunks[iChunk], n*sTree.sizeNodeCoeff*sizeof(double));
+    }
+    if (not out.good()) {
+        MSG_ERROR("Error writing tree");
+        return false;
+    }
+    return true;
+}
+
+/** Read a tree from a binary stream written by saveTree. The coefficients
+  * are read directly into the chunks of the serial tree, and the nodes are
+  * rebuilt from the metadata. The file must match the MRA of this tree,
+  * and all parent and child indices must point into the stored slots.
+  * On failure the tree is left in its root state. */
+template<int D>
+bool FunctionTree<D>::loadTree(istream &in) {
+    TreeFileHeader header;
+    in.read((char *) &header, sizeof(TreeFileHeader));
+    if (not in.good() or memcmp(header.magic, treeFileMagic, 8) != 0) {
+        MSG_ERROR("Invalid tree file");
+        return false;
+    }
+    if (header.version != treeFileVersion) {
+        MSG_ERROR("Unsupported tree file version " << header.version);
+        return false;
+    }
+
+    TreeFileHeader ref;
+    setTreeFileHeader(ref, this->getMRA());
+    bool match = (header.dim == ref.dim and
+                  header.scalingType == ref.scalingType and
+                  header.order == ref.order and
+                  header.rootScale == ref.rootScale);
+    for (int d = 0; d < 3; d++) {
+        if (header.rootCorner[d] != ref.rootCorner[d]) match = false;
+        if (header.rootBoxes[d] != ref.rootBoxes[d]) match = false;
+    }
+    SerialFunctionTree<D> &sTree = *this->getSerialFunctionTree();
+    if (header.maxNodesPerChunk != sTree.maxNodesPerChunk) match = false;
+    if (header.sizeNodeCoeff != sTree.sizeNodeCoeff) match = false;
+    if (header.nNormsPerNode != sTree.getNNormsPerNode()) match = false;
+    if (not match) {
+        MSG_ERROR("Tree file does not match MRA");
+        return false;
+    }
+
+    clear();
+    int nChunks = header.nChunks;
+    int nSlots = header.nSlots;
+    int nTotal = nChunks*sTree.maxNodesPerChunk;
+    if (nSlots > nTotal or nSlots < this->rootBox.size()) {
+        MSG_ERROR("Invalid tree file");
+        return false;
+    }
+    sTree.allocChunks(nChunks);
+    sTree.nodeStatus.assign(nTotal, 0);
+    sTree.nodeParentIx.assign(nTotal, -1);
+    sTree.nodeChildIx.assign(nTotal, -1);
+    sTree.nodeNorms.assign(nTotal*header.nNormsPerNode, 0.0);
+
+    in.read((char *) sTree.nodeStatus.data(), nSlots*sizeof(unsigned char));
+    in.read((char *) sTree.nodeParentIx.data(), nSlots*sizeof(int));
+    in.read((char *) sTree.nodeChildIx.data(), nSlots*sizeof(int));
+    in.read((char *) sTree.nodeNorms.data(), nSlots*header.nNormsPerNode*sizeof(double));
+    if (not in.good()) {
+        MSG_ERROR("Error reading tree");
+        clear();
+        return false;
+    }
+    // node links must stay within the stored slots, children come in
+    // groups of 2^D and the roots are the first slots
+    const int tDim = (1<<D);
+    bool valid = true;
+    for (int sIx = 0; sIx < nSlots; sIx++) {
+        int pIx = sTree.nodeParentIx[sIx];
+        int cIx = sTree.nodeChildIx[sIx];
+        if (pIx < -1 or pIx >= nSlots) valid = false;
+        if (cIx < -1 or cIx > nSlots - tDim) valid = false;
+        if (sIx < this->rootBox.size()) {
+            if (sTree.nodeStatus[sIx] == 0 or pIx != -1) valid = false;
+        } else if (sTree.nodeStatus[sIx] != 0 and pIx == -1) {
+            valid = false;
+        }
+    }
+    if (not valid) {
+        MSG_ERROR("Invalid node indices in tree file");
+        clear();
+        return false;
+    }
+    for (int iChunk = 0; iChunk < nChunks; iChunk++) {
+        int n = min(nSlots - iChunk*sTree.maxNodesPerChunk, sTree.maxNodesPerChunk);
+        in.read((char *) sTree.nodeCoeffChunks[iChunk], n*sTree.sizeNodeCoeff*sizeof(double));
+    }
+    if (not in.good()) {
+        MSG_ERROR("Error reading tree");
+        clear();
+        return false;
+    }
+    sTree.unpackNodeData(nChunks);
+    this->squareNorm = header.squareNorm;
+    return true;
 }
 
 template<int D>
@@ -67,6 +270,38 @@ double FunctionTree<D>::integrate() const {
     return result;
 }
 
+/** Collect pairs of serial indices of bra and ket nodes with the same
+  * NodeIndex.
+  *
+  * Both trees are traversed together through the metadata arrays of their
+  * serial trees, top down and with children in Hilbert order, so the pairs
+  * come out in the order of a HilbertIterator over the bra tree. GenNodes are
+  * never included, the traversal stops at the first EndNode of either tree. */
+template<int D>
+static void collectNodePairs(const SerialFunctionTree<D> &bra,
+                             const SerialFunctionTree<D> &ket,
+                             int braIx, int ketIx, const HilbertPath<D> &h,
+                             vector<int> &braNodes,
+                             vector<int> &ketNodes) {
+    braNodes.push_back(braIx);
+    ketNodes.push_back(ketIx);
+    if (bra.isEndNode(braIx) or ket.isEndNode(ketIx)) return;
+    int braChildIx = bra.getChildIx(braIx);
+    int ketChildIx = ket.getChildIx(ketIx);
+    for (int i = 0; i < (1<<D); i++) {
+        int cIdx = h.getZIndex(i);
+        collectNodePairs(bra, ket, braChildIx + cIdx, ketChildIx + cIdx,
+                         HilbertPath<D>(h, cIdx), braNodes, ketNodes);
+    }
+}
+
+/** Inner product of two trees.
+  *
+  * The common nodes of the two trees are split into fixed blocks in Hilbert
+  * order. Partial sums over the blocks are computed in parallel and added in
+  * block order afterwards, so the result is identical (to the very last digit)
+  * for any number of threads. Only the metadata and coefficient arrays of the
+  * serial trees are read, not the node objects. */
 template<int D>
 double FunctionTree<D>::dot(const FunctionTree<D> &ket) {
     const FunctionTree<D> &bra = *this;
@@ -76,37 +311,42 @@ double FunctionTree<D>::dot(const FunctionTree<D> &ket) {
       cout<<ket.getMRA().getMaxDepth()<<" "<<bra.getMRA().getMaxDepth()<<endl;
       MSG_FATAL("Trees not compatible");
     }
-    MWNodeVector nodeTable;
-    HilbertIterator<D> it(this);
-    it.setReturnGenNodes(false);
-    while(it.next()) {
-        MWNode<D> &node = it.getNode();
-        nodeTable.push_back(&node);
+    const SerialFunctionTree<D> &braTree = *static_cast<const SerialFunctionTree<D> *>(bra.serialTree_p);
+    const SerialFunctionTree<D> &ketTree = *static_cast<const SerialFunctionTree<D> *>(ket.serialTree_p);
+
+    vector<int> braNodes;
+    vector<int> ketNodes;
+    for (int rIdx = 0; rIdx < bra.getRootBox().size(); rIdx++) {
+        const MWNode<D> &braRoot = bra.getRootBox().getNode(rIdx);
+        const MWNode<D> &ketRoot = ket.getRootBox().getNode(rIdx);
+        collectNodePairs(braTree, ketTree, braRoot.getSerialIx(), ketRoot.getSerialIx(),
+                         braRoot.getHilbertPath(), braNodes, ketNodes);
     }
-    int nNodes = nodeTable.size();
-    double result = 0.0;
-    double locResult = 0.0;
-//OMP is disabled in order to get EXACT results (to the very last digit), the
-//order of summation makes the result different beyond the 14th digit or so.
-//OMP does improve the performace, but its not worth it for the time being.
-//#pragma omp parallel firstprivate(n_nodes, locResult)
-//		shared(nodeTable,rhs,result)
-//    {
-//#pragma omp for schedule(guided)
-    for (int n = 0; n < nNodes; n++) {
-        const FunctionNode<D> &braNode = static_cast<const FunctionNode<D> &>(*nodeTable[n]);
-        const MWNode<D> *mwNode = ket.findNode(braNode.getNodeIndex());
-        if (mwNode == 0) continue;
 
-        const FunctionNode<D> &ketNode = static_cast<const FunctionNode<D> &>(*mwNode);
-        if (braNode.isRootNode()) {
-            locResult += braNode.dotScaling(ketNode);
+    int kp1_d = this->getKp1_d();
+    int nWavelet = (this->getTDim() - 1)*kp1_d;
+    const int blockSize = 64;
+    int nNodes = braNodes.size();
+    int nBlocks = (nNodes + blockSize - 1)/blockSize;
+    vector<double> blockResults(nBlocks, 0.0);
+#pragma omp parallel for schedule(guided)
+    for (int b = 0; b < nBlocks; b++) {
+        int nEnd = min(nNodes, (b + 1)*blockSize);
+        double locResult = 0.0;
+        for (int n = b*blockSize; n < nEnd; n++) {
+            const double *a = braTree.getNodeCoefs(braNodes[n]);
+            const double *c = ketTree.getNodeCoefs(ketNodes[n]);
+            if (braTree.getParentIx(braNodes[n]) < 0) {
+                locResult += FunctionNode<D>::dotCoefs(a, c, kp1_d);
+            }
+            locResult += FunctionNode<D>::dotCoefs(a + kp1_d, c + kp1_d, nWavelet);
         }
-        locResult += braNode.dotWavelet(ketNode);
+        blockResults[b] = locResult;
+    }
+    double result = 0.0;
+    for (int b = 0; b < nBlocks; b++) {
+        result += blockResults[b];
     }
-//#pragma omp critical
-    result += locResult;
-//    }
     return result;
 }
 
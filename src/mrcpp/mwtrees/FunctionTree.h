@@ -33,8 +33,12 @@ public:
     void getEndValues(Eigen::VectorXd &data);
     void setEndValues(Eigen::VectorXd &data);
 
+    // Saving compacts the serial tree: GenNodes are deleted and nodes are
+    // moved, so node pointers and node tables into the tree are invalidated
     bool saveTree(const std::string &file);
     bool loadTree(const std::string &file);
+    bool saveTree(std::ostream &out);
+    bool loadTree(std::istream &in);
 
     // In place operations
     void square();
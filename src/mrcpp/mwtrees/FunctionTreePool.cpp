@@ -0,0 +1,105 @@
+#include <vector>
+
+#include "FunctionTreePool.h"
+#include "FunctionTree.h"
+
+using namespace std;
+
+template<int D>
+FunctionTreePool<D>::FunctionTreePool(const MultiResolutionAnalysis<D> &mra,
+                                      size_t max_bytes,
+                                      int max_trees)
+        : MRA(mra),
+          maxBytes(max_bytes),
+          maxTrees(max_trees),
+          nBytes(0) {
+    if (this->maxTrees < 0) MSG_FATAL("Invalid pool size " << max_trees);
+#ifdef HAVE_OPENMP
+    omp_init_lock(&pool_lock);
+#endif
+}
+
+/** Delete the idle trees. Trees that are handed out are owned by the
+  * caller and are not affected. */
+template<int D>
+FunctionTreePool<D>::~FunctionTreePool() {
+    clear();
+#ifdef HAVE_OPENMP
+    omp_destroy_lock(&pool_lock);
+#endif
+}
+
+/** Return a tree representing the zero function on the root nodes, as
+  * after construction. Recycled trees are taken most recently released
+  * first. The caller takes ownership of the tree, and can either hand it
+  * back with put() or delete it. */
+template<int D>
+FunctionTree<D>* FunctionTreePool<D>::get() {
+    FunctionTree<D> *tree = 0;
+    omp_set_lock(&pool_lock);
+    if (this->trees.size() > 0) {
+        tree = this->trees.back();
+        this->trees.pop_back();
+        this->nBytes -= tree->getSerialFunctionTree()->getMemoryUsage();
+    }
+    omp_unset_lock(&pool_lock);
+    if (tree == 0) tree = new FunctionTree<D>(this->MRA);
+    return tree;
+}
+
+/** Hand a tree back to the pool. The tree is cleared by the calling thread
+  * and keeps the chunks that it used before clearing, any chunks beyond
+  * that are released. The oldest idle trees are deleted until the tree fits
+  * within maxBytes and maxTrees. Trees of a different MRA, or trees that are
+  * larger than maxBytes on their own, are deleted. */
+template<int D>
+void FunctionTreePool<D>::put(FunctionTree<D> *tree) {
+    if (tree == 0) return;
+    if (tree->getMRA() != this->MRA) {
+        delete tree;
+        return;
+    }
+    SerialFunctionTree<D> *sTree = tree->getSerialFunctionTree();
+    int nUsed = sTree->getNUsedChunks();
+    int nGenUsed = sTree->getNUsedGenChunks();
+    tree->clear();
+    sTree->releaseChunks(nUsed, nGenUsed);
+
+    size_t treeBytes = sTree->getMemoryUsage();
+    if (treeBytes > this->maxBytes or this->maxTrees == 0) {
+        delete tree;
+        return;
+    }
+    vector<FunctionTree<D> *> evicted;
+    omp_set_lock(&pool_lock);
+    while (this->trees.size() > 0 and
+           (this->nBytes + treeBytes > this->maxBytes or
+            this->trees.size() >= this->maxTrees)) {
+        FunctionTree<D> *oldest = this->trees.front();
+        this->trees.pop_front();
+        this->nBytes -= oldest->getSerialFunctionTree()->getMemoryUsage();
+        evicted.push_back(oldest);
+    }
+    this->trees.push_back(tree);
+    this->nBytes += treeBytes;
+    omp_unset_lock(&pool_lock);
+    for (int i = 0; i < evicted.size(); i++) {
+        delete evicted[i];
+    }
+}
+
+/** Delete all idle trees and release their memory. */
+template<int D>
+void FunctionTreePool<D>::clear() {
+    omp_set_lock(&pool_lock);
+    for (int i = 0; i < this->trees.size(); i++) {
+        delete this->trees[i];
+    }
+    this->trees.clear();
+    this->nBytes = 0;
+    omp_unset_lock(&pool_lock);
+}
+
+template class FunctionTreePool<1>;
+template class FunctionTreePool<2>;
+template class FunctionTreePool<3>;
@@ -0,0 +1,56 @@
+/**
+*
+*
+*  \brief Recycling of temporary FunctionTrees.
+*
+*  Trees handed back to the pool are cleared and keep the node and
+*  coefficient chunks they used, such that the next tree handed out can be
+*  built with few heap allocations. The pool is bounded by the total bytes
+*  held by its idle trees and by the number of idle trees; the oldest idle
+*  trees are deleted to make room. All trees in a pool share the same MRA.
+*  The pool is thread safe.
+*
+*/
+
+#ifndef FUNCTIONTREEPOOL_H_
+#define FUNCTIONTREEPOOL_H_
+
+#include <deque>
+
+#include "MultiResolutionAnalysis.h"
+#include "parallel.h"
+
+template<int D> class FunctionTree;
+
+template<int D>
+class FunctionTreePool {
+public:
+    FunctionTreePool(const MultiResolutionAnalysis<D> &mra,
+                     size_t max_bytes = 256*1024*1024,
+                     int max_trees = 16);
+    virtual ~FunctionTreePool();
+
+    const MultiResolutionAnalysis<D> &getMRA() const { return this->MRA; }
+    int getMaxTrees() const { return this->maxTrees; }
+    size_t getMaxBytes() const { return this->maxBytes; }
+    size_t getNBytes() const { return this->nBytes; }
+    int getNTrees() const { return this->trees.size(); }
+
+    FunctionTree<D> *get();
+    void put(FunctionTree<D> *tree);
+    void clear();
+
+protected:
+    const MultiResolutionAnalysis<D> MRA;
+    size_t maxBytes;                        //max memory held by idle trees
+    int maxTrees;                           //max number of idle trees kept
+    size_t nBytes;                          //memory held by idle trees
+    std::deque<FunctionTree<D> *> trees;    //idle trees in root state, oldest first
+
+private:
+#ifdef HAVE_OPENMP
+    omp_lock_t pool_lock;
+#endif
+};
+
+#endif /* FUNCTIONTREEPOOL_H_ */
@@ -25,10 +25,10 @@ MWNode<D>::MWNode()
           parent(0),
           nodeIndex(),
           hilbertPath(),
-          squareNorm(-1.0),
-          status(0),
           n_coefs(0),
           coefs(0) {
+    attachMetadata();
+    *this->status = 0;
     setIsLeafNode();
     setIsLooseNode();
 
@@ -50,10 +50,10 @@ MWNode<D>::MWNode(const MWNode<D> &node)
           parent(0),
           nodeIndex(node.nodeIndex),
           hilbertPath(node.hilbertPath),
-          squareNorm(-1.0),
-          status(0),
           n_coefs(0),
           coefs(0) {
+    attachMetadata();
+    *this->status = 0;
     setIsLeafNode();
     setIsLooseNode();
 
@@ -225,6 +225,14 @@ void MWNode<D>::copyCoefsFromChildren() {
   *       representation, in oppose to s/d (scaling and wavelet). */
 template<int D>
 void MWNode<D>::cvTransform(int operation) {
+    cvTransformCoefs(operation, this->coefs);
+}
+
+/** Same as cvTransform, on an external array of getNCoefs() coefficients
+  * of a node at the same scale. Used to transform scratch copies of the
+  * coefficients without creating a temporary MWNode. */
+template<int D>
+void MWNode<D>::cvTransformCoefs(int operation, double *coefs) const {
     int kp1 = this->getKp1();
     int kp1_dm1 = MathUtils::ipow(kp1, D - 1);
     int kp1_d = this->getKp1_d();
@@ -235,7 +243,7 @@ void MWNode<D>::cvTransform(int operation) {
 
     double o_vec[nCoefs];
     double *out_vec = o_vec;
-    double *in_vec = this->coefs;
+    double *in_vec = coefs;
 
     for (int i = 0; i < D; i++) {
         for (int t = 0; t < this->getTDim(); t++) {
@@ -256,11 +264,11 @@ void MWNode<D>::cvTransform(int operation) {
     }
     if (IS_ODD(D)) {
         for (int i = 0; i < nCoefs; i++) {
-            this->coefs[i] = two_fac*in_vec[i];
+            coefs[i] = two_fac*in_vec[i];
         }
     } else {
         for (int i = 0; i < nCoefs; i++) {
-            this->coefs[i] *= two_fac;
+            coefs[i] *= two_fac;
         }
     }
 }
@@ -327,11 +335,19 @@ void MWNode<D>::cvTransform(int operation) {
   * is formally faster than the other algorithm, the separation of the
   * three dimensions prevent the possibility to use the norm of the
   * operator in order to discard a priori negligible contributions.
+  * In 3D the directions are run by the fused MathUtils::mwTransform3D.
 
   * Luca Frediani, August 2006
   * C++ version: Jonas Juselius, September 2009 */
 template<int D>
 void MWNode<D>::mwTransform(int operation) {
+    mwTransformCoefs(operation, this->coefs);
+}
+
+/** Same as mwTransform, on an external array of getNCoefs() coefficients
+  * of a node in the same tree. */
+template<int D>
+void MWNode<D>::mwTransformCoefs(int operation, double *coefs) const {
     int kp1 = this->getKp1();
     int kp1_dm1 = MathUtils::ipow(kp1, D - 1);
     int kp1_d = this->getKp1_d();
@@ -339,9 +355,16 @@ void MWNode<D>::mwTransform(int operation) {
     const MWFilter &filter = getMWTree().getMRA().getFilter();
     double overwrite = 0.0;
 
+    if (D == 3) {
+        const MatrixXd &filters = filter.getPackedSubFilters(operation);
+        MathUtils::mwTransform3D(coefs, kp1_d, coefs, kp1_d,
+                                 filters, kp1, false, 0.0);
+        return;
+    }
+
     double o_vec[nCoefs];
     double *out_vec = o_vec;
-    double *in_vec = this->coefs;
+    double *in_vec = coefs;
 
     for (int i = 0; i < D; i++) {
         int mask = 1 << i;
@@ -367,7 +390,7 @@ void MWNode<D>::mwTransform(int operation) {
     }
     if (IS_ODD(D)) {
         for (int i = 0; i < nCoefs; i++) {
-            this->coefs[i] = in_vec[i];
+            coefs[i] = in_vec[i];
         }
     }
 }
@@ -375,30 +398,29 @@ void MWNode<D>::mwTransform(int operation) {
 /** Set all norms to Undefined. */
 template<int D>
 void MWNode<D>::clearNorms() {
-    this->squareNorm = -1.0;
-    for (int i = 0; i < this->getTDim(); i++) {
-        this->componentNorms[i] = -1.0;
+    for (int i = 0; i <= this->getTDim(); i++) {
+        this->norms[i] = -1.0;
     }
 }
 
 /** Set all norms to zero. */
 template<int D>
 void MWNode<D>::zeroNorms() {
-    this->squareNorm = 0.0;
-    for (int i = 0; i < this->getTDim(); i++) {
-        this->componentNorms[i] = 0.0;
+    for (int i = 0; i <= this->getTDim(); i++) {
+        this->norms[i] = 0.0;
     }
 }
 
 /** Calculate and store square norm and component norms, if allocated. */
 template<int D>
 void MWNode<D>::calcNorms() {
-    this->squareNorm = 0.0;
+    double sqNorm = 0.0;
     for (int i = 0; i < this->getTDim(); i++) {
         double norm_i = calcComponentNorm(i);
-        this->componentNorms[i] = norm_i;
-        this->squareNorm += norm_i*norm_i;
+        this->norms[i+1] = norm_i;
+        sqNorm += norm_i*norm_i;
     }
+    this->norms[0] = sqNorm;
 }
 
 /** Calculate and return the squared scaling norm. */
@@ -68,10 +68,10 @@ public:
     inline bool isBranchNode() const;
     inline bool isLooseNode() const;
 
-    double getSquareNorm() const { return this->squareNorm; }
+    double getSquareNorm() const { return this->norms[0]; }
     double getScalingNorm() const;
     virtual double getWaveletNorm() const;
-    double getComponentNorm(int i) const { return this->componentNorms[i]; }
+    double getComponentNorm(int i) const { return this->norms[i+1]; }
     bool hasComponentNorms() const;
 
     int getNCoefs() const { return this->n_coefs; }
@@ -110,21 +110,24 @@ public:
     virtual void cvTransform(int kind);
     virtual void mwTransform(int kind);
 
+    void cvTransformCoefs(int kind, double *coefs) const;
+    void mwTransformCoefs(int kind, double *coefs) const;
+
     bool splitCheck(double prec, double splitFac, bool absPrec) const;
 
-    void setHasCoefs() { SET_BITS(status, FlagHasCoefs | FlagAllocated); }
-    void setIsEndNode() { SET_BITS(status, FlagEndNode); }
-    void setIsGenNode() { SET_BITS(status, FlagGenNode); }
-    void setIsRootNode() { SET_BITS(status, FlagRootNode); }
-    void setIsLeafNode() { CLEAR_BITS(status, FlagBranchNode); }
-    void setIsAllocated() { SET_BITS(status, FlagAllocated); }
-    void setIsBranchNode() { SET_BITS(status, FlagBranchNode); }
-    void setIsLooseNode() { SET_BITS(status, FlagLooseNode); }
-    void clearHasCoefs() { CLEAR_BITS(status, FlagHasCoefs);}
-    void clearIsEndNode() { CLEAR_BITS(status, FlagEndNode); }
-    void clearIsGenNode() { CLEAR_BITS(status, FlagGenNode); }
-    void clearIsRootNode() { CLEAR_BITS(status, FlagRootNode); }
-    void clearIsAllocated() { CLEAR_BITS(status, FlagAllocated); }
+    void setHasCoefs() { SET_BITS(*this->status, FlagHasCoefs | FlagAllocated); }
+    void setIsEndNode() { SET_BITS(*this->status, FlagEndNode); }
+    void setIsGenNode() { SET_BITS(*this->status, FlagGenNode); }
+    void setIsRootNode() { SET_BITS(*this->status, FlagRootNode); }
+    void setIsLeafNode() { CLEAR_BITS(*this->status, FlagBranchNode); }
+    void setIsAllocated() { SET_BITS(*this->status, FlagAllocated); }
+    void setIsBranchNode() { SET_BITS(*this->status, FlagBranchNode); }
+    void setIsLooseNode() { SET_BITS(*this->status, FlagLooseNode); }
+    void clearHasCoefs() { CLEAR_BITS(*this->status, FlagHasCoefs);}
+    void clearIsEndNode() { CLEAR_BITS(*this->status, FlagEndNode); }
+    void clearIsGenNode() { CLEAR_BITS(*this->status, FlagGenNode); }
+    void clearIsRootNode() { CLEAR_BITS(*this->status, FlagRootNode); }
+    void clearIsAllocated() { CLEAR_BITS(*this->status, FlagAllocated); }
 
     template<int T>
     friend std::ostream& operator<<(std::ostream &o, const MWNode<T> &nd);
@@ -144,8 +147,8 @@ protected:
     NodeIndex<D> nodeIndex;
     HilbertPath<D> hilbertPath;
 
-    double squareNorm;
-    double componentNorms[1<<D]; ///< 2^D components
+    double *norms;          ///< squareNorm followed by the 2^D component norms
+    double ownNorms[(1<<D)+1];
 
     int n_coefs;
     double *coefs;
@@ -157,6 +160,13 @@ protected:
     MWNode();
     virtual void dealloc() { NOT_REACHED_ABORT; }
 
+    /** Status flags and norms are kept in the node itself, unless the serial
+      * tree keeps them in its own arrays. Null pointers mean own storage. */
+    void attachMetadata(unsigned char *st = 0, double *nrm = 0) {
+        this->status = (st != 0) ? st : &this->ownStatus;
+        this->norms = (nrm != 0) ? nrm : this->ownNorms;
+    }
+
     bool crop(double prec, double splitFac, bool absPrec);
     double getScaleFactor(double splitFac, bool absPrec) const;
 
@@ -203,7 +213,8 @@ protected:
 #endif
 
 private:
-    unsigned char status;
+    unsigned char *status;
+    unsigned char ownStatus;
 };
 
 /** Allocation status of s/d-coefs is stored in the status bits for
@@ -211,7 +222,7 @@ private:
  */
 template<int D>
 bool MWNode<D>::isAllocated() const {
-    if (this->status & FlagAllocated) {
+    if (*this->status & FlagAllocated) {
         return true;
     }
     return false;
@@ -219,7 +230,7 @@ bool MWNode<D>::isAllocated() const {
 
 template<int D>
 bool MWNode<D>::hasCoefs() const {
-    if (this->status & FlagHasCoefs) {
+    if (*this->status & FlagHasCoefs) {
         return true;
     }
     return false;
@@ -227,7 +238,7 @@ bool MWNode<D>::hasCoefs() const {
 
 template<int D>
 bool MWNode<D>::isGenNode() const {
-    if (this->status & FlagGenNode) {
+    if (*this->status & FlagGenNode) {
         return true;
     }
     return false;
@@ -235,7 +246,7 @@ bool MWNode<D>::isGenNode() const {
 
 template<int D>
 bool MWNode<D>::isLeafNode() const {
-    if (this->status & FlagBranchNode) {
+    if (*this->status & FlagBranchNode) {
         return false;
     }
     return true;
@@ -243,7 +254,7 @@ bool MWNode<D>::isLeafNode() const {
 
 template<int D>
 bool MWNode<D>::isBranchNode() const {
-    if (this->status & FlagBranchNode) {
+    if (*this->status & FlagBranchNode) {
         return true;
     }
     return false;
@@ -251,7 +262,7 @@ bool MWNode<D>::isBranchNode() const {
 
 template<int D>
 bool MWNode<D>::isLooseNode() const {
-    if (this->status & FlagLooseNode) {
+    if (*this->status & FlagLooseNode) {
         return true;
     }
     return false;
@@ -259,7 +270,7 @@ bool MWNode<D>::isLooseNode() const {
 
 template<int D>
 bool MWNode<D>::isEndNode() const {
-    if (this->status & FlagEndNode) {
+    if (*this->status & FlagEndNode) {
         return true;
     }
     return false;
@@ -267,7 +278,7 @@ bool MWNode<D>::isEndNode() const {
 
 template<int D>
 bool MWNode<D>::isRootNode() const {
-    if (this->status & FlagRootNode) {
+    if (*this->status & FlagRootNode) {
         return true;
     }
     return false;
@@ -275,7 +286,7 @@ bool MWNode<D>::isRootNode() const {
 
 template<int D>
 bool MWNode<D>::checkStatus(unsigned char mask) const {
-    if (mask == (this->status & mask)) {
+    if (mask == (*this->status & mask)) {
         return true;
     }
     return false;
@@ -308,7 +319,7 @@ std::ostream& operator<<(std::ostream &o, const MWNode<D> &nd) {
         flags[5] = 'C';
     }
     o << " " << flags;
-    o << " sqNorm=" << nd.squareNorm;
+    o << " sqNorm=" << nd.getSquareNorm();
     if (nd.hasCoefs()) {
         o << " Coefs={";
         o << nd.getCoefs()[0] << ", " <<
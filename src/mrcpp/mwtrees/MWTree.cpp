@@ -157,6 +157,7 @@ void MWTree<D>::allocNodeCounters() {
     for (int i = 0; i < this->nThreads; i++) {
         this->nGenNodes[i] = 0;
     }
+    this->threadNodesAtDepth.resize(this->nThreads);
 }
 
 template<int D>
@@ -188,6 +189,7 @@ void MWTree<D>::incrementNodeCount(int scale) {
   * about it. */
 template<int D>
 void MWTree<D>::decrementNodeCount(int scale) {
+    updateNodeCounts();
     int depth = scale - getRootScale();
     assert(depth >= 0);
     assert(depth < this->nodesAtDepth.size());
@@ -200,6 +202,50 @@ void MWTree<D>::decrementNodeCount(int scale) {
     assert(this->nNodes >= 0);
 }
 
+/** Adds nNew nodes at the given scale to the private counters of the
+  * calling thread. Used when nodes are created inside a parallel region,
+  * the counts are merged into the tree counters by updateNodeCounts. */
+template<int D>
+void MWTree<D>::incrementThreadNodeCount(int scale, int nNew) {
+    int depth = scale - getRootScale();
+    assert(depth >= 0);
+    int n = omp_get_thread_num();
+    assert(n >= 0);
+    assert(n < this->nThreads);
+    std::vector<int> &count = this->threadNodesAtDepth[n];
+    if (depth >= count.size()) {
+        count.resize(depth + 1, 0);
+    }
+    count[depth] += nNew;
+}
+
+/** Merge the thread private node counters into the tree counters. Must be
+  * called outside of the parallel region that created the nodes, before
+  * the node counts of the tree are used. This is done by resetEndNodeTable
+  * and TreeAdaptor::splitNodeVector. */
+template<int D>
+void MWTree<D>::updateNodeCounts() {
+    for (int i = 0; i < this->nThreads; i++) {
+        std::vector<int> &count = this->threadNodesAtDepth[i];
+        if (count.size() > this->nodesAtDepth.size()) {
+            this->nodesAtDepth.resize(count.size(), 0);
+        }
+        for (int depth = 0; depth < count.size(); depth++) {
+            this->nodesAtDepth[depth] += count[depth];
+            this->nNodes += count[depth];
+        }
+        count.clear();
+    }
+}
+
+/** Discard the thread private node counters, when the tree is reset. */
+template<int D>
+void MWTree<D>::clearThreadNodeCounts() {
+    for (int i = 0; i < this->nThreads; i++) {
+        this->threadNodesAtDepth[i].clear();
+    }
+}
+
 /** Update GenNode counts in a safe way. Since GenNodes are created on the
   * fly, we cannot control when to update the node counters without locking
   * the whole tree. Therefore GenNodes update thread-private counters, which
@@ -258,9 +304,12 @@ int MWTree<D>::getNGenNodes() {
   * Recursive routine to find and return the node with a given NodeIndex.
   * This routine returns the appropriate ProjectedNode, or a NULL pointer if
   * the node does not exist, or if it is a GenNode. Recursion starts at the
-  * appropriate rootNode. */
+  * appropriate rootNode, unless the node can be looked up in the node map. */
 template<int D>
 const MWNode<D>* MWTree<D>::findNode(const NodeIndex<D> &idx) const {
+    if (this->serialTree_p->hasNodeMap()) {
+        return this->serialTree_p->lookupNode(idx);
+    }
     int rIdx = getRootBox().getBoxIndex(idx);
     if (rIdx < 0) return 0;
     const MWNode<D> &root = getRootBox().getNode(rIdx);
@@ -273,9 +322,12 @@ const MWNode<D>* MWTree<D>::findNode(const NodeIndex<D> &idx) const {
   * Recursive routine to find and return the node with a given NodeIndex.
   * This routine returns the appropriate ProjectedNode, or a NULL pointer if
   * the node does not exist, or if it is a GenNode. Recursion starts at the
-  * appropriate rootNode. */
+  * appropriate rootNode, unless the node can be looked up in the node map. */
 template<int D>
 MWNode<D>* MWTree<D>::findNode(const NodeIndex<D> &idx) {
+    if (this->serialTree_p->hasNodeMap()) {
+        return this->serialTree_p->lookupNode(idx);
+    }
     int rIdx = getRootBox().getBoxIndex(idx);
     if (rIdx < 0) return 0;
     MWNode<D> &root = this->rootBox.getNode(rIdx);
@@ -286,10 +338,15 @@ MWNode<D>* MWTree<D>::findNode(const NodeIndex<D> &idx) {
 /** Find and return the node with the given NodeIndex.
   *
   * This routine ALWAYS returns the node you ask for, and will generate nodes
-  * that does not exist. Recursion starts at the appropriate rootNode and
-  * decends from this.*/
+  * that does not exist. Existing ProjectedNodes are looked up in the node
+  * map if available, otherwise recursion starts at the appropriate rootNode
+  * and decends from this.*/
 template<int D>
 MWNode<D>& MWTree<D>::getNode(const NodeIndex<D> &idx) {
+    if (this->serialTree_p->hasNodeMap()) {
+        MWNode<D> *node = this->serialTree_p->lookupNode(idx);
+        if (node != 0) return *node;
+    }
     MWNode<D> &root = getRootBox().getNode(idx);
     assert(root.isAncestor(idx));
     return *root.retrieveNode(idx);
@@ -357,9 +414,11 @@ const MWNode<D>& MWTree<D>::getNodeOrEndNode(const double *r, int depth) const {
 }
 
 /** Traverse tree along the Hilbert path and find nodes of any rankId.
-  * Returns one nodeVector for the whole tree. GenNodes disregarded. */
+  * Returns one nodeVector for the whole tree. GenNodes disregarded.
+  * The serial tree provides the table if it keeps the tree structure. */
 template<int D>
 void MWTree<D>::makeNodeTable(MWNodeVector &nodeTable) {
+    if (this->serialTree_p->makeNodeTable(nodeTable)) return;
     HilbertIterator<D> it(this);
     it.setReturnGenNodes(false);
     while (it.next()) {
@@ -369,9 +428,11 @@ void MWTree<D>::makeNodeTable(MWNodeVector &nodeTable) {
 }
 
 /** Traverse tree along the Hilbert path and find nodes of any rankId.
-  * Returns one nodeVector per scale. GenNodes disregarded. */
+  * Returns one nodeVector per scale. GenNodes disregarded.
+  * The serial tree provides the table if it keeps the tree structure. */
 template<int D>
 void MWTree<D>::makeNodeTable(std::vector<MWNodeVector > &nodeTable) {
+    if (this->serialTree_p->makeNodeTable(nodeTable)) return;
     HilbertIterator<D> it(this);
     it.setReturnGenNodes(false);
     while (it.next()) {
@@ -396,7 +457,9 @@ MWNodeVector* MWTree<D>::copyEndNodeTable() {
 
 template<int D>
 void MWTree<D>::resetEndNodeTable() {
+    updateNodeCounts();
     clearEndNodeTable();
+    if (this->serialTree_p->makeEndNodeTable(this->endNodeTable)) return;
     HilbertIterator<D> it(this);
     it.setReturnGenNodes(false);
     while (it.next()) {
@@ -48,6 +48,7 @@ public:
     int getNNodes(int depth = -1) const;
     int getNEndNodes() const { return this->endNodeTable.size(); }
     int getNGenNodes();
+    void updateNodeCounts();
     int getRootScale() const { return this->rootBox.getScale(); }
     int getDepth() const { return this->nodesAtDepth.size(); }
 
@@ -138,6 +139,7 @@ protected:
     NodeBox<D> rootBox;            ///< The actual container of nodes
     MWNodeVector endNodeTable;	   ///< Final projected nodes
     std::vector<int> nodesAtDepth;  ///< Node counter
+    std::vector<std::vector<int> > threadNodesAtDepth; ///< Thread private node counters
 
     virtual void mwTransformDown(bool overwrite);
     virtual void mwTransformUp();
@@ -147,6 +149,8 @@ protected:
 
     void incrementNodeCount(int scale);
     void decrementNodeCount(int scale);
+    void incrementThreadNodeCount(int scale, int nNew);
+    void clearThreadNodeCounts();
     void updateGenNodeCounts();
     void incrementGenNodeCount();
     void decrementGenNodeCount();
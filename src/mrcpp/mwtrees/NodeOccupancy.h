@@ -0,0 +1,132 @@
+/**
+*
+* \brief Growable bitmap of the occupied node slots in a serial tree.
+*
+* One bit per node slot, with storage added one chunk at a time as the
+* serial tree allocates new chunks. Bits are updated with atomic word
+* operations, so threads may mark nodes in the same word concurrently.
+* Sibling groups (2^D nodes) are aligned relative to the start of the
+* chunk and never cross a word boundary, so for D=3 one group is one byte.
+*/
+
+#ifndef NODEOCCUPANCY_H_
+#define NODEOCCUPANCY_H_
+
+#include <stdint.h>
+#include <algorithm>
+
+#include "ChunkTable.h"
+
+class NodeOccupancy {
+public:
+    NodeOccupancy() : nodesPerChunk(0), wordsPerChunk(0) { }
+    virtual ~NodeOccupancy() {
+        for (int i = 0; i < this->words.size(); i++) delete[] this->words[i];
+    }
+
+    void setChunkSize(int nodes) {
+        assert(this->words.size() == 0);
+        this->nodesPerChunk = nodes;
+        this->wordsPerChunk = (nodes + 63)/64;
+    }
+
+    int size() const { return this->words.size()*this->nodesPerChunk; }
+    int getNChunks() const { return this->words.size(); }
+
+    /** Add storage for one more chunk of nodes, all unoccupied.
+      * Must not be called concurrently with itself. */
+    void addChunk() {
+        uint64_t *w = new uint64_t[this->wordsPerChunk];
+        for (int i = 0; i < this->wordsPerChunk; i++) {
+            w[i] = 0;
+        }
+        this->words.push_back(w);
+    }
+
+    /** Remove the storage of the last chunk. */
+    void removeChunk() {
+        delete[] this->words[this->words.size() - 1];
+        this->words.pop_back();
+    }
+
+    /** Mark all nodes as unoccupied, storage is retained. */
+    void clear() {
+        for (int c = 0; c < this->words.size(); c++) {
+            for (int i = 0; i < this->wordsPerChunk; i++) {
+                this->words[c][i] = 0;
+            }
+        }
+    }
+
+    bool isOccupied(int serialIx) const {
+        return ((getWord(serialIx) >> getBit(serialIx)) & 1);
+    }
+
+    /** True if none of the n nodes starting at first are occupied.
+      * The run must be contained in one word. */
+    bool isFree(int first, int n) const {
+        return ((getWord(first) & getMask(first, n)) == 0);
+    }
+
+    void setOccupied(int first, int n = 1) {
+        while (n > 0) {
+            int m = std::min(n, 64 - getBit(first));
+            uint64_t mask = getMask(first, m);
+            uint64_t &w = getWord(first);
+#pragma omp atomic
+            w |= mask;
+            first += m;
+            n -= m;
+        }
+    }
+
+    void setFree(int first, int n = 1) {
+        while (n > 0) {
+            int m = std::min(n, 64 - getBit(first));
+            uint64_t mask = ~getMask(first, m);
+            uint64_t &w = getWord(first);
+#pragma omp atomic
+            w &= mask;
+            first += m;
+            n -= m;
+        }
+    }
+
+    /** Mark one node as unoccupied. Returns true if this left the n nodes
+      * starting at first (a run in the same word) unoccupied. The bit is
+      * cleared and the old word read in one atomic operation, so when
+      * several threads free nodes of the same run, only the one that frees
+      * the last node gets true. */
+    bool setFreeInRun(int serialIx, int first, int n) {
+        uint64_t mask = getMask(serialIx, 1);
+        uint64_t &w = getWord(serialIx);
+        uint64_t old;
+#pragma omp atomic capture
+        { old = w; w &= ~mask; }
+        return (((old & ~mask) & getMask(first, n)) == 0);
+    }
+
+protected:
+    int nodesPerChunk;
+    int wordsPerChunk;
+    ChunkTable<uint64_t *> words;
+
+    int getBit(int serialIx) const { return (serialIx%this->nodesPerChunk)%64; }
+
+    uint64_t &getWord(int serialIx) {
+        int chunk = serialIx/this->nodesPerChunk;
+        return this->words[chunk][(serialIx%this->nodesPerChunk)/64];
+    }
+    const uint64_t &getWord(int serialIx) const {
+        int chunk = serialIx/this->nodesPerChunk;
+        return this->words[chunk][(serialIx%this->nodesPerChunk)/64];
+    }
+
+    uint64_t getMask(int first, int n) const {
+        assert(n > 0 and getBit(first) + n <= 64);
+        uint64_t mask = (n == 64) ? ~((uint64_t) 0) : ((((uint64_t) 1) << n) - 1);
+        return mask << getBit(first);
+    }
+};
+
+#endif /* NODEOCCUPANCY_H_ */
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "OperatorTree.h"
 #include "SerialOperatorTree.h"
 #include "OperatorNode.h"
@@ -178,3 +180,146 @@ void OperatorTree::mwTransformDown(bool overwrite) {
         }
     }
 }
+
+/** Header of the binary operator tree format. The MRA parameters are stored
+  * for validation only, the tree must be read into a tree with the same MRA
+  * and norm precision. Data is stored in native byte order. */
+struct OperTreeFileHeader {
+    char magic[8];
+    int version;
+    int scalingType;
+    int order;
+    int rootScale;
+    int rootCorner[2];
+    int rootBoxes[2];
+    int nCoefs;
+    int nNodes;
+    double normPrec;
+    double squareNorm;
+};
+
+static const char operFileMagic[8] = {'M','W','O','P','E','R','\0','\0'};
+static const int operFileVersion = 1;
+
+static void setOperFileHeader(OperTreeFileHeader &header,
+                              const MultiResolutionAnalysis<2> &mra) {
+    for (int i = 0; i < 8; i++) header.magic[i] = operFileMagic[i];
+    header.version = operFileVersion;
+    header.scalingType = mra.getScalingBasis().getScalingType();
+    header.order = mra.getOrder();
+
+    const BoundingBox<2> &world = mra.getWorldBox();
+    header.rootScale = world.getScale();
+    for (int d = 0; d < 2; d++) {
+        header.rootCorner[d] = world.getCornerIndex().getTranslation(d);
+        header.rootBoxes[d] = world.size(d);
+    }
+}
+
+/** Write the tree to a binary stream. The nodes are written breadth first
+  * starting at the root nodes, each with a branch flag, its norms and its
+  * coefficients. The norms are stored rather than recomputed on
+  * reading since the operator norms are estimated with random vectors. */
+bool OperatorTree::saveTree(ostream &out) const {
+    vector<const MWNode<2> *> nodes;
+    for (int i = 0; i < this->rootBox.size(); i++) {
+        nodes.push_back(&getRootMWNode(i));
+    }
+    for (int n = 0; n < nodes.size(); n++) {
+        const MWNode<2> &node = *nodes[n];
+        for (int i = 0; i < node.getNChildren(); i++) {
+            nodes.push_back(&node.getMWChild(i));
+        }
+    }
+
+    OperTreeFileHeader header;
+    setOperFileHeader(header, this->getMRA());
+    header.nCoefs = getRootMWNode(0).getNCoefs();
+    header.nNodes = nodes.size();
+    header.normPrec = this->normPrec;
+    header.squareNorm = this->squareNorm;
+    out.write((const char *) &header, sizeof(OperTreeFileHeader));
+
+    for (int n = 0; n < nodes.size(); n++) {
+        const MWNode<2> &node = *nodes[n];
+        char branch = node.isBranchNode();
+        out.write(&branch, sizeof(char));
+        out.write((const char *) node.norms, 5*sizeof(double));
+        out.write((const char *) node.getCoefs(), header.nCoefs*sizeof(double));
+    }
+    if (not out.good()) {
+        MSG_ERROR("Error writing operator tree");
+        return false;
+    }
+    return true;
+}
+
+/** Read a tree from a binary stream written by saveTree. The tree must be in
+  * its initial state, i.e. holding only empty root nodes. The nodes are
+  * recreated in the order they were written, and the coefficients and norms
+  * are read directly into them. The operator node cache is not set up. */
+bool OperatorTree::loadTree(istream &in) {
+    OperTreeFileHeader header;
+    in.read((char *) &header, sizeof(OperTreeFileHeader));
+    if (not in.good() or memcmp(header.magic, operFileMagic, 8) != 0) {
+        MSG_ERROR("Invalid operator tree file");
+        return false;
+    }
+    if (header.version != operFileVersion) {
+        MSG_ERROR("Unsupported operator tree file version " << header.version);
+        return false;
+    }
+
+    OperTreeFileHeader ref;
+    setOperFileHeader(ref, this->getMRA());
+    bool match = (header.scalingType == ref.scalingType and
+                  header.order == ref.order and
+                  header.rootScale == ref.rootScale and
+                  header.normPrec == this->normPrec and
+                  header.nCoefs == getRootMWNode(0).getNCoefs());
+    for (int d = 0; d < 2; d++) {
+        if (header.rootCorner[d] != ref.rootCorner[d]) match = false;
+        if (header.rootBoxes[d] != ref.rootBoxes[d]) match = false;
+    }
+    if (not match) {
+        MSG_ERROR("Operator tree file does not match MRA");
+        return false;
+    }
+    for (int i = 0; i < this->rootBox.size(); i++) {
+        if (getRootMWNode(i).isBranchNode()) MSG_FATAL("Tree not empty");
+    }
+
+    vector<MWNode<2> *> nodes;
+    for (int i = 0; i < this->rootBox.size(); i++) {
+        nodes.push_back(&getRootMWNode(i));
+    }
+    for (int n = 0; n < nodes.size(); n++) {
+        if (nodes.size() > header.nNodes) {
+            MSG_ERROR("Invalid operator tree file");
+            return false;
+        }
+        MWNode<2> &node = *nodes[n];
+        char branch = 0;
+        in.read(&branch, sizeof(char));
+        in.read((char *) node.norms, 5*sizeof(double));
+        in.read((char *) node.getCoefs(), header.nCoefs*sizeof(double));
+        if (not in.good()) {
+            MSG_ERROR("Error reading operator tree");
+            return false;
+        }
+        node.setHasCoefs();
+        if (branch) {
+            node.createChildren();
+            for (int i = 0; i < node.getNChildren(); i++) {
+                nodes.push_back(&node.getMWChild(i));
+            }
+        }
+    }
+    if (nodes.size() != header.nNodes) {
+        MSG_ERROR("Invalid operator tree file");
+        return false;
+    }
+    this->squareNorm = header.squareNorm;
+    this->resetEndNodeTable();
+    return true;
+}
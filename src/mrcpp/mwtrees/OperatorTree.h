@@ -17,6 +17,11 @@ public:
     void setupOperNodeCache();
     void clearOperNodeCache();
 
+    using MWTree<2>::saveTree;
+    using MWTree<2>::loadTree;
+    bool saveTree(std::ostream &out) const;
+    bool loadTree(std::istream &in);
+
     BandWidth &getBandWidth() { return *this->bandWidth; }
     const BandWidth &getBandWidth() const { return *this->bandWidth; }
 
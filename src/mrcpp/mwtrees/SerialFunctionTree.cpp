@@ -1,7 +1,10 @@
+#include <algorithm>
+
 #include "SerialFunctionTree.h"
 #include "FunctionTree.h"
 #include "ProjectedNode.h"
 #include "GenNode.h"
+#include "HilbertPath.h"
 
 using namespace std;
 
@@ -21,13 +24,10 @@ int NFtrees=0;
 template<int D>
 SerialFunctionTree<D>::SerialFunctionTree(FunctionTree<D> *tree, int max_nodes)
         : SerialTree<D>(tree),
-          maxGenNodes(max_nodes),
-          nGenNodes(0),
-          lastNode(0),
-          lastGenNode(0) {
+          nGenNodes(0) {
 
 
-    this->maxNodes = max_nodes;
+    this->maxNodes = max_nodes;//informative only, storage grows as needed
     this->nNodes = 0;
 
     NFtrees++;
@@ -48,33 +48,20 @@ SerialFunctionTree<D>::SerialFunctionTree(FunctionTree<D> *tree, int max_nodes)
       this->maxNodesPerChunk = sizePerChunk/this->sizeGenNodeCoeff;
     }
 
-    //indicate occupation of nodes
-    this->nodeStackStatus = new int[this->maxNodes + 1];
-    this->genNodeStackStatus = new int[this->maxGenNodes + 1];
-
-    this->lastNode = (ProjectedNode<D>*) this->sNodes;//position of last allocated node
-    this->lastGenNode = this->sGenNodes;//position of last allocated Gen node
-
-    //initialize stacks
-    for (int i = 0; i < this->maxNodes; i++) {
-        this->nodeStackStatus[i] = 0;//0=unoccupied
-    }
-    this->nodeStackStatus[this->maxNodes] = -1;//=unavailable
-
-    //initialize stacks
-    for (int i = 0; i < this->maxGenNodes; i++) {
-        this->genNodeStackStatus[i] = 0;//0=unoccupied
-    }
-    this->genNodeStackStatus[this->maxGenNodes] = -1;//=unavailable
+    //occupation of nodes, grows with the number of chunks
+    this->nodeOccupancy.setChunkSize(this->maxNodesPerChunk);
+    this->genNodeOccupancy.setChunkSize(this->maxNodesPerChunk);
 
-    //make virtual table pointers
-    ProjectedNode<D>* tmpNode = new ProjectedNode<D>();
-    this->cvptr_ProjectedNode =  *(char**)(tmpNode);
-    delete tmpNode;
+    //each thread reserves up to 64 sibling groups at once
+    this->slabSize = (1<<D)*std::min(this->maxNodesPerChunk/(1<<D), 64);
+    this->nodeSlabs.resize(omp_get_max_threads());
+    this->genNodeSlabs.resize(omp_get_max_threads());
+    this->resetSlabs(false);
+    this->resetSlabs(true);
 
-    GenNode<D>* tmpGenNode = new GenNode<D>();
-    this->cvptr_GenNode =  *(char**)(tmpGenNode);
-    delete tmpGenNode;
+    //virtual table pointers, shared by all trees of the same dimension
+    this->cvptr_ProjectedNode = getProjectedNodeVptr();
+    this->cvptr_GenNode = getGenNodeVptr();
 
 #ifdef HAVE_OPENMP
     omp_init_lock(&Sfunc_tree_lock);
@@ -88,9 +75,10 @@ SerialFunctionTree<D>::~SerialFunctionTree() {
     for (int i = 0; i < this->nodeChunks.size(); i++) delete[] (char*)(this->nodeChunks[i]);
     for (int i = 0; i < this->nodeCoeffChunks.size(); i++) delete[] this->nodeCoeffChunks[i];
     for (int i = 0; i < this->genNodeChunks.size(); i++) delete[] (char*)(this->genNodeChunks[i]);
-
-    delete[] this->nodeStackStatus;
-    delete[] this->genNodeStackStatus;
+    for (int i = 0; i < this->statusChunks.size(); i++) delete[] this->statusChunks[i];
+    for (int i = 0; i < this->parentIxChunks.size(); i++) delete[] this->parentIxChunks[i];
+    for (int i = 0; i < this->childIxChunks.size(); i++) delete[] this->childIxChunks[i];
+    for (int i = 0; i < this->normChunks.size(); i++) delete[] this->normChunks[i];
 
     NFtrees--;
 
@@ -99,6 +87,58 @@ SerialFunctionTree<D>::~SerialFunctionTree() {
 #endif
 }
 
+/** Virtual table pointers are found from a temporary node, which is
+  * constructed only once for each dimension. */
+template<int D>
+char *SerialFunctionTree<D>::getProjectedNodeVptr() {
+    static char *vptr = 0;
+#pragma omp critical(serial_tree_vptr)
+    if (vptr == 0) {
+        ProjectedNode<D>* tmpNode = new ProjectedNode<D>();
+        vptr = *(char**)(tmpNode);
+        delete tmpNode;
+    }
+    return vptr;
+}
+
+template<int D>
+char *SerialFunctionTree<D>::getGenNodeVptr() {
+    static char *vptr = 0;
+#pragma omp critical(serial_tree_vptr)
+    if (vptr == 0) {
+        GenNode<D>* tmpGenNode = new GenNode<D>();
+        vptr = *(char**)(tmpGenNode);
+        delete tmpGenNode;
+    }
+    return vptr;
+}
+
+/** Discard all nodes and GenNodes and allocate new root nodes, leaving the
+  * tree in the same state as after construction. Allocated chunks are kept
+  * for reuse, so no heap allocation is done here. */
+template<int D>
+void SerialFunctionTree<D>::clear() {
+    MWTree<D> *tree = this->getTree();
+
+    this->nodeOccupancy.clear();
+    this->genNodeOccupancy.clear();
+    this->nNodes = 0;
+    this->nGenNodes = 0;
+    this->resetSlabs(false);
+    this->resetSlabs(true);
+    if (this->nodeMap != 0) this->nodeMap->clear();
+
+    tree->nNodes = 0;
+    tree->nodesAtDepth.assign(1, 0);
+    tree->clearThreadNodeCounts();
+    for (int i = 0; i < tree->getNThreads(); i++) {
+        tree->nGenNodes[i] = 0;
+    }
+    tree->squareNorm = -1.0;
+
+    this->allocRoots(*tree);
+}
+
 template<int D>
 void SerialFunctionTree<D>::allocRoots(MWTree<D> &tree) {
     int sIx;
@@ -129,7 +169,8 @@ void SerialFunctionTree<D>::allocRoots(MWTree<D> &tree) {
         root_p->parentSerialIx = -1;//to indicate rootnode
         root_p->childSerialIx = -1;
 
-        root_p->status = 0;
+        this->attachNode(root_p, sIx, -1, -1);
+        *root_p->status = 0;
 
         root_p->clearNorms();
         root_p->setIsLeafNode();
@@ -139,6 +180,7 @@ void SerialFunctionTree<D>::allocRoots(MWTree<D> &tree) {
         root_p->setIsRootNode();
 
         tree.incrementNodeCount(root_p->getScale());
+        if (this->nodeMap != 0) (*this->nodeMap)[root_p->nodeIndex] = root_p;
 
 #ifdef OPENMP
         omp_init_lock(&(root_p->node_lock));
@@ -161,6 +203,7 @@ void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
 
     //position of first child
     parent.childSerialIx = sIx;
+    this->setChildIx(parent.serialIx, sIx);
     for (int cIdx = 0; cIdx < nChildren; cIdx++) {
         parent.children[cIdx] = child_p;
 
@@ -182,7 +225,8 @@ void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
         child_p->parentSerialIx = parent.serialIx;
         child_p->childSerialIx = -1;
 
-        child_p->status = 0;
+        this->attachNode(child_p, sIx, parent.serialIx, -1);
+        *child_p->status = 0;
 
         child_p->clearNorms();
         child_p->setIsLeafNode();
@@ -190,8 +234,6 @@ void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
         child_p->clearHasCoefs();
         child_p->setIsEndNode();
 
-        child_p->tree->incrementNodeCount(child_p->getScale());
-
 #ifdef OPENMP
         omp_init_lock(&child_p->node_lock);
 #endif
@@ -200,6 +242,25 @@ void SerialFunctionTree<D>::allocChildren(MWNode<D> &parent) {
         child_p++;
         coefs_p += this->sizeNodeCoeff;
     }
+
+    //in parallel the new nodes are counted per thread, and merged into the
+    //tree counters by MWTree::updateNodeCounts after the parallel region
+    if (omp_in_parallel()) {
+        parent.tree->incrementThreadNodeCount(parent.getScale() + 1, nChildren);
+    } else {
+        for (int cIdx = 0; cIdx < nChildren; cIdx++) {
+            parent.tree->incrementNodeCount(parent.getScale() + 1);
+        }
+    }
+
+    //the node map is not thread safe
+    if (this->nodeMap != 0) {
+        if (omp_in_parallel()) omp_set_lock(&Sfunc_tree_lock);
+        for (int cIdx = 0; cIdx < nChildren; cIdx++) {
+            (*this->nodeMap)[parent.children[cIdx]->nodeIndex] = parent.children[cIdx];
+        }
+        if (omp_in_parallel()) omp_unset_lock(&Sfunc_tree_lock);
+    }
 }
 
 template<int D>
@@ -234,7 +295,8 @@ void SerialFunctionTree<D>::allocGenChildren(MWNode<D> &parent) {
 	child_p->parentSerialIx = parent.serialIx;
 	child_p->childSerialIx = -1;
 
-	child_p->status = 0;
+	child_p->attachMetadata();
+	*child_p->status = 0;
 
         child_p->clearNorms();
 	child_p->setIsLeafNode();
@@ -254,236 +316,653 @@ void SerialFunctionTree<D>::allocGenChildren(MWNode<D> &parent) {
     }
 }
 
-//return pointer to the last active node or NULL if failed
+//return pointer to the first of nAlloc consecutive nodes
 template<int D>
 ProjectedNode<D>* SerialFunctionTree<D>::allocNodes(int nAlloc, int *serialIx, double **coefs_p) {
-    *serialIx = this->nNodes;
-    int chunkIx = *serialIx%(this->maxNodesPerChunk);
+    *serialIx = this->allocSerialIx(nAlloc, false);
 
-    if (chunkIx == 0 or chunkIx+nAlloc > this->maxNodesPerChunk ) {
-        //start on new chunk
-        if (this->nNodes+nAlloc >= this->maxNodes){
-            MSG_FATAL("maxNodes exceeded " << this->maxNodes);
-        }
+    int chunk = *serialIx/this->maxNodesPerChunk;
+    int chunkIx = *serialIx%this->maxNodesPerChunk;
+    *coefs_p = this->nodeCoeffChunks[chunk] + chunkIx*this->sizeNodeCoeff;
 
-        //we want nodes allocated simultaneously to be allocated on the same pice.
-        //possibly jump over the last nodes from the old chunk
-        this->nNodes = this->maxNodesPerChunk*((this->nNodes+nAlloc-1)/this->maxNodesPerChunk);//start of next chunk
-
-        int chunk = this->nNodes/this->maxNodesPerChunk;//find the right chunk
-
-        //careful: nodeChunks.size() is an unsigned int
-        if (chunk+1 > this->nodeChunks.size()){
-	    //need to allocate new chunk
-	    this->sNodes = (ProjectedNode<D>*) new char[this->maxNodesPerChunk*sizeof(ProjectedNode<D>)];
-	    this->nodeChunks.push_back(this->sNodes);
-            double *sNodesCoeff = new double[this->sizeNodeCoeff*this->maxNodesPerChunk];
-            this->nodeCoeffChunks.push_back(sNodesCoeff);
-	    if (chunk%100==99 and D==3) println(10,endl<<" number of nodes "<<this->nNodes <<",number of Nodechunks now " << this->nodeChunks.size()<<", total size coeff  (MB) "<<(this->nNodes/1024) * this->sizeNodeCoeff/128);
-        }
-        this->lastNode = this->nodeChunks[chunk] + this->nNodes%(this->maxNodesPerChunk);
-        *serialIx = this->nNodes;
-        chunkIx = *serialIx%(this->maxNodesPerChunk);
+    return this->nodeChunks[chunk] + chunkIx;
+}
+
+/** Point the status and norms of a ProjectedNode to the metadata arrays, and
+  * store its parent and child indices there. */
+template<int D>
+void SerialFunctionTree<D>::attachNode(ProjectedNode<D> *node, int serialIx, int parentIx, int childIx) {
+    int chunk = serialIx/this->maxNodesPerChunk;
+    int chunkIx = serialIx%this->maxNodesPerChunk;
+    node->attachMetadata(this->statusChunks[chunk] + chunkIx,
+                         this->normChunks[chunk] + chunkIx*getNNormsPerNode());
+    this->parentIxChunks[chunk][chunkIx] = parentIx;
+    this->childIxChunks[chunk][chunkIx] = childIx;
+}
+
+template<int D>
+void SerialFunctionTree<D>::deallocNodes(int serialIx) {
+    if (this->nodeMap != 0) {
+        ProjectedNode<D> &node = this->nodeChunks[serialIx/this->maxNodesPerChunk][serialIx%this->maxNodesPerChunk];
+        if (omp_in_parallel()) omp_set_lock(&Sfunc_tree_lock);
+        this->nodeMap->erase(node.getNodeIndex());
+        if (omp_in_parallel()) omp_unset_lock(&Sfunc_tree_lock);
     }
-    assert((this->nNodes+nAlloc-1)/this->maxNodesPerChunk < this->nodeChunks.size());
+    this->freeSerialIx(serialIx, false);
+}
+
+//return pointer to the first of nAlloc consecutive Gen nodes
+template<int D>
+GenNode<D>* SerialFunctionTree<D>::allocGenNodes(int nAlloc, int *serialIx, double **coefs_p) {
+    //Not necessarily wrong, but new:
+    assert(nAlloc == (1<<D));
 
-    ProjectedNode<D> *newNode  = this->lastNode;
-    ProjectedNode<D> *newNode_cp  = newNode;
+    *serialIx = this->allocSerialIx(nAlloc, true);
 
-    int chunk = this->nNodes/this->maxNodesPerChunk;//find the right chunk
-    *coefs_p = this->nodeCoeffChunks[chunk] + chunkIx*this->sizeNodeCoeff;
- 
+    int chunk = *serialIx/this->maxNodesPerChunk;
+    int chunkIx = *serialIx%this->maxNodesPerChunk;
+    *coefs_p = this->genNodeCoeffChunks[chunk] + chunkIx*this->sizeGenNodeCoeff;
+
+    GenNode<D>* newNode = this->genNodeChunks[chunk] + chunkIx;
     for (int i = 0; i < nAlloc; i++) {
-        if (this->nodeStackStatus[*serialIx+i] != 0)
-	    println(0, *serialIx+i<<" NodeStackStatus: not available " << this->nodeStackStatus[*serialIx+i]);
-        this->nodeStackStatus[*serialIx+i] = 1;
-        newNode_cp++;
+        newNode[i].serialIx = *serialIx+i;//Until overwritten!
     }
-    this->nNodes += nAlloc;
-    this->lastNode += nAlloc;
-
     return newNode;
 }
 
 template<int D>
-void SerialFunctionTree<D>::deallocNodes(int serialIx) {
-    if (this->nNodes < 0) {
-        println(0, "minNodes exceeded " << this->nNodes);
-        this->nNodes++;
-    }
-    this->nodeStackStatus[serialIx] = 0;//mark as available
-    if (serialIx == this->nNodes-1) {//top of stack
-        int topStack = this->nNodes;
-        while (this->nodeStackStatus[topStack-1] == 0){
-            topStack--;
-            if (topStack < 1) break;
+void SerialFunctionTree<D>::deallocGenNodes(int serialIx) {
+    this->freeSerialIx(serialIx, true);
+}
+
+/** Return the serialIx of nAlloc consecutive free nodes and mark them as
+  * occupied. Sibling groups are taken from the free-list or the slab of the
+  * calling thread without locking. The lock is only taken when the thread
+  * needs a new slab, or groups released by other threads. Larger blocks
+  * (root nodes) are always reserved under the lock. */
+template<int D>
+int SerialFunctionTree<D>::allocSerialIx(int nAlloc, bool genNodes) {
+    int tDim = (1<<D);
+    NodeOccupancy &occupancy = (genNodes) ? this->genNodeOccupancy : this->nodeOccupancy;
+    std::vector<int> &sharedFree = (genNodes) ? this->freeGenNodeGroups : this->freeNodeGroups;
+    std::vector<NodeSlab> &slabs = (genNodes) ? this->genNodeSlabs : this->nodeSlabs;
+    assert(omp_get_thread_num() < slabs.size());
+    NodeSlab &slab = slabs[omp_get_thread_num()];
+
+    int sIx = -1;
+    if (nAlloc == tDim) {
+        if (slab.freeGroups.size() == 0 and slab.next + nAlloc > slab.end) {
+            omp_set_lock(&Sfunc_tree_lock);
+            //take over groups released by other threads before growing
+            while (sharedFree.size() > 0 and slab.freeGroups.size() < this->slabSize/tDim) {
+                slab.freeGroups.push_back(sharedFree.back());
+                sharedFree.pop_back();
+            }
+            if (slab.freeGroups.size() == 0) {
+                slab.next = this->reserveSlab(nAlloc, &slab.end, genNodes);
+            }
+            omp_unset_lock(&Sfunc_tree_lock);
+        }
+        if (slab.freeGroups.size() > 0) {
+            sIx = slab.freeGroups.back();
+            slab.freeGroups.pop_back();
+        } else {
+            sIx = slab.next;
+            slab.next += nAlloc;
         }
-        this->nNodes = topStack;//move top of stack
-        //has to redefine lastNode
-        int chunk = this->nNodes/this->maxNodesPerChunk;//find the right chunk
-        this->lastNode = this->nodeChunks[chunk] + this->nNodes%(this->maxNodesPerChunk);
+    } else {
+        int end;
+        omp_set_lock(&Sfunc_tree_lock);
+        sIx = this->reserveSlab(nAlloc, &end, genNodes);
+        omp_unset_lock(&Sfunc_tree_lock);
     }
+
+    if (nAlloc == tDim and not occupancy.isFree(sIx, nAlloc))
+        println(0, sIx<<" NodeStackStatus: not available ");
+    occupancy.setOccupied(sIx, nAlloc);
+    return sIx;
 }
 
-//return pointer to the last active node or NULL if failed
+/** Mark the node as unoccupied. When the whole sibling group is released
+  * it is put on the free-list of the calling thread, and excess groups are
+  * handed over to the shared free-list. Siblings may be released by
+  * different threads, only the thread that frees the last node of the
+  * group puts it on a free-list. */
 template<int D>
-GenNode<D>* SerialFunctionTree<D>::allocGenNodes(int nAlloc, int *serialIx, double **coefs_p) {
-    omp_set_lock(&Sfunc_tree_lock);
-    *serialIx = this->nGenNodes;
-    int chunkIx = *serialIx%(this->maxNodesPerChunk);
-  
-    //Not necessarily wrong, but new:
-    assert(nAlloc == (1<<D));
+void SerialFunctionTree<D>::freeSerialIx(int serialIx, bool genNodes) {
+    int tDim = (1<<D);
+    NodeOccupancy &occupancy = (genNodes) ? this->genNodeOccupancy : this->nodeOccupancy;
+    std::vector<int> &sharedFree = (genNodes) ? this->freeGenNodeGroups : this->freeNodeGroups;
+    std::vector<NodeSlab> &slabs = (genNodes) ? this->genNodeSlabs : this->nodeSlabs;
+    assert(omp_get_thread_num() < slabs.size());
+    NodeSlab &slab = slabs[omp_get_thread_num()];
+
+    //groups are aligned relative to the start of the chunk
+    int first = serialIx - (serialIx%this->maxNodesPerChunk)%tDim;
+    if (not occupancy.setFreeInRun(serialIx, first, tDim)) return;
+    slab.freeGroups.push_back(first);
+
+    int maxGroups = 2*this->slabSize/tDim;
+    if (slab.freeGroups.size() > maxGroups) {
+        omp_set_lock(&Sfunc_tree_lock);
+        while (slab.freeGroups.size() > maxGroups/2) {
+            sharedFree.push_back(slab.freeGroups.back());
+            slab.freeGroups.pop_back();
+        }
+        omp_unset_lock(&Sfunc_tree_lock);
+    }
+}
+
+/** Reserve a new range of serial indices at the top of the stack, large
+  * enough for nAlloc nodes and at most slabSize nodes if possible. The range
+  * never crosses a chunk boundary and starts on a sibling group boundary.
+  * Must be called with the lock set. Returns the first serialIx of the
+  * range, and its end in slabEnd. */
+template<int D>
+int SerialFunctionTree<D>::reserveSlab(int nAlloc, int *slabEnd, bool genNodes) {
+    int tDim = (1<<D);
+    int &topStack = (genNodes) ? this->nGenNodes : this->nNodes;
 
-    if(chunkIx == 0  or  chunkIx+nAlloc > this->maxNodesPerChunk ){
-        //start on new chunk
-        if (this->nGenNodes+nAlloc >= this->maxGenNodes){
-	    MSG_FATAL("maxNodes exceeded " << this->maxGenNodes);
-        } 
+    int nReserve = tDim*((nAlloc + tDim - 1)/tDim);
+    int nUsable = tDim*(this->maxNodesPerChunk/tDim);//usable nodes per chunk
+    if (nReserve > nUsable) MSG_FATAL("Too many nodes in one allocation " << nAlloc);
 
+    int start = topStack;
+    int chunkEnd = this->maxNodesPerChunk*(start/this->maxNodesPerChunk) + nUsable;
+    if (start + nReserve > chunkEnd) {
         //we want nodes allocated simultaneously to be allocated on the same chunk.
         //possibly jump over the last nodes from the old chunk
-        this->nGenNodes=this->maxNodesPerChunk*((this->nGenNodes+nAlloc-1)/this->maxNodesPerChunk);//start of next chunk
-
-        int chunk = this->nGenNodes/this->maxNodesPerChunk;//find the right chunk
-
-        //careful: nodeChunks.size() is an unsigned int
-        if(chunk+1 > this->genNodeChunks.size()){
-	    //need to allocate new chunk
-	    this->sGenNodes = (GenNode<D>*) new char[this->maxNodesPerChunk*sizeof(GenNode<D>)];
-	    this->genNodeChunks.push_back(this->sGenNodes);
-	    double *sGenNodesCoeff = new double[this->sizeGenNodeCoeff*this->maxNodesPerChunk];
-	    this->genNodeCoeffChunks.push_back(sGenNodesCoeff);
-	    if(chunk%100==99 and D==3)println(10,endl<<" number of GenNodes "<<this->nGenNodes <<",number of GenNodechunks now " << this->genNodeChunks.size()<<", total size coeff  (MB) "<<(this->nGenNodes/1024) * this->sizeGenNodeCoeff/128);
+        start = chunkEnd - nUsable + this->maxNodesPerChunk;//start of next chunk
+        chunkEnd = start + nUsable;
+    }
+    int end = std::min(start + std::max(nReserve, this->slabSize), chunkEnd);
+
+    int chunk = start/this->maxNodesPerChunk;//find the right chunk
+    if (genNodes) {
+        this->allocGenChunks(chunk + 1);
+    } else {
+        this->allocChunks(chunk + 1);
+    }
+
+    topStack = end;
+    *slabEnd = end;
+    return start;
+}
+
+/** Clear the thread slabs and rebuild the shared free-list from the stack
+  * status, e.g. after the nodes have been rewritten. The top of the stack is
+  * moved to the next sibling group boundary. */
+template<int D>
+void SerialFunctionTree<D>::resetSlabs(bool genNodes) {
+    int tDim = (1<<D);
+    NodeOccupancy &occupancy = (genNodes) ? this->genNodeOccupancy : this->nodeOccupancy;
+    int &topStack = (genNodes) ? this->nGenNodes : this->nNodes;
+    std::vector<int> &sharedFree = (genNodes) ? this->freeGenNodeGroups : this->freeNodeGroups;
+    std::vector<NodeSlab> &slabs = (genNodes) ? this->genNodeSlabs : this->nodeSlabs;
+
+    int nUsable = tDim*(this->maxNodesPerChunk/tDim);
+    int chunkIx = topStack%this->maxNodesPerChunk;
+    if (chunkIx > nUsable) {
+        topStack += this->maxNodesPerChunk - chunkIx;//start of next chunk
+    } else if (chunkIx%tDim != 0) {
+        topStack += tDim - chunkIx%tDim;
+    }
+
+    for (int i = 0; i < slabs.size(); i++) {
+        slabs[i].next = 0;
+        slabs[i].end = 0;
+        slabs[i].freeGroups.clear();
+    }
+
+    //free groups below the top of the stack, highest first
+    sharedFree.clear();
+    for (int first = topStack - tDim; first >= 0; first -= tDim) {
+        if (first%this->maxNodesPerChunk + tDim > nUsable) {
+            first = this->maxNodesPerChunk*(first/this->maxNodesPerChunk) + nUsable;
+            continue;
         }
-        this->lastGenNode = this->genNodeChunks[chunk] + this->nGenNodes%(this->maxNodesPerChunk);
-        *serialIx = this->nGenNodes; 
-        chunkIx = *serialIx%(this->maxNodesPerChunk);
+        if (occupancy.isFree(first, tDim)) sharedFree.push_back(first);
+    }
+}
+
+/** Make sure that at least nChunks chunks of GenNodes are allocated. */
+template<int D>
+void SerialFunctionTree<D>::allocGenChunks(int nChunks) {
+    while (nChunks > this->genNodeChunks.size()) {
+        this->sGenNodes = (GenNode<D>*) new char[this->maxNodesPerChunk*sizeof(GenNode<D>)];
+        this->genNodeChunks.push_back(this->sGenNodes);
+        double *sGenNodesCoeff = new double[this->sizeGenNodeCoeff*this->maxNodesPerChunk];
+        this->genNodeCoeffChunks.push_back(sGenNodesCoeff);
+        this->genNodeOccupancy.addChunk();
     }
-    assert((this->nGenNodes+nAlloc-1)/this->maxNodesPerChunk < this->genNodeChunks.size());
+}
 
-    GenNode<D>* newNode  = this->lastGenNode;
-    GenNode<D>* newNode_cp  = newNode;
+/** Make sure that at least nChunks chunks of ProjectedNodes are allocated. */
+template<int D>
+void SerialFunctionTree<D>::allocChunks(int nChunks) {
+    while (nChunks > this->nodeChunks.size()) {
+        this->sNodes = (ProjectedNode<D>*) new char[this->maxNodesPerChunk*sizeof(ProjectedNode<D>)];
+        this->nodeChunks.push_back(this->sNodes);
+        double *sNodesCoeff = new double[this->sizeNodeCoeff*this->maxNodesPerChunk];
+        this->nodeCoeffChunks.push_back(sNodesCoeff);
+        this->statusChunks.push_back(new unsigned char[this->maxNodesPerChunk]);
+        this->parentIxChunks.push_back(new int[this->maxNodesPerChunk]);
+        this->childIxChunks.push_back(new int[this->maxNodesPerChunk]);
+        this->normChunks.push_back(new double[this->maxNodesPerChunk*getNNormsPerNode()]);
+        this->nodeOccupancy.addChunk();
+    }
+}
 
-    int chunk = this->nGenNodes/this->maxNodesPerChunk;//find the right chunk
-    *coefs_p = this->genNodeCoeffChunks[chunk] + chunkIx*this->sizeGenNodeCoeff;
+/** Free the ProjectedNode chunks beyond the first nKeep and the GenNode
+  * chunks beyond the first nGenKeep, e.g. for an idle tree that is kept for
+  * recycling. Chunks below the top of the stacks are never freed, so this is
+  * most effective right after clear(). */
+template<int D>
+void SerialFunctionTree<D>::releaseChunks(int nKeep, int nGenKeep) {
+    while (this->nodeChunks.size() > std::max(nKeep, getNUsedChunks())) {
+        int last = this->nodeChunks.size() - 1;
+        delete[] (char*)(this->nodeChunks[last]);
+        delete[] this->nodeCoeffChunks[last];
+        delete[] this->statusChunks[last];
+        delete[] this->parentIxChunks[last];
+        delete[] this->childIxChunks[last];
+        delete[] this->normChunks[last];
+        this->nodeChunks.pop_back();
+        this->nodeCoeffChunks.pop_back();
+        this->statusChunks.pop_back();
+        this->parentIxChunks.pop_back();
+        this->childIxChunks.pop_back();
+        this->normChunks.pop_back();
+        this->nodeOccupancy.removeChunk();
+    }
+    while (this->genNodeChunks.size() > std::max(nGenKeep, getNUsedGenChunks())) {
+        int last = this->genNodeChunks.size() - 1;
+        delete[] (char*)(this->genNodeChunks[last]);
+        delete[] this->genNodeCoeffChunks[last];
+        this->genNodeChunks.pop_back();
+        this->genNodeCoeffChunks.pop_back();
+        this->genNodeOccupancy.removeChunk();
+    }
+}
 
-    for (int i = 0; i < nAlloc; i++) {
-        newNode_cp->serialIx = *serialIx+i;//Until overwritten!
-        if (this->genNodeStackStatus[*serialIx+i] != 0)
-	    println(0, *serialIx+i<<" NodeStackStatus: not available " << this->genNodeStackStatus[*serialIx+i]);
-        this->genNodeStackStatus[*serialIx+i] = 1;
-        newNode_cp++;
-    }
-    this->nGenNodes += nAlloc;
-    this->lastGenNode += nAlloc;
-    
-    omp_unset_lock(&Sfunc_tree_lock);
-    return newNode;
+/** Number of ProjectedNode chunks below the top of the node stack. */
+template<int D>
+int SerialFunctionTree<D>::getNUsedChunks() const {
+    return (this->nNodes + this->maxNodesPerChunk - 1)/this->maxNodesPerChunk;
 }
 
+/** Number of GenNode chunks below the top of the GenNode stack. */
 template<int D>
-void SerialFunctionTree<D>::deallocGenNodes(int serialIx) {
-    omp_set_lock(&Sfunc_tree_lock);
-    if (this->nGenNodes <0) {
-        println(0, "minNodes exceeded " << this->nGenNodes);
-        this->nGenNodes++;
-    }
-    this->genNodeStackStatus[serialIx] = 0;//mark as available
-    if (serialIx == this->nGenNodes-1) {//top of stack
-        int topStack = this->nGenNodes;
-        while (this->genNodeStackStatus[topStack-1] == 0) {
-            topStack--;
-            if (topStack < 1) break;
+int SerialFunctionTree<D>::getNUsedGenChunks() const {
+    return (this->nGenNodes + this->maxNodesPerChunk - 1)/this->maxNodesPerChunk;
+}
+
+/** Bytes allocated for the node, metadata and coefficient chunks, whether
+  * occupied or not. */
+template<int D>
+size_t SerialFunctionTree<D>::getMemoryUsage() const {
+    size_t nodeChunk = this->maxNodesPerChunk*(sizeof(ProjectedNode<D>)
+                     + sizeof(unsigned char) + 2*sizeof(int)
+                     + getNNormsPerNode()*sizeof(double)
+                     + this->sizeNodeCoeff*sizeof(double));
+    size_t genChunk = this->maxNodesPerChunk*(sizeof(GenNode<D>)
+                    + this->sizeGenNodeCoeff*sizeof(double));
+    return getNChunks()*nodeChunk + getNGenChunks()*genChunk;
+}
+
+/** Copy the metadata arrays of the first nChunks chunks into the packed
+  * vectors (nodeStatus, nodeParentIx, nodeChildIx, nodeNorms) used for MPI
+  * transfer, tree files and compaction. The packed vectors are a snapshot,
+  * they are not updated when the tree changes. Unoccupied slots get status 0.
+  * GenNodes are not part of the packed data, end nodes are therefore always
+  * stored as leaf nodes. */
+template<int D>
+void SerialFunctionTree<D>::packNodeData(int nChunks) {
+    int nSlots = nChunks*this->maxNodesPerChunk;
+    int nNorms = getNNormsPerNode();
+    this->nodeStatus.assign(nSlots, 0);
+    this->nodeParentIx.assign(nSlots, -1);
+    this->nodeChildIx.assign(nSlots, -1);
+    this->nodeNorms.assign(nSlots*nNorms, 0.0);
+
+    int nCopy = std::min(nChunks, this->getNChunks());
+    for (int chunk = 0; chunk < nCopy; chunk++) {
+        int first = chunk*this->maxNodesPerChunk;
+        int last = first + this->maxNodesPerChunk;
+        for (int sIx = first; sIx < last; sIx++) {
+            if (not this->nodeOccupancy.isOccupied(sIx)) continue;
+            int chunkIx = sIx - first;
+            unsigned char status = this->statusChunks[chunk][chunkIx];
+            int childIx = this->childIxChunks[chunk][chunkIx];
+            if (status & MWNode<D>::FlagEndNode) {
+                //children are GenNodes, if any
+                CLEAR_BITS(status, MWNode<D>::FlagBranchNode);
+            }
+            if (not (status & MWNode<D>::FlagBranchNode)) {
+                childIx = -1;
+            }
+            this->nodeStatus[sIx] = status;
+            this->nodeParentIx[sIx] = this->parentIxChunks[chunk][chunkIx];
+            this->nodeChildIx[sIx] = childIx;
+
+            const double *norms = this->normChunks[chunk] + chunkIx*nNorms;
+            std::copy(norms, norms + nNorms, &this->nodeNorms[sIx*nNorms]);
+        }
+    }
+}
+
+/** Rebuild the ProjectedNode objects of the first nChunks chunks from the
+  * packed vectors. Pointers, NodeIndex and HilbertPath are regenerated from
+  * the serial indices, starting at the root nodes that are located at the
+  * start of the first chunk. All GenNodes are discarded. */
+template<int D>
+void SerialFunctionTree<D>::unpackNodeData(int nChunks) {
+    int nSlots = nChunks*this->maxNodesPerChunk;
+    int nNorms = getNNormsPerNode();
+    if (this->nodeStatus.size() < nSlots) MSG_FATAL("Node data not available");
+    this->allocChunks(nChunks);
+
+    MWTree<D> *tree = this->getTree();
+
+    //reinitialize stacks
+    this->nodeOccupancy.clear();
+    this->genNodeOccupancy.clear();
+    this->nGenNodes = 0;
+    this->resetSlabs(true);
+    for (int i = 0; i < tree->getNThreads(); i++) {
+        tree->nGenNodes[i] = 0;
+    }
+
+    int topStack = 0;
+    for (int sIx = 0; sIx < nSlots; sIx++) {
+        if (this->nodeStatus[sIx] == 0) continue;
+        ProjectedNode<D> *node = &this->nodeChunks[sIx/this->maxNodesPerChunk][sIx%this->maxNodesPerChunk];
+
+        *(char**)(node) = this->cvptr_ProjectedNode;
+
+        node->tree = tree;
+        node->n_coefs = this->sizeNodeCoeff;
+        node->coefs = this->nodeCoeffChunks[sIx/this->maxNodesPerChunk] + (sIx%this->maxNodesPerChunk)*this->sizeNodeCoeff;
+
+        node->serialIx = sIx;
+        node->parentSerialIx = this->nodeParentIx[sIx];
+        node->childSerialIx = this->nodeChildIx[sIx];
+
+        this->attachNode(node, sIx, node->parentSerialIx, node->childSerialIx);
+        *node->status = this->nodeStatus[sIx];
+        const double *norms = &this->nodeNorms[sIx*nNorms];
+        std::copy(norms, norms + nNorms, node->norms);
+
+        //adress of parent and children can be on different chunks
+        int pIx = node->parentSerialIx;
+        if (pIx >= 0) {
+            node->parent = this->nodeChunks[pIx/this->maxNodesPerChunk] + pIx%this->maxNodesPerChunk;
+        } else {
+            node->parent = 0;
+        }
+        for (int i = 0; i < (1<<D); i++) {
+            int cIx = node->childSerialIx + i;
+            if (node->childSerialIx >= 0) {
+                node->children[i] = this->nodeChunks[cIx/this->maxNodesPerChunk] + cIx%this->maxNodesPerChunk;
+            } else {
+                node->children[i] = 0;
+            }
         }
-        this->nGenNodes = topStack;//move top of stack
-        //has to redefine lastGenNode
-        int chunk = this->nGenNodes/this->maxNodesPerChunk;//find the right chunk
-        this->lastGenNode = this->genNodeChunks[chunk] + this->nGenNodes%(this->maxNodesPerChunk);
-    }
-    omp_unset_lock(&Sfunc_tree_lock);
- }
-
-/** Overwrite all pointers defined in the tree.
-  * Necessary after sending the tree 
-  * could be optimized. Should reset other counters? (GenNodes...) */
-template<int D>
-void SerialFunctionTree<D>::rewritePointers(int nChunks){
-  //NOT_IMPLEMENTED_ABORT;
-    
-  int depthMax = 100;
-  MWNode<D>* stack[depthMax*8];
-  int slen = 0, counter = 0;
-
-  this->nGenNodes = 0;
-
-  //reinitialize stacks
-  for (int i = 0; i < this->maxNodes; i++) {
-        this->nodeStackStatus[i] = 0;
-  }
-
-  for (int i = 0; i < this->maxGenNodes; i++) {
-        this->genNodeStackStatus[i] = 0;//0=unoccupied
-  }
-  this->genNodeStackStatus[this->maxGenNodes] = -1;//=unavailable
-
-  this->getTree()->nNodes = 0;
-  this->getTree()->nodesAtDepth.clear();
-  this->getTree()->squareNorm = 0.0;
-
-  for(int ichunk = 0 ; ichunk < nChunks; ichunk++){
-    for(int inode = 0 ; inode < this->maxNodesPerChunk; inode++){
-      ProjectedNode<D>* Node = (this->nodeChunks[ichunk]) + inode;
-      if (Node->serialIx >= 0) {
-	  //Node is part of tree, should be processed
-	  this->getTree()->incrementNodeCount(Node->getScale());
-	  if (Node->isEndNode()) this->getTree()->squareNorm += Node->getSquareNorm();
-	  
-	  //normally (intel) the virtual table does not change, but we overwrite anyway
-	  *(char**)(Node) = this->cvptr_ProjectedNode;
-	  
-	  Node->tree = this->getTree();
-
-	  //"adress" of coefs is the same as node, but in another array
-	  Node->coefs = this->nodeCoeffChunks[ichunk]+ inode*this->sizeNodeCoeff;
-	  
-	  //adress of parent and children must be corrected
-	  //can be on a different chunks
-	  if(Node->parentSerialIx>=0){
-	    int n_ichunk = Node->parentSerialIx/this->maxNodesPerChunk;
-	    int n_inode = Node->parentSerialIx%this->maxNodesPerChunk;
-	    Node->parent = this->nodeChunks[n_ichunk] + n_inode;
-	  }else{Node->parent = 0;}
-	    
-	  for (int i = 0; i < Node->getNChildren(); i++) {
-	    int n_ichunk = (Node->childSerialIx+i)/this->maxNodesPerChunk;
-	    int n_inode = (Node->childSerialIx+i)%this->maxNodesPerChunk;
-	    Node->children[i] = this->nodeChunks[n_ichunk] + n_inode;
-	  }
-	  this->nodeStackStatus[Node->serialIx] = 1;//occupied
 #ifdef OPENMP
-	  omp_init_lock(&(Node->node_lock));
+        omp_init_lock(&(node->node_lock));
 #endif
-	}
+        this->nodeOccupancy.setOccupied(sIx);
+        topStack = sIx + 1;
+    }
+
+    //top of stack is after the last occupied node
+    this->nNodes = topStack;
+    this->resetSlabs(false);
+
+    //update other MWTree data, roots are at start of the first chunk
+    tree->nNodes = 0;
+    tree->nodesAtDepth.clear();
+    tree->clearThreadNodeCounts();
+    tree->squareNorm = 0.0;
+
+    NodeBox<D> &rBox = tree->getRootBox();
+    MWNode<D> **roots = rBox.getNodes();
+    std::vector<MWNode<D> *> stack;
+    for (int rIdx = 0; rIdx < rBox.size(); rIdx++) {
+        roots[rIdx] = this->nodeChunks[0] + rIdx;
+        roots[rIdx]->nodeIndex = rBox.getNodeIndex(rIdx);
+        roots[rIdx]->hilbertPath = HilbertPath<D>();
+        stack.push_back(roots[rIdx]);
+    }
+    while (stack.size() > 0) {
+        MWNode<D> *node = stack.back();
+        stack.pop_back();
+        tree->incrementNodeCount(node->getScale());
+        if (node->isEndNode()) tree->squareNorm += node->getSquareNorm();
+        for (int cIdx = 0; cIdx < node->getNChildren(); cIdx++) {
+            MWNode<D> *child = node->children[cIdx];
+            child->nodeIndex = NodeIndex<D>(node->getNodeIndex(), cIdx);
+            child->hilbertPath = HilbertPath<D>(node->getHilbertPath(), cIdx);
+            stack.push_back(child);
+        }
+    }
+    tree->resetEndNodeTable();
+    if (this->nodeMap != 0) this->rebuildNodeMap();
+}
 
+/** Move all ProjectedNodes to the start of the storage, such that they fill
+  * the minimal number of leading chunks, e.g. before the tree is sent with
+  * MPI. Nodes are renumbered level by level starting with the root nodes,
+  * and the coefficients are moved in place. GenNodes are deleted, and any
+  * node pointers into the tree are invalidated. Chunks that become unused
+  * are kept for later allocations. Returns the number of chunks in use. */
+template<int D>
+int SerialFunctionTree<D>::compact() {
+    MWTree<D> *tree = this->getTree();
+    tree->deleteGenerated();
+
+    int tDim = (1<<D);
+    int nNorms = getNNormsPerNode();
+    int nUsable = tDim*(this->maxNodesPerChunk/tDim);
+    int nChunks = this->nodeChunks.size();
+    int nSlots = nChunks*this->maxNodesPerChunk;
+    this->packNodeData(nChunks);
+
+    //new serialIx of each node, -1 for unoccupied slots
+    std::vector<int> newIx(nSlots, -1);
+    std::vector<int> queue;
+    int nRoots = tree->getRootBox().size();
+    for (int rIdx = 0; rIdx < nRoots; rIdx++) {
+        int sIx = tree->getRootMWNode(rIdx).serialIx;
+        newIx[sIx] = rIdx;
+        queue.push_back(sIx);
+    }
+    int topStack = tDim*((nRoots + tDim - 1)/tDim);
+    for (int q = 0; q < queue.size(); q++) {
+        int cIx = this->nodeChildIx[queue[q]];
+        if (cIx < 0) continue;
+        if (topStack%this->maxNodesPerChunk + tDim > nUsable) {
+            //sibling groups do not cross chunk boundaries
+            topStack = this->maxNodesPerChunk*(topStack/this->maxNodesPerChunk + 1);
+        }
+        for (int i = 0; i < tDim; i++) {
+            newIx[cIx + i] = topStack + i;
+            queue.push_back(cIx + i);
+        }
+        topStack += tDim;
+    }
+    int nNewChunks = (topStack + this->maxNodesPerChunk - 1)/this->maxNodesPerChunk;
+    int nNewSlots = nNewChunks*this->maxNodesPerChunk;
+
+    //move coefficients, following chains of displaced nodes
+    std::vector<bool> moved(nSlots, false);
+    std::vector<double> buf(this->sizeNodeCoeff);
+    for (int sIx = 0; sIx < nSlots; sIx++) {
+        if (newIx[sIx] < 0 or moved[sIx]) continue;
+        moved[sIx] = true;
+        if (newIx[sIx] == sIx) continue;
+        double *coefs_p = this->nodeCoeffChunks[sIx/this->maxNodesPerChunk] + (sIx%this->maxNodesPerChunk)*this->sizeNodeCoeff;
+        std::copy(coefs_p, coefs_p + this->sizeNodeCoeff, buf.begin());
+        int dst = newIx[sIx];
+        while (true) {
+            coefs_p = this->nodeCoeffChunks[dst/this->maxNodesPerChunk] + (dst%this->maxNodesPerChunk)*this->sizeNodeCoeff;
+            if (newIx[dst] < 0 or moved[dst]) {
+                std::copy(buf.begin(), buf.end(), coefs_p);
+                break;
+            }
+            //the slot is still occupied, carry its coefs to the next slot
+            std::swap_ranges(buf.begin(), buf.end(), coefs_p);
+            moved[dst] = true;
+            dst = newIx[dst];
+        }
     }
-  }
 
-  //update other MWTree data
-  FunctionTree<D>* Tree = static_cast<FunctionTree<D>*> (this->tree_p);
+    //renumber the node metadata
+    std::vector<unsigned char> status(nNewSlots, 0);
+    std::vector<int> parentIx(nNewSlots, -1);
+    std::vector<int> childIx(nNewSlots, -1);
+    std::vector<double> norms(nNewSlots*nNorms, 0.0);
+    for (int sIx = 0; sIx < nSlots; sIx++) {
+        int n = newIx[sIx];
+        if (n < 0) continue;
+        int pIx = this->nodeParentIx[sIx];
+        int cIx = this->nodeChildIx[sIx];
+        status[n] = this->nodeStatus[sIx];
+        parentIx[n] = (pIx < 0) ? -1 : newIx[pIx];
+        childIx[n] = (cIx < 0) ? -1 : newIx[cIx];
+        for (int i = 0; i < nNorms; i++) {
+            norms[n*nNorms + i] = this->nodeNorms[sIx*nNorms + i];
+        }
+    }
+    this->nodeStatus.swap(status);
+    this->nodeParentIx.swap(parentIx);
+    this->nodeChildIx.swap(childIx);
+    this->nodeNorms.swap(norms);
 
-  NodeBox<D> &rBox = Tree->getRootBox();
-  MWNode<D> **roots = rBox.getNodes();
+    double sqNorm = tree->squareNorm;
+    this->unpackNodeData(nNewChunks);
+    tree->squareNorm = sqNorm;
 
-  for (int rIdx = 0; rIdx < rBox.size(); rIdx++) {
-    roots[rIdx] = (this->nodeChunks[0]) + rIdx;//adress of roots are at start of NodeChunks[0] array
-  }
+    return nNewChunks;
+}
 
-  this->getTree()->resetEndNodeTable();
+/** Serial indices of the ProjectedNodes in the order of a HilbertIterator
+  * over the tree, GenNodes disregarded. Only the status and child index
+  * arrays are read, the node objects are not visited (except the roots, for
+  * their serialIx and HilbertPath). The depth of each node is returned in
+  * depth, if given. */
+template<int D>
+void SerialFunctionTree<D>::getHilbertOrder(std::vector<int> &serialIx, std::vector<int> *depth) const {
+    struct StackEntry {
+        StackEntry(int ix, int d, const HilbertPath<D> &p) : sIx(ix), depth(d), path(p) { }
+        int sIx;
+        int depth;
+        HilbertPath<D> path;
+    };
+    int tDim = (1<<D);
+    const NodeBox<D> &rBox = this->tree_p->getRootBox();
+
+    std::vector<StackEntry> stack;
+    for (int rIdx = rBox.size() - 1; rIdx >= 0; rIdx--) {
+        const MWNode<D> &root = rBox.getNode(rIdx);
+        stack.push_back(StackEntry(root.getSerialIx(), 0, root.getHilbertPath()));
+    }
+    while (stack.size() > 0) {
+        StackEntry node = stack.back();
+        stack.pop_back();
+        serialIx.push_back(node.sIx);
+        if (depth != 0) depth->push_back(node.depth);
+
+        unsigned char status = getNodeStatus(node.sIx);
+        if (status & MWNode<D>::FlagEndNode) continue;//children are GenNodes, if any
+        if (not (status & MWNode<D>::FlagBranchNode)) continue;
+        int cIx = getChildIx(node.sIx);
+        //last child first, such that the children are visited in Hilbert order
+        for (int i = tDim - 1; i >= 0; i--) {
+            int cIdx = node.path.getZIndex(i);
+            stack.push_back(StackEntry(cIx + cIdx, node.depth + 1, HilbertPath<D>(node.path, cIdx)));
+        }
+    }
+}
 
+/** Node table of the whole tree, found from the metadata arrays. */
+template<int D>
+bool SerialFunctionTree<D>::makeNodeTable(MWNodeVector &nodeTable) {
+    std::vector<int> serialIx;
+    getHilbertOrder(serialIx);
+    for (int n = 0; n < serialIx.size(); n++) {
+        nodeTable.push_back(getNode(serialIx[n]));
+    }
+    return true;
+}
 
+/** Node table with one vector per depth, found from the metadata arrays. */
+template<int D>
+bool SerialFunctionTree<D>::makeNodeTable(std::vector<MWNodeVector > &nodeTable) {
+    std::vector<int> serialIx;
+    std::vector<int> depth;
+    getHilbertOrder(serialIx, &depth);
+    for (int n = 0; n < serialIx.size(); n++) {
+        if (depth[n] + 1 > nodeTable.size()) {
+            nodeTable.resize(depth[n] + 1);
+        }
+        nodeTable[depth[n]].push_back(getNode(serialIx[n]));
+    }
+    return true;
+}
+
+/** End node table, found from the metadata arrays. */
+template<int D>
+bool SerialFunctionTree<D>::makeEndNodeTable(MWNodeVector &endNodeTable) {
+    std::vector<int> serialIx;
+    getHilbertOrder(serialIx);
+    for (int n = 0; n < serialIx.size(); n++) {
+        if (getNodeStatus(serialIx[n]) & MWNode<D>::FlagEndNode) {
+            endNodeTable.push_back(getNode(serialIx[n]));
+        }
+    }
+    return true;
 }
 
+/** Index all ProjectedNodes of the tree by NodeIndex, such that
+  * MWTree::findNode and MWTree::getNode do not need to walk the tree
+  * from the root. The map is off by default, since keeping it up to date
+  * costs a locked insert for every allocated node. Enable it only for trees
+  * that are looked up many times, e.g. the input of a convolution.
+  * Note that lookups are not safe while other threads allocate nodes. */
+template<int D>
+void SerialFunctionTree<D>::enableNodeMap() {
+    if (this->nodeMap == 0) this->nodeMap = new typename SerialTree<D>::NodeMap;
+    this->rebuildNodeMap();
+}
+
+template<int D>
+void SerialFunctionTree<D>::disableNodeMap() {
+    if (this->nodeMap != 0) delete this->nodeMap;
+    this->nodeMap = 0;
+}
+
+/** Fill the node map by traversing the tree, GenNodes are not included. */
+template<int D>
+void SerialFunctionTree<D>::rebuildNodeMap() {
+    MWTree<D> *tree = this->getTree();
+    this->nodeMap->clear();
+    this->nodeMap->reserve(tree->getNNodes());
+
+    std::vector<MWNode<D> *> stack;
+    for (int rIdx = 0; rIdx < tree->getRootBox().size(); rIdx++) {
+        stack.push_back(&tree->getRootMWNode(rIdx));
+    }
+    while (stack.size() > 0) {
+        MWNode<D> *node = stack.back();
+        stack.pop_back();
+        (*this->nodeMap)[node->getNodeIndex()] = node;
+        if (node->isEndNode()) continue;//children are GenNodes, if any
+        for (int cIdx = 0; cIdx < node->getNChildren(); cIdx++) {
+            stack.push_back(node->children[cIdx]);
+        }
+    }
+}
 
 template class SerialFunctionTree<1>;
 template class SerialFunctionTree<2>;
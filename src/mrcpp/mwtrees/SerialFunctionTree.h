@@ -13,6 +13,8 @@
 #include <vector>
 
 #include "SerialTree.h"
+#include "ChunkTable.h"
+#include "NodeOccupancy.h"
 #include "parallel.h"
 
 template<int D> class FunctionTree;
@@ -25,6 +27,9 @@ public:
     SerialFunctionTree(FunctionTree<D> *tree, int max_nodes);
     virtual ~SerialFunctionTree();
 
+    /** Node allocation is locked, or done from per-thread slabs */
+    virtual bool isThreadSafe() const { return true; }
+
     virtual void allocRoots(MWTree<D> &tree);
     virtual void allocChildren(MWNode<D> &parent);
     virtual void allocGenChildren(MWNode<D> &parent);
@@ -32,36 +37,104 @@ public:
     virtual void deallocNodes(int serialIx);
     virtual void deallocGenNodes(int serialIx);
 
-    std::vector<ProjectedNode<D>*> nodeChunks;
-    std::vector<double*> nodeCoeffChunks;
+    ChunkTable<ProjectedNode<D>*> nodeChunks;
+    ChunkTable<double*> nodeCoeffChunks;
 
     ProjectedNode<D> *sNodes;   //serial ProjectedNodes
     GenNode<D> *sGenNodes;      //serial GenNodes
 
-    std::vector<GenNode<D>*> genNodeChunks;
-    std::vector<double*> genNodeCoeffChunks;
+    ChunkTable<GenNode<D>*> genNodeChunks;
+    ChunkTable<double*> genNodeCoeffChunks;
 
     int nGenNodes;              //number of GenNodes already defined
 
     double **genCoeffStack;
 
-    int *genNodeStackStatus;
-
-    void rewritePointers(int nChunks);
+    NodeOccupancy nodeOccupancy;    //occupied ProjectedNode slots
+    NodeOccupancy genNodeOccupancy; //occupied GenNode slots
+
+    //Metadata of the ProjectedNodes, one array per node chunk. The nodes keep
+    //their status and norms here, and the tree structure can be traversed
+    //through these arrays without touching the node objects.
+    ChunkTable<unsigned char*> statusChunks;    //status flags
+    ChunkTable<int*> parentIxChunks;            //serialIx of parent, -1 for roots
+    ChunkTable<int*> childIxChunks;             //serialIx of first child, valid for branch nodes that are not end nodes
+    ChunkTable<double*> normChunks;             //squareNorm followed by the 2^D componentNorms
+
+    bool isEndNode(int sIx) const { return (getNodeStatus(sIx) & MWNode<D>::FlagEndNode); }
+    unsigned char getNodeStatus(int sIx) const { return this->statusChunks[sIx/this->maxNodesPerChunk][sIx%this->maxNodesPerChunk]; }
+    int getParentIx(int sIx) const { return this->parentIxChunks[sIx/this->maxNodesPerChunk][sIx%this->maxNodesPerChunk]; }
+    int getChildIx(int sIx) const { return this->childIxChunks[sIx/this->maxNodesPerChunk][sIx%this->maxNodesPerChunk]; }
+    const double *getNodeNorms(int sIx) const { return this->normChunks[sIx/this->maxNodesPerChunk] + (sIx%this->maxNodesPerChunk)*getNNormsPerNode(); }
+    const double *getNodeCoefs(int sIx) const { return this->nodeCoeffChunks[sIx/this->maxNodesPerChunk] + (sIx%this->maxNodesPerChunk)*this->sizeNodeCoeff; }
+    ProjectedNode<D> *getNode(int sIx) { return this->nodeChunks[sIx/this->maxNodesPerChunk] + sIx%this->maxNodesPerChunk; }
+
+    //Packed copy of the metadata arrays of the leading chunks, filled by
+    //packNodeData for MPI transfer, tree files and compaction.
+    std::vector<unsigned char> nodeStatus;  //status flags, 0 for unoccupied slots
+    std::vector<int> nodeParentIx;          //serialIx of parent, -1 for roots
+    std::vector<int> nodeChildIx;           //serialIx of first child, -1 for end nodes
+    std::vector<double> nodeNorms;          //squareNorm followed by the 2^D componentNorms
+
+    int getNNormsPerNode() const { return (1<<D) + 1; }
+
+    void clear();
+    int compact();
+
+    void allocChunks(int nChunks);
+    void releaseChunks(int nKeep, int nGenKeep);
+    int getNChunks() const { return this->nodeChunks.size(); }
+    int getNGenChunks() const { return this->genNodeChunks.size(); }
+    int getNUsedChunks() const;
+    int getNUsedGenChunks() const;
+    size_t getMemoryUsage() const;
+    void packNodeData(int nChunks);
+    void unpackNodeData(int nChunks);
+
+    void getHilbertOrder(std::vector<int> &serialIx, std::vector<int> *depth = 0) const;
+    virtual bool makeNodeTable(MWNodeVector &nodeTable);
+    virtual bool makeNodeTable(std::vector<MWNodeVector > &nodeTable);
+    virtual bool makeEndNodeTable(MWNodeVector &endNodeTable);
+
+    void enableNodeMap();
+    void disableNodeMap();
 
 protected:
-    int maxGenNodes;            //max number of Gen nodes that can be defined
+    /** Range of serial indices reserved by one thread. Nodes are taken
+      * from the slab without locking, and released sibling groups are
+      * kept in a thread private free-list for reuse. */
+    struct NodeSlab {
+        int next;                       //next unused serialIx in the slab
+        int end;                        //end of the slab
+        std::vector<int> freeGroups;    //first serialIx of released sibling groups
+    };
+
     int sizeGenNodeCoeff;       //size of coeff for one Gen node
+    int slabSize;               //number of nodes reserved by a thread at once
 
     char *cvptr_ProjectedNode;  //virtual table pointer for ProjectedNode
     char *cvptr_GenNode;        //virtual table pointer for GenNode
 
-    ProjectedNode<D>* lastNode; //pointer to the last active node
-    GenNode<D>* lastGenNode;    //pointer to the last active Gen node
+    std::vector<NodeSlab> nodeSlabs;        //one per thread
+    std::vector<NodeSlab> genNodeSlabs;     //one per thread
+    std::vector<int> freeNodeGroups;        //shared free-list, protected by lock
+    std::vector<int> freeGenNodeGroups;     //shared free-list, protected by lock
 
     ProjectedNode<D>* allocNodes(int nAlloc, int* serialIx, double **coefs_p);
+    void attachNode(ProjectedNode<D> *node, int serialIx, int parentIx, int childIx);
+    void setChildIx(int serialIx, int childIx) { this->childIxChunks[serialIx/this->maxNodesPerChunk][serialIx%this->maxNodesPerChunk] = childIx; }
     GenNode<D>* allocGenNodes(int nAlloc, int* serialIx, double **coefs_p);
 
+    int allocSerialIx(int nAlloc, bool genNodes);
+    void freeSerialIx(int serialIx, bool genNodes);
+    int reserveSlab(int nAlloc, int *slabEnd, bool genNodes);
+    void resetSlabs(bool genNodes);
+    void allocGenChunks(int nChunks);
+    void rebuildNodeMap();
+
+    static char *getProjectedNodeVptr();
+    static char *getGenNodeVptr();
+
 private:
 #ifdef HAVE_OPENMP
     omp_lock_t Sfunc_tree_lock;
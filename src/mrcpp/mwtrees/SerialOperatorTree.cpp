@@ -95,7 +95,8 @@ void SerialOperatorTree::allocRoots(MWTree<2> &tree) {
         root_p->parentSerialIx = -1;//to indicate rootnode
         root_p->childSerialIx = -1;
 
-        root_p->status = 0;
+        root_p->attachMetadata();
+        *root_p->status = 0;
 
         root_p->clearNorms();
         root_p->setIsLeafNode();
@@ -147,7 +148,8 @@ void SerialOperatorTree::allocChildren(MWNode<2> &parent) {
         child_p->parentSerialIx = parent.serialIx;
         child_p->childSerialIx = -1;
 
-        child_p->status = 0;
+        child_p->attachMetadata();
+        *child_p->status = 0;
 
         child_p->clearNorms();
         child_p->setIsLeafNode();
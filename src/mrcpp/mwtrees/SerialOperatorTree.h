@@ -36,6 +36,8 @@ protected:
     std::vector<OperatorNode*> nodeChunks;
     std::vector<double*> nodeCoeffChunks;
 
+    int *nodeStackStatus;       //0 for unoccupied, 1 for occupied slots
+
     char *cvptr_OperatorNode;   //virtual table pointer for OperatorNode
     OperatorNode* lastNode;     //pointer to the last active node
 
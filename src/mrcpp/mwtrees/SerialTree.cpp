@@ -24,12 +24,22 @@ void SerialTree<D>::S_mwTransform(double* coeff_in, double* coeff_out, bool read
     int kp1_dm1 = MathUtils::ipow(kp1, D - 1);
     const MWFilter &filter = this->getTree()->getMRA().getFilter();
     double overwrite = 0.0;
+
+    if (D == 3) {
+        const MatrixXd &filters = filter.getPackedSubFilters(operation);
+        if (not b_overwrite) overwrite = 1.0;
+        MathUtils::mwTransform3D(coeff_out, stride, coeff_in, kp1_d,
+                                 filters, kp1, readOnlyScaling, overwrite);
+        return;
+    }
+
     double *tmp;
     double tmpcoeff[kp1_d*tDim];
     double tmpcoeff2[kp1_d*tDim];
     int ftlim=tDim;
     int ftlim2=tDim;
     int ftlim3=tDim;
+
     if(readOnlyScaling){
         ftlim=1;
         ftlim2=2;
@@ -142,74 +152,10 @@ void SerialTree<3>::S_mwTransformBack(double* coeff_in, double* coeff_out, int s
   int operation = Compression;
   int kp1 = this->getTree()->getKp1();
   int kp1_d = this->getTree()->getKp1_d();
-  int tDim = 8;
-  int kp1_dm1 = MathUtils::ipow(kp1, 2);
   const MWFilter &filter = this->getTree()->getMRA().getFilter();
-  double overwrite = 0.0;
-  double tmpcoeff[kp1_d*tDim];
-
-  int ftlim = tDim;
-  int ftlim2 = tDim;
-  int ftlim3 = tDim;
-
-  int i = 0;
-  int mask = 1;
-  for (int gt = 0; gt < tDim; gt++) {
-        double *out = coeff_out + gt * kp1_d;
-        for (int ft = 0; ft < ftlim; ft++) {
-            // Operate in direction i only if the bits along other
-            // directions are identical. The bit of the direction we
-            // operate on determines the appropriate filter/operator
-            if ((gt | mask) == (ft | mask)) {
-	        double *in = coeff_in + ft * stride;
-	        int filter_index = 2 * ((gt >> i) & 1) + ((ft >> i) & 1);
-	        const MatrixXd &oper = filter.getSubFilter(filter_index, operation);
-
-	        MathUtils::applyFilter(out, in, oper, kp1, kp1_dm1, overwrite);
-	        overwrite = 1.0;
-            }
-        }
-        overwrite = 0.0;
-    }
-    i++;
-    mask = 2;//1 << i;
-    for (int gt = 0; gt < tDim; gt++) {
-        double *out = tmpcoeff + gt * kp1_d;
-        for (int ft = 0; ft < ftlim2; ft++) {
-            // Operate in direction i only if the bits along other
-            // directions are identical. The bit of the direction we
-            // operate on determines the appropriate filter/operator
-            if ((gt | mask) == (ft | mask)) {
-	        double *in = coeff_out + ft * kp1_d;
-	        int filter_index = 2 * ((gt >> i) & 1) + ((ft >> i) & 1);
-	        const MatrixXd &oper = filter.getSubFilter(filter_index, operation);
-
-	        MathUtils::applyFilter(out, in, oper, kp1, kp1_dm1, overwrite);
-	        overwrite = 1.0;
-            }
-        }
-        overwrite = 0.0;
-    }
-    i++;
-    mask = 4;//1 << i;
-    for (int gt = 0; gt < tDim; gt++) {
-        double *out = coeff_out + gt * kp1_d;
-        //double *out = coeff_out + gt * N_coeff;
-        for (int ft = 0; ft < ftlim3; ft++) {
-            // Operate in direction i only if the bits along other
-            // directions are identical. The bit of the direction we
-            // operate on determines the appropriate filter/operator
-            if ((gt | mask) == (ft | mask)) {
-	        double *in = tmpcoeff + ft * kp1_d;
-	        int filter_index = 2 * ((gt >> i) & 1) + ((ft >> i) & 1);
-	        const MatrixXd &oper = filter.getSubFilter(filter_index, operation);
-
-	        MathUtils::applyFilter(out, in, oper, kp1, kp1_dm1, overwrite);
-	        overwrite = 1.0;
-            }
-        }
-        overwrite = 0.0;
-    }
+  const MatrixXd &filters = filter.getPackedSubFilters(operation);
+  MathUtils::mwTransform3D(coeff_out, kp1_d, coeff_in, stride,
+                           filters, kp1, false, 0.0);
 }
 
 template class SerialTree<1>;
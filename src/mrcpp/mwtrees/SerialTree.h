@@ -10,17 +10,38 @@
 #ifndef SERIALTREE_H_
 #define SERIALTREE_H_
 
+#include <unordered_map>
+#include <vector>
+
+#include "NodeIndex.h"
+#include "mrcpp_declarations.h"
+
 template<int D> class MWTree;
 template<int D> class MWNode;
 
 template<int D>
 class SerialTree {
 public:
-    SerialTree(MWTree<D> *tree) : tree_p(tree) { }
-    virtual ~SerialTree() { }
+    typedef std::unordered_map<NodeIndex<D>, MWNode<D> *, NodeIndexHash<D> > NodeMap;
+
+    SerialTree(MWTree<D> *tree) : tree_p(tree), nodeMap(0) { }
+    virtual ~SerialTree() { if (this->nodeMap != 0) delete this->nodeMap; }
 
     MWTree<D>* getTree() { return this->tree_p; }
 
+    /** Constant time lookup of allocated (non-Gen) nodes, only available
+      * if the serial tree keeps a NodeIndex map. Returns NULL if the node
+      * does not exist. */
+    bool hasNodeMap() const { return (this->nodeMap != 0); }
+    MWNode<D> *lookupNode(const NodeIndex<D> &idx) const {
+        typename NodeMap::const_iterator it = this->nodeMap->find(idx);
+        if (it == this->nodeMap->end()) return 0;
+        return it->second;
+    }
+
+    /** Whether allocChildren can be called concurrently by several threads */
+    virtual bool isThreadSafe() const { return false; }
+
     virtual void allocRoots(MWTree<D> &tree) = 0;
     virtual void allocChildren(MWNode<D> &parent) = 0;
     virtual void allocGenChildren(MWNode<D> &parent) = 0;
@@ -28,12 +49,18 @@ public:
     virtual void deallocNodes(int serialIx) = 0;
     virtual void deallocGenNodes(int serialIx) = 0;
 
+    /** Node tables in the order of a HilbertIterator (GenNodes disregarded),
+      * if the serial tree can find them without visiting the nodes. Returns
+      * false if the tree must be traversed by the caller. */
+    virtual bool makeNodeTable(MWNodeVector &nodeTable) { return false; }
+    virtual bool makeNodeTable(std::vector<MWNodeVector > &nodeTable) { return false; }
+    virtual bool makeEndNodeTable(MWNodeVector &endNodeTable) { return false; }
+
     void S_mwTransform(double* coeff_in, double* coeff_out, bool readOnlyScaling, int stride, bool overwrite = true);
     void S_mwTransformBack(double* coeff_in, double* coeff_out, int stride);
 
     int nNodes;                 //number of Nodes already defined
     int maxNodesPerChunk;
-    int *nodeStackStatus;
     int sizeNodeCoeff;          //size of coeff for one node
     double **coeffStack;
 
@@ -41,6 +68,7 @@ protected:
     int maxNodes;               //max number of nodes that can be defined
 
     MWTree<D> *tree_p;
+    NodeMap *nodeMap;           //optional map from NodeIndex to node
 };
 
 #endif /* SERIALTREE_H_*/
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include "parallel.h"
 #include "TelePrompter.h"
 #include "Timer.h"
@@ -29,27 +30,46 @@ void MPI_Initializations(){
 }
 
 #ifdef HAVE_MPI
+/** Number of node slots of a chunk that are below the top of the stack.
+ * Only this part of the coefficients is sent, the receiver always posts a
+ * full chunk, which is an upper bound for the message size.
+ */
+template<int D>
+int getNSlotsInUse(SerialFunctionTree<D>* STree, int ichunk){
+  int nSlots = STree->nNodes - ichunk*STree->maxNodesPerChunk;
+  return std::max(0, std::min(nSlots, STree->maxNodesPerChunk));
+}
+
+/** Send a serial tree using MPI.
+ * The node metadata is packed into separate arrays (status, parent, child,
+ * norms) and sent before the coefficient chunks. The node objects themselves
+ * are rebuilt by the receiver. The four metadata arrays use the tags tag to
+ * tag+3, and all coefficient chunks are sent in order with tag+4, such that
+ * a tree occupies SerialTreeTags tags whatever its number of chunks.
+ *
+ * Only the first Nchunks chunks are sent. The callers compact the source
+ * tree in place with SerialFunctionTree::compact() first, which is intended:
+ * it avoids a scratch copy of the coefficients, and the function is
+ * unchanged, but node pointers and node tables of the source tree are
+ * invalid afterwards.
+ */
 template<int D>
 void Send_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_Comm comm){
-  MPI_Status status;
   Timer timer;
   SerialFunctionTree<D>* STree = Tree->getSerialFunctionTree();
   
   println(10," STree  at "<<STree<<" number of nodes = "<<STree->nNodes<<" sending to "<<dest);
-  int count = 1;
-  int STreeMeta[count];
   
   timer.start();
+  STree->packNodeData(Nchunks);
+  int count = Nchunks*STree->maxNodesPerChunk;
+  MPI_Send(STree->nodeStatus.data(), count, MPI_UNSIGNED_CHAR, dest, tag, comm);
+  MPI_Send(STree->nodeParentIx.data(), count, MPI_INT, dest, tag+1, comm);
+  MPI_Send(STree->nodeChildIx.data(), count, MPI_INT, dest, tag+2, comm);
+  MPI_Send(STree->nodeNorms.data(), count*STree->getNNormsPerNode(), MPI_DOUBLE, dest, tag+3, comm);
   for(int ichunk = 0 ; ichunk <Nchunks ; ichunk++){
-    count=STree->maxNodesPerChunk*sizeof(ProjectedNode<D>);
-    //set serialIx of the unused nodes to -1
-    int ishift = ichunk*STree->maxNodesPerChunk;
-    for (int i = 0; i < STree->maxNodesPerChunk; i++){
-      if(STree->nodeStackStatus[ishift+i]!=1)(STree->nodeChunks[ichunk])[i].setSerialIx(-1);
-    }
-    MPI_Send(STree->nodeChunks[ichunk], count, MPI_BYTE, dest, tag+1+ichunk, comm);
-    count=STree->sizeNodeCoeff*STree->maxNodesPerChunk;
-    MPI_Send(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, dest, tag+ichunk*1000, comm);
+    count=STree->sizeNodeCoeff*getNSlotsInUse(STree, ichunk);
+    MPI_Send(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, dest, tag+4, comm);
   }
   
   timer.stop();
@@ -58,28 +78,31 @@ void Send_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_
 #endif
 
 #ifdef HAVE_MPI
+/** Send a serial tree using non-blocking MPI calls.
+ * The sends are posted directly from the packed node data and the
+ * coefficient chunks of the tree, with the same tags as Send_SerialTree,
+ * and the requests are appended to requests. The tree must not be modified
+ * or deleted before all requests are completed with MPI_Waitall.
+ */
 template<int D>
-void ISend_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_Comm comm){
-  MPI_Status status;
+void ISend_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_Comm comm, std::vector<MPI_Request> &requests){
   Timer timer;
   SerialFunctionTree<D>* STree = Tree->getSerialFunctionTree();
   
   println(10,MPI_rank<<" STree  at "<<STree<<" number of nodes = "<<STree->nNodes<<" sending to "<<dest);
-  int count = 1;
-  int STreeMeta[count];
-  MPI_Request request;
+  int first = requests.size();
+  requests.resize(first + Nchunks + 4);
 
   timer.start();
+  STree->packNodeData(Nchunks);
+  int count = Nchunks*STree->maxNodesPerChunk;
+  MPI_Isend(STree->nodeStatus.data(), count, MPI_UNSIGNED_CHAR, dest, tag, comm, &requests[first]);
+  MPI_Isend(STree->nodeParentIx.data(), count, MPI_INT, dest, tag+1, comm, &requests[first+1]);
+  MPI_Isend(STree->nodeChildIx.data(), count, MPI_INT, dest, tag+2, comm, &requests[first+2]);
+  MPI_Isend(STree->nodeNorms.data(), count*STree->getNNormsPerNode(), MPI_DOUBLE, dest, tag+3, comm, &requests[first+3]);
   for(int ichunk = 0 ; ichunk <Nchunks ; ichunk++){
-    count=STree->maxNodesPerChunk*sizeof(ProjectedNode<D>);
-    //set serialIx of the unused nodes to -1
-    int ishift = ichunk*STree->maxNodesPerChunk;
-    for (int i = 0; i < STree->maxNodesPerChunk; i++){
-      if(STree->nodeStackStatus[ishift+i]!=1)(STree->nodeChunks[ichunk])[i].setSerialIx(-1);
-    }
-    MPI_Isend(STree->nodeChunks[ichunk], count, MPI_BYTE, dest, tag+1+ichunk, comm,&request);
-    count=STree->sizeNodeCoeff*STree->maxNodesPerChunk;
-    MPI_Isend(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, dest, tag+ichunk*1000, comm,&request);
+    count=STree->sizeNodeCoeff*getNSlotsInUse(STree, ichunk);
+    MPI_Isend(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, dest, tag+4, comm, &requests[first+4+ichunk]);
   }
   timer.stop();
   println(10, " time send     " << timer); 
@@ -95,77 +118,73 @@ void Rcv_SerialTree(FunctionTree<D>* Tree, int Nchunks, int source, int tag, MPI
   
 
   println(10, MPI_rank<<" STree  at "<<STree<<" number of nodes = "<<STree->nNodes<<" receiving from "<<source);
-  int count = 1;
-  int STreeMeta[count];
 
     timer.start();
+    STree->allocChunks(Nchunks);
+    int count = Nchunks*STree->maxNodesPerChunk;
+    STree->nodeStatus.resize(count);
+    STree->nodeParentIx.resize(count);
+    STree->nodeChildIx.resize(count);
+    STree->nodeNorms.resize(count*STree->getNNormsPerNode());
+    MPI_Recv(STree->nodeStatus.data(), count, MPI_UNSIGNED_CHAR, source, tag, comm, &status);
+    MPI_Recv(STree->nodeParentIx.data(), count, MPI_INT, source, tag+1, comm, &status);
+    MPI_Recv(STree->nodeChildIx.data(), count, MPI_INT, source, tag+2, comm, &status);
+    MPI_Recv(STree->nodeNorms.data(), count*STree->getNNormsPerNode(), MPI_DOUBLE, source, tag+3, comm, &status);
+    println(10, MPI_rank<<" received metadata for "<<count<<" nodes from "<<source);
     for(int ichunk = 0 ; ichunk <Nchunks ; ichunk++){
-      if(ichunk<STree->nodeChunks.size()){
-	STree->sNodesCoeff = STree->nodeCoeffChunks[ichunk];
-	STree->sNodes = STree->nodeChunks[ichunk];
-      }else{
-        STree->sNodesCoeff = new double[STree->sizeNodeCoeff*STree->maxNodesPerChunk];
-        STree->nodeCoeffChunks.push_back(STree->sNodesCoeff);
-	STree->sNodes = (ProjectedNode<D>*) new char[STree->maxNodesPerChunk*sizeof(ProjectedNode<D>)];
-	STree->nodeChunks.push_back(STree->sNodes);
-      }      
-      count=STree->maxNodesPerChunk*sizeof(ProjectedNode<D>);
-      MPI_Recv(STree->nodeChunks[ichunk], count, MPI_BYTE, source, tag+1+ichunk, comm, &status);
-      println(10, MPI_rank<<" received  "<<count/1024<<" kB with ProjectedNodes from "<<source);
       count=STree->sizeNodeCoeff*STree->maxNodesPerChunk;
-      MPI_Recv(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, source, tag+ichunk*1000, comm, &status);
+      MPI_Recv(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, source, tag+4, comm, &status);
       println(10, " received  "<<count<<" coefficients from "<<source);
     }
     timer.stop();
     println(10, " time receive  " << timer);
     timer.start();
-    STree->rewritePointers(Nchunks);
+    STree->unpackNodeData(Nchunks);
     timer.stop();
-	    println(10, " time rewrite pointers  " << timer);
+    println(10, " time rebuild nodes  " << timer);
 
 }
 #endif
 
 #ifdef HAVE_MPI
+/** Receive a serial tree using non-blocking MPI calls.
+ * The nodes can only be rebuilt once the metadata has arrived, and the tree
+ * is not usable before the coefficients are in place, so all requests are
+ * completed before returning.
+ */
 template<int D>
 void IRcv_SerialTree(FunctionTree<D>* Tree, int Nchunks, int source, int tag, MPI_Comm comm){
-  MPI_Status status;
   Timer timer;
   SerialFunctionTree<D>* STree = Tree->getSerialFunctionTree();
   
 
   println(10, MPI_rank<<" STree  at "<<STree<<" number of nodes = "<<STree->nNodes<<" receiving from "<<source);
-  int count = 1;
-  int STreeMeta[count];
 
-  MPI_Request request;
+  std::vector<MPI_Request> requests(Nchunks + 4);
 
     timer.start();
+    STree->allocChunks(Nchunks);
+    int count = Nchunks*STree->maxNodesPerChunk;
+    STree->nodeStatus.resize(count);
+    STree->nodeParentIx.resize(count);
+    STree->nodeChildIx.resize(count);
+    STree->nodeNorms.resize(count*STree->getNNormsPerNode());
+    MPI_Irecv(STree->nodeStatus.data(), count, MPI_UNSIGNED_CHAR, source, tag, comm, &requests[0]);
+    MPI_Irecv(STree->nodeParentIx.data(), count, MPI_INT, source, tag+1, comm, &requests[1]);
+    MPI_Irecv(STree->nodeChildIx.data(), count, MPI_INT, source, tag+2, comm, &requests[2]);
+    MPI_Irecv(STree->nodeNorms.data(), count*STree->getNNormsPerNode(), MPI_DOUBLE, source, tag+3, comm, &requests[3]);
     for(int ichunk = 0 ; ichunk <Nchunks ; ichunk++){
-      if(ichunk<STree->nodeChunks.size()){
-	STree->sNodesCoeff = STree->nodeCoeffChunks[ichunk];
-	STree->sNodes = STree->nodeChunks[ichunk];
-      }else{
-        STree->sNodesCoeff = new double[STree->sizeNodeCoeff*STree->maxNodesPerChunk];
-        STree->nodeCoeffChunks.push_back(STree->sNodesCoeff);
-	STree->sNodes = (ProjectedNode<D>*) new char[STree->maxNodesPerChunk*sizeof(ProjectedNode<D>)];
-	STree->nodeChunks.push_back(STree->sNodes);
-      }      
-      count=STree->maxNodesPerChunk*sizeof(ProjectedNode<D>);
-      MPI_Irecv(STree->nodeChunks[ichunk], count, MPI_BYTE, source, tag+1+ichunk, comm, &request);
-      println(10, MPI_rank<<" received  "<<count/1024<<" kB with ProjectedNodes from "<<source);
       count=STree->sizeNodeCoeff*STree->maxNodesPerChunk;
-      MPI_Irecv(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, source, tag+ichunk*1000, comm, &request);
-      println(10, MPI_rank<<" received  "<<count<<" coefficients from "<<source);
+      MPI_Irecv(STree->nodeCoeffChunks[ichunk], count, MPI_DOUBLE, source, tag+4, comm, &requests[4+ichunk]);
     }
-
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
 
     timer.stop();
     println(10, " time receive  " << timer);
     timer.start();
-    STree->rewritePointers(Nchunks);
+    STree->unpackNodeData(Nchunks);
     timer.stop();
-    println(10, " time rewrite pointers  " << timer);
+    println(10, " time rebuild nodes  " << timer);
 
 }
 #endif
@@ -473,8 +492,8 @@ template void Send_SerialTree<3>(FunctionTree<3>* STree, int Nchunks, int dest,
 template void IRcv_SerialTree<1>(FunctionTree<1>* STree, int Nchunks, int source, int tag, MPI_Comm comm);
 template void IRcv_SerialTree<2>(FunctionTree<2>* STree, int Nchunks, int source, int tag, MPI_Comm comm);
 template void IRcv_SerialTree<3>(FunctionTree<3>* STree, int Nchunks, int source, int tag, MPI_Comm comm);
-template void ISend_SerialTree<1>(FunctionTree<1>* STree, int Nchunks, int dest, int tag, MPI_Comm comm);
-template void ISend_SerialTree<2>(FunctionTree<2>* STree, int Nchunks, int dest, int tag, MPI_Comm comm);
-template void ISend_SerialTree<3>(FunctionTree<3>* STree, int Nchunks, int dest, int tag, MPI_Comm comm);
+template void ISend_SerialTree<1>(FunctionTree<1>* STree, int Nchunks, int dest, int tag, MPI_Comm comm, std::vector<MPI_Request> &requests);
+template void ISend_SerialTree<2>(FunctionTree<2>* STree, int Nchunks, int dest, int tag, MPI_Comm comm, std::vector<MPI_Request> &requests);
+template void ISend_SerialTree<3>(FunctionTree<3>* STree, int Nchunks, int dest, int tag, MPI_Comm comm, std::vector<MPI_Request> &requests);
 #endif
 
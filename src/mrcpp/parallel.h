@@ -16,6 +16,7 @@ class Orbital;
 #define omp_get_max_threads() 1
 #define omp_get_num_threads() 1
 #define omp_get_thread_num() 0
+#define omp_in_parallel() 0
 #define omp_set_dynamic(n)
 #define omp_set_lock(x)
 #define omp_unset_lock(x)
@@ -32,13 +33,19 @@ void MPI_Initializations();
 
 #ifdef HAVE_MPI
 #include <mpi.h>
+#include <vector>
+
+/** Number of consecutive MPI tags used by one serial tree transfer. A tree
+ * sent with tag uses the tags [tag, tag + SerialTreeTags), transfers that
+ * can be pending between the same processes need disjoint blocks. */
+const int SerialTreeTags = 5;
 
 template<int D>
 void Send_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_Comm comm);
 template<int D>
 void IRcv_SerialTree(FunctionTree<D>* Tree, int Nchunks, int source, int tag, MPI_Comm comm);
 template<int D>
-void ISend_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_Comm comm);
+void ISend_SerialTree(FunctionTree<D>* Tree, int Nchunks, int dest, int tag, MPI_Comm comm, std::vector<MPI_Request> &requests);
 template<int D>
 void Rcv_SerialTree(FunctionTree<D>* Tree, int Nchunks, int source, int tag, MPI_Comm comm);
 void Assign_NxN(int N, int* doi, int*doj, int* sendto, int* sendorb, int* rcvorb, int* MaxIter);
@@ -0,0 +1,103 @@
+#include "catch.hpp"
+
+#include "CellList.h"
+
+using namespace std;
+
+namespace cell_list {
+
+template<int D> void testQuery();
+
+TEST_CASE("CellList: Query", "[cell_list]") {
+    SECTION("1D") {
+        testQuery<1>();
+    }
+    SECTION("2D") {
+        testQuery<2>();
+    }
+    SECTION("3D") {
+        testQuery<3>();
+    }
+}
+
+template<int D> bool overlaps(const double *a_lb, const double *a_ub,
+                              const double *b_lb, const double *b_ub) {
+    for (int d = 0; d < D; d++) {
+        if (a_ub[d] < b_lb[d] or a_lb[d] > b_ub[d]) return false;
+    }
+    return true;
+}
+
+template<int D> void testQuery() {
+    // Boxes of varying width along a diagonal, item 3 is unbounded
+    const int nItems = 50;
+    vector<double> lb(D*nItems);
+    vector<double> ub(D*nItems);
+    vector<const double *> lower;
+    vector<const double *> upper;
+    for (int i = 0; i < nItems; i++) {
+        for (int d = 0; d < D; d++) {
+            double c = -2.0 + 0.08*i + 0.3*d;
+            double w = 0.05 + 0.02*((i + d)%7);
+            lb[D*i + d] = c - w;
+            ub[D*i + d] = c + w;
+        }
+        if (i == 3) {
+            lower.push_back(0);
+            upper.push_back(0);
+        } else {
+            lower.push_back(&lb[D*i]);
+            upper.push_back(&ub[D*i]);
+        }
+    }
+    CellList<D> list;
+    list.build(lower, upper);
+    REQUIRE( list.getNItems() == nItems );
+    REQUIRE( list.getNCells() > 1 );
+
+    WHEN("boxes are queried") {
+        for (int n = 0; n < 20; n++) {
+            double q_lb[D], q_ub[D];
+            for (int d = 0; d < D; d++) {
+                q_lb[d] = -2.5 + 0.25*n + 0.1*d;
+                q_ub[d] = q_lb[d] + 0.2;
+            }
+            vector<int> idx;
+            list.query(q_lb, q_ub, idx);
+            THEN("all overlapping items are found in increasing order") {
+                REQUIRE( binary_search(idx.begin(), idx.end(), 3) );
+                for (int j = 1; j < idx.size(); j++) {
+                    REQUIRE( idx[j - 1] < idx[j] );
+                }
+                for (int i = 0; i < nItems; i++) {
+                    if (i == 3) continue;
+                    if (overlaps<D>(&lb[D*i], &ub[D*i], q_lb, q_ub)) {
+                        REQUIRE( binary_search(idx.begin(), idx.end(), i) );
+                    }
+                }
+            }
+        }
+    }
+    WHEN("a box outside all items is queried") {
+        double q_lb[D], q_ub[D];
+        for (int d = 0; d < D; d++) {
+            q_lb[d] = 10.0;
+            q_ub[d] = 11.0;
+        }
+        vector<int> idx;
+        list.query(q_lb, q_ub, idx);
+        THEN("only the unbounded item is found") {
+            REQUIRE( idx.size() == 1 );
+            REQUIRE( idx[0] == 3 );
+        }
+    }
+    WHEN("the list is cleared") {
+        list.clear();
+        THEN("it is empty") {
+            REQUIRE( list.getNItems() == 0 );
+            REQUIRE( list.getNCells() == 0 );
+        }
+    }
+}
+
+} // namespace
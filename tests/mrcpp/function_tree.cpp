@@ -1,11 +1,16 @@
+#include <sstream>
+
 #include "catch.hpp"
 
 #include "factory_functions.h"
+#include "MWProjector.h"
 
 namespace function_tree {
 
 template<int D> void testZeroFunction();
 template<int D> void testGeneratedNodes();
+template<int D> void testClearTree();
+template<int D> void testSaveTree();
 
 SCENARIO("Zero FunctionTree", "[function_tree_zero], [function_tree], [trees]") {
     GIVEN("a default function in 1D") {
@@ -85,4 +90,180 @@ template<int D> void testGeneratedNodes() {
     finalize(&mra);
 }
 
+SCENARIO("Clearing FunctionTree", "[function_tree_clear], [function_tree], [trees]") {
+    GIVEN("a projected Gaussian in 1D") {
+        testClearTree<1>();
+    }
+    GIVEN("a projected Gaussian in 2D") {
+        testClearTree<2>();
+    }
+    GIVEN("a projected Gaussian in 3D") {
+        testClearTree<3>();
+    }
+}
+
+template<int D> void testClearTree() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    FunctionTree<D> tree(*mra);
+    Q(tree, *func);
+
+    const double integral = tree.integrate();
+    const int nNodes = tree.getNNodes();
+    const int nChunks = tree.getSerialFunctionTree()->nodeChunks.size();
+    const int nRoots = tree.getRootBox().size();
+
+    const double r[3] = {-0.3, 0.6, 1.9};
+    tree.getNode(r, 6);
+
+    WHEN("the tree is cleared") {
+        tree.clear();
+        THEN("only the root nodes remain") {
+            REQUIRE( tree.getNNodes() == nRoots );
+            REQUIRE( tree.getNEndNodes() == nRoots );
+            REQUIRE( tree.getNGenNodes() == 0 );
+            REQUIRE( tree.getDepth() == 1 );
+            REQUIRE( tree.getSquareNorm() < 0.0 );
+        }
+        THEN("the node chunks are retained") {
+            REQUIRE( tree.getSerialFunctionTree()->nodeChunks.size() == nChunks );
+        }
+        AND_WHEN("the function is projected again") {
+            Q(tree, *func);
+            THEN("the tree is rebuilt without new chunks") {
+                REQUIRE( tree.getNNodes() == nNodes );
+                REQUIRE( tree.integrate() == Approx(integral) );
+                REQUIRE( tree.getSerialFunctionTree()->nodeChunks.size() == nChunks );
+            }
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+SCENARIO("Saving and loading FunctionTree", "[function_tree_save], [function_tree], [trees]") {
+    GIVEN("a projected Gaussian in 1D") {
+        testSaveTree<1>();
+    }
+    GIVEN("a projected Gaussian in 2D") {
+        testSaveTree<2>();
+    }
+    GIVEN("a projected Gaussian in 3D") {
+        testSaveTree<3>();
+    }
+}
+
+template<int D> void testSaveTree() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    FunctionTree<D> f_tree(*mra);
+    Q(f_tree, *func);
+
+    std::stringstream buf;
+    REQUIRE( f_tree.saveTree(buf) );
+
+    WHEN("the tree is loaded into a new tree") {
+        FunctionTree<D> g_tree(*mra);
+        REQUIRE( g_tree.loadTree(buf) );
+        THEN("the trees have the same structure") {
+            REQUIRE( g_tree.getNNodes() == f_tree.getNNodes() );
+            REQUIRE( g_tree.getNEndNodes() == f_tree.getNEndNodes() );
+            REQUIRE( g_tree.getDepth() == f_tree.getDepth() );
+        }
+        THEN("the trees represent the same function") {
+            const double r[3] = {-0.2, 0.5, 1.0};
+            REQUIRE( g_tree.getSquareNorm() == f_tree.getSquareNorm() );
+            REQUIRE( g_tree.evalf(r) == f_tree.evalf(r) );
+            REQUIRE( g_tree.integrate() == f_tree.integrate() );
+        }
+    }
+    WHEN("the tree is loaded into a tree with a different MRA") {
+        InterpolatingBasis basis(mra->getOrder() + 1);
+        MultiResolutionAnalysis<D> mra_2(mra->getWorldBox(), basis);
+        FunctionTree<D> g_tree(mra_2);
+        THEN("the file is rejected") {
+            REQUIRE_FALSE( g_tree.loadTree(buf) );
+            REQUIRE( g_tree.getNNodes() == g_tree.getRootBox().size() );
+        }
+    }
+    WHEN("the file is truncated") {
+        std::string file = buf.str();
+        std::stringstream cut(file.substr(0, file.size()/2));
+        FunctionTree<D> g_tree(*mra);
+        THEN("the file is rejected") {
+            REQUIRE_FALSE( g_tree.loadTree(cut) );
+            REQUIRE( g_tree.getNNodes() == g_tree.getRootBox().size() );
+        }
+    }
+    WHEN("a child index points outside the stored nodes") {
+        // file layout: header, status, parent and child indices, norms, coefs
+        SerialFunctionTree<D> *sTree = f_tree.getSerialFunctionTree();
+        const int nSlots = sTree->nNodes;
+        const int nNorms = sTree->getNNormsPerNode();
+        std::string file = buf.str();
+        size_t nBody = nSlots*(sizeof(unsigned char) + 2*sizeof(int)
+                     + (nNorms + sTree->sizeNodeCoeff)*sizeof(double));
+        size_t childPos = file.size() - nBody + nSlots*(sizeof(unsigned char) + sizeof(int));
+        int badIx = nSlots;
+        file.replace(childPos, sizeof(int), (const char *) &badIx, sizeof(int));
+        std::stringstream bad(file);
+        FunctionTree<D> g_tree(*mra);
+        THEN("the file is rejected") {
+            REQUIRE_FALSE( g_tree.loadTree(bad) );
+            REQUIRE( g_tree.getNNodes() == g_tree.getRootBox().size() );
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+/* The dot product is summed over fixed blocks of nodes, the result must
+ * be identical to the last digit for any number of threads. */
+TEST_CASE("FunctionTree dot product", "[function_tree_dot], [function_tree], [trees]") {
+    MultiResolutionAnalysis<3> *mra = 0;
+    initialize(&mra);
+
+    double pos_a[3] = {-0.25, 0.35, 1.05};
+    double pos_b[3] = {-0.20, 0.50, 1.05};
+    GaussFunc<3> a_func(110.0, 1.0, pos_a);
+    GaussFunc<3> b_func(50.0, 1.0, pos_b);
+
+    // Different precisions give different grids
+    MWProjector<3> Q_a(1.0e-6);
+    MWProjector<3> Q_b(1.0e-3);
+    FunctionTree<3> a_tree(*mra);
+    FunctionTree<3> b_tree(*mra);
+    Q_a(a_tree, a_func);
+    Q_b(b_tree, b_func);
+
+    const double ref_ab = a_func.calcOverlap(b_func);
+    const double ab = a_tree.dot(b_tree);
+    const double ba = b_tree.dot(a_tree);
+    REQUIRE( ab == Approx(ref_ab).epsilon(1.0e-6) );
+    REQUIRE( ba == Approx(ab) );
+    REQUIRE( a_tree.dot(a_tree) == Approx(a_tree.getSquareNorm()) );
+
+#ifdef OPENMP
+    int nThreads = omp_get_max_threads();
+    for (int n = 1; n <= nThreads; n++) {
+        omp_set_num_threads(n);
+        REQUIRE( a_tree.dot(b_tree) == ab );
+        REQUIRE( b_tree.dot(a_tree) == ba );
+    }
+    omp_set_num_threads(nThreads);
+#endif
+
+    finalize(&mra);
+}
+
 } // namespace
@@ -0,0 +1,123 @@
+#include "catch.hpp"
+
+#include "factory_functions.h"
+#include "MWProjector.h"
+#include "FunctionTreePool.h"
+
+namespace function_tree_pool {
+
+template<int D> void testRecycleTrees();
+
+SCENARIO("Recycling FunctionTrees", "[function_tree_pool], [trees]") {
+    GIVEN("a tree pool in 1D") {
+        testRecycleTrees<1>();
+    }
+    GIVEN("a tree pool in 2D") {
+        testRecycleTrees<2>();
+    }
+    GIVEN("a tree pool in 3D") {
+        testRecycleTrees<3>();
+    }
+}
+
+template<int D> void testRecycleTrees() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    const size_t maxBytes = 1024*1024*1024;
+    FunctionTreePool<D> pool(*mra, maxBytes, 2);
+
+    FunctionTree<D> *tree = pool.get();
+    Q(*tree, *func);
+    const double integral = tree->integrate();
+    const int nNodes = tree->getNNodes();
+    const int nRoots = tree->getRootBox().size();
+    SerialFunctionTree<D> *sTree = tree->getSerialFunctionTree();
+    const int nUsed = sTree->getNUsedChunks();
+    const int nGenUsed = sTree->getNUsedGenChunks();
+
+    REQUIRE( pool.getNTrees() == 0 );
+
+    WHEN("the tree is handed back") {
+        pool.put(tree);
+        THEN("it is kept in the pool") {
+            REQUIRE( pool.getNTrees() == 1 );
+        }
+        THEN("it keeps the chunks it used") {
+            REQUIRE( sTree->getNChunks() == nUsed );
+            REQUIRE( sTree->getNGenChunks() <= nGenUsed );
+            REQUIRE( pool.getNBytes() == sTree->getMemoryUsage() );
+        }
+        AND_WHEN("a tree is fetched again") {
+            FunctionTree<D> *tree_2 = pool.get();
+            THEN("the same tree is recycled in its root state") {
+                REQUIRE( tree_2 == tree );
+                REQUIRE( pool.getNTrees() == 0 );
+                REQUIRE( tree_2->getNNodes() == nRoots );
+                REQUIRE( tree_2->getNEndNodes() == nRoots );
+            }
+            THEN("it can be used to project a new function") {
+                Q(*tree_2, *func);
+                REQUIRE( tree_2->getNNodes() == nNodes );
+                REQUIRE( tree_2->integrate() == Approx(integral) );
+            }
+            pool.put(tree_2);
+        }
+    }
+    WHEN("more trees than the pool size are handed back") {
+        FunctionTree<D> *tree_2 = pool.get();
+        FunctionTree<D> *tree_3 = pool.get();
+        pool.put(tree);
+        pool.put(tree_2);
+        pool.put(tree_3);
+        THEN("the excess trees are deleted") {
+            REQUIRE( pool.getNTrees() == 2 );
+        }
+    }
+    WHEN("the trees exceed the memory bound of the pool") {
+        pool.put(tree);
+        FunctionTree<D> *tree_2 = pool.get();
+        FunctionTree<D> *tree_3 = pool.get();
+        const size_t rootBytes = tree_3->getSerialFunctionTree()->getMemoryUsage();
+        FunctionTreePool<D> small(*mra, rootBytes, 2);
+        small.put(tree_2);
+        THEN("an unused tree keeps only its root chunks") {
+            REQUIRE( small.getNTrees() == 1 );
+            REQUIRE( small.getNBytes() == rootBytes );
+        }
+        AND_WHEN("another tree is handed back") {
+            small.put(tree_3);
+            THEN("the oldest tree is deleted") {
+                REQUIRE( small.getNTrees() == 1 );
+                REQUIRE( small.getNBytes() <= small.getMaxBytes() );
+                FunctionTree<D> *tree_4 = small.get();
+                REQUIRE( tree_4 == tree_3 );
+                REQUIRE( small.getNBytes() == 0 );
+                delete tree_4;
+            }
+        }
+    }
+    WHEN("a tree is larger than the memory bound") {
+        FunctionTreePool<D> empty(*mra, 0, 2);
+        empty.put(tree);
+        THEN("it is deleted") {
+            REQUIRE( empty.getNTrees() == 0 );
+            REQUIRE( empty.getNBytes() == 0 );
+        }
+    }
+    WHEN("the pool is cleared") {
+        pool.put(tree);
+        pool.clear();
+        THEN("there are no idle trees") {
+            REQUIRE( pool.getNTrees() == 0 );
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+} // namespace
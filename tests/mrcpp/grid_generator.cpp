@@ -5,6 +5,8 @@
 namespace grid_generator {
 
 template<int D> void testGridGenerator();
+template<int D> void testUnionGrid();
+template<int D> void testHilbertOrder();
 
 SCENARIO("The GridGenerator builds empty grids", "[grid_generator], [tree_builder], [trees]") {
     GIVEN("a GridGenerator and analytic function in 1D") {
@@ -76,4 +78,122 @@ template<int D> void testGridGenerator() {
     finalize(&f_func);
 }
 
+SCENARIO("The UnionGrid copies the union of several grids", "[grid_generator], [union_grid], [tree_builder], [trees]") {
+    GIVEN("two projected functions in 1D") {
+        testUnionGrid<1>();
+    }
+    GIVEN("two projected functions in 2D") {
+        testUnionGrid<2>();
+    }
+    GIVEN("two projected functions in 3D") {
+        testUnionGrid<3>();
+    }
+}
+
+template<int D> void testUnionGrid() {
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    double pos_a[3] = {-0.25, 0.35, 1.05};
+    double pos_b[3] = { 0.10, 0.30, 0.95};
+    GaussFunc<D> a_func(110.0, 1.0, pos_a);
+    GaussFunc<D> b_func(50.0, 1.0, pos_b);
+
+    GridGenerator<D> G;
+    FunctionTree<D> a_tree(*mra);
+    FunctionTree<D> b_tree(*mra);
+    G(a_tree, a_func, 4);
+    G(b_tree, b_func, 3);
+
+    FunctionTreeVector<D> inp;
+    inp.push_back(&a_tree);
+    inp.push_back(&b_tree);
+
+    // Reference union grid built adaptively by the TreeBuilder
+    FunctionTree<D> ref_tree(*mra);
+    G(ref_tree, inp, 100);
+
+    WHEN("the union grid is stamped onto empty trees") {
+        UnionGrid<D> grid(inp);
+        FunctionTree<D> c_tree(*mra);
+        FunctionTree<D> d_tree(*mra);
+        grid.stamp(c_tree);
+        grid.stamp(d_tree);
+        THEN("both trees get the union grid") {
+            REQUIRE( grid.getNNodes() == ref_tree.getNNodes() );
+            REQUIRE( c_tree.getNNodes() == ref_tree.getNNodes() );
+            REQUIRE( d_tree.getNNodes() == ref_tree.getNNodes() );
+            REQUIRE( c_tree.getNEndNodes() == ref_tree.getNEndNodes() );
+            for (int n = 0; n < ref_tree.getNEndNodes(); n++) {
+                const NodeIndex<D> &idx = ref_tree.getEndMWNode(n).getNodeIndex();
+                REQUIRE( c_tree.getEndMWNode(n).getNodeIndex() == idx );
+                REQUIRE( d_tree.getEndMWNode(n).getNodeIndex() == idx );
+            }
+            REQUIRE( c_tree.getSquareNorm() == Approx(-1.0) );
+            REQUIRE( c_tree.getNGenNodes() == 0 );
+        }
+    }
+    WHEN("the grids are added one at a time") {
+        FunctionTree<D> c_tree(*mra);
+        G(c_tree, a_tree);
+        G(c_tree, b_tree);
+        UnionGrid<D> grid(a_tree);
+        grid.add(b_tree);
+        FunctionTree<D> d_tree(*mra);
+        grid.stamp(d_tree);
+        THEN("the result is the same union grid") {
+            REQUIRE( c_tree.getNNodes() == ref_tree.getNNodes() );
+            REQUIRE( c_tree.getNEndNodes() == ref_tree.getNEndNodes() );
+            REQUIRE( d_tree.getNNodes() == ref_tree.getNNodes() );
+            REQUIRE( d_tree.getNEndNodes() == ref_tree.getNEndNodes() );
+        }
+    }
+    finalize(&mra);
+}
+
+/* Adaptor that splits every node */
+template<int D>
+class SplitAllAdaptor : public TreeAdaptor<D> {
+public:
+    SplitAllAdaptor() : TreeAdaptor<D>(MaxScale) { }
+protected:
+    bool splitNode(const MWNode<D> &node) const { return true; }
+};
+
+TEST_CASE("Split nodes are ordered along the Hilbert path", "[grid_generator], [tree_builder]") {
+    SECTION("1D") {
+        testHilbertOrder<1>();
+    }
+    SECTION("2D") {
+        testHilbertOrder<2>();
+    }
+    SECTION("3D") {
+        testHilbertOrder<3>();
+    }
+}
+
+template<int D> void testHilbertOrder() {
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    FunctionTree<D> tree(*mra);
+    SplitAllAdaptor<D> adaptor;
+    MWNodeVector *workVec = tree.copyEndNodeTable();
+    for (int i = 0; i < 2; i++) {
+        MWNodeVector *newVec = new MWNodeVector;
+        adaptor.splitNodeVector(*newVec, *workVec);
+        delete workVec;
+        workVec = newVec;
+
+        // The end node table is made by traversing the Hilbert path
+        tree.resetEndNodeTable();
+        REQUIRE( workVec->size() == tree.getNEndNodes() );
+        for (int n = 0; n < workVec->size(); n++) {
+            REQUIRE( (*workVec)[n] == &tree.getEndMWNode(n) );
+        }
+    }
+    delete workVec;
+    finalize(&mra);
+}
+
 } // namespace
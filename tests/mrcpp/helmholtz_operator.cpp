@@ -2,6 +2,7 @@
 
 #include "factory_functions.h"
 #include "HelmholtzOperator.h"
+#include "OperatorTermBank.h"
 #include "MWOperator.h"
 #include "MWConvolution.h"
 #include "OperatorAdaptor.h"
@@ -110,6 +111,50 @@ TEST_CASE("Helmholtz' kernel", "[init_helmholtz], [helmholtz_operator], [mw_oper
     }
 }
 
+TEST_CASE("Helmholtz operator bank", "[helmholtz_bank], [helmholtz_operator], [mw_operator]") {
+    const double r_min = 1.0e-3;
+    const double r_max = 1.0e+1;
+    const double exp_prec  = 1.0e-4;
+    const double build_prec = 1.0e-3;
+
+    SECTION("Aligned Helmholtz' kernel") {
+        // Same accuracy as the default kernel, relative to 1/x
+        for (double mu = 0.5; mu < 4.0; mu *= 1.7) {
+            HelmholtzKernel helmholtz(mu, exp_prec, r_min, r_max, true);
+            double x = r_min;
+            while (x < r_max) {
+                double x_k = x*helmholtz.evalf(&x);
+                REQUIRE( fabs(x_k - exp(-mu*x)) < 2.0*exp_prec );
+                x *= 1.1;
+            }
+        }
+    }
+    SECTION("Shared operator terms") {
+        MultiResolutionAnalysis<3> *mra = 0;
+        initialize(&mra);
+
+        OperatorTermBank bank;
+        HelmholtzOperator *H_1 = new HelmholtzOperator(*mra, 1.0, build_prec, &bank);
+        HelmholtzOperator *H_2 = new HelmholtzOperator(*mra, 1.3, build_prec, &bank);
+
+        int nShared = 0;
+        for (int i = 0; i < H_1->size(); i++) {
+            for (int j = 0; j < H_2->size(); j++) {
+                if ((*H_1)[i] == (*H_2)[j]) nShared++;
+            }
+        }
+        REQUIRE( nShared > 0 );
+        REQUIRE( bank.size() == H_1->size() + H_2->size() - nShared );
+
+        delete H_1;
+        REQUIRE( bank.size() == H_2->size() );
+        delete H_2;
+        REQUIRE( bank.size() == 0 );
+
+        finalize(&mra);
+    }
+}
+
 TEST_CASE("Apply Helmholtz' operator", "[apply_helmholtz], [helmholtz_operator], [mw_operator]") {
     double proj_prec = 1.0e-3;
     double apply_prec = 1.0e-2;
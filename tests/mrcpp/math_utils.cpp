@@ -0,0 +1,79 @@
+#include "catch.hpp"
+
+#include "MathUtils.h"
+#include "Timer.h"
+#include "TelePrompter.h"
+
+using namespace Eigen;
+
+namespace math_utils {
+
+template<int D> void testApplyFilter(int kp1);
+
+TEST_CASE("Applying filters with fixed size kernels", "[math_utils], [apply_filter]") {
+    for (int kp1 = 1; kp1 <= 18; kp1++) {
+        testApplyFilter<1>(kp1);
+        testApplyFilter<2>(kp1);
+        testApplyFilter<3>(kp1);
+    }
+}
+
+template<int D> void testApplyFilter(int kp1) {
+    int kp1_dm1 = MathUtils::ipow(kp1, D - 1);
+    int kp1_d = kp1*kp1_dm1;
+
+    MatrixXd filter = MatrixXd::Random(kp1, kp1);
+    VectorXd in = VectorXd::Random(kp1_d);
+    VectorXd out_0 = VectorXd::Random(kp1_d);
+    VectorXd ref_0 = out_0;
+    VectorXd out_1 = VectorXd::Random(kp1_d);
+    VectorXd ref_1 = out_1;
+
+    MathUtils::applyFilter(out_0.data(), in.data(), filter, kp1, kp1_dm1, 0.0);
+    MathUtils::applyFilterGemm(ref_0.data(), in.data(), filter.data(), kp1, kp1_dm1, 0.0);
+    MathUtils::applyFilter(out_1.data(), in.data(), filter, kp1, kp1_dm1, 1.0);
+    MathUtils::applyFilterGemm(ref_1.data(), in.data(), filter.data(), kp1, kp1_dm1, 1.0);
+
+    for (int i = 0; i < kp1_d; i++) {
+        REQUIRE( out_0(i) == Approx(ref_0(i)) );
+        REQUIRE( out_1(i) == Approx(ref_1(i)) );
+    }
+}
+
+/* Micro-benchmark of the fixed size kernels against the general matrix
+ * multiplication, for the 3D transform of one node. Hidden from the default
+ * test run, execute with: unit_tests.x "[.benchmark]" */
+TEST_CASE("Timing of fixed size applyFilter kernels", "[.benchmark], [apply_filter]") {
+    const int nRepeat = 200000;
+    for (int kp1 = 2; kp1 <= 10; kp1++) {
+        int kp1_dm1 = kp1*kp1;
+        int kp1_d = kp1*kp1_dm1;
+        //orthogonal filter, such that repeated application is stable
+        MatrixXd filter = MatrixXd::Identity(kp1, kp1).rowwise().reverse();
+        VectorXd in = VectorXd::Random(kp1_d);
+        VectorXd out = VectorXd::Zero(kp1_d);
+
+        Timer t_gemm;
+        for (int n = 0; n < nRepeat; n++) {
+            MathUtils::applyFilterGemm(out.data(), in.data(), filter.data(), kp1, kp1_dm1, 0.0);
+            MathUtils::applyFilterGemm(in.data(), out.data(), filter.data(), kp1, kp1_dm1, 0.0);
+        }
+        t_gemm.stop();
+        double sum_gemm = in.sum();
+
+        in = VectorXd::Random(kp1_d);
+        Timer t_kern;
+        for (int n = 0; n < nRepeat; n++) {
+            MathUtils::applyFilter(out.data(), in.data(), filter, kp1, kp1_dm1, 0.0);
+            MathUtils::applyFilter(in.data(), out.data(), filter, kp1, kp1_dm1, 0.0);
+        }
+        t_kern.stop();
+
+        double w_gemm = t_gemm.getWallTime();
+        double w_kern = t_kern.getWallTime();
+        println(0, "kp1 " << kp1 << "  gemm " << w_gemm << "  kernel " << w_kern
+                   << "  speedup " << w_gemm/w_kern << "  (" << sum_gemm + in.sum() << ")");
+    }
+}
+
+} // namespace
@@ -1,6 +1,7 @@
 #include "catch.hpp"
 
 #include "FilterCache.h"
+#include "MathUtils.h"
 #include "constants.h"
 
 using namespace Eigen;
@@ -35,4 +36,68 @@ TEST_CASE("Interpolating filters", "[mw_filter]") {
     }
 }
 
+/* Direction by direction transform over all block combinations, as done
+ * by SerialTree::S_mwTransform before the fused 3D version was added. */
+void transform3D(double *out, int out_stride, double *in, int in_stride,
+                 const MWFilter &filter, int oper, bool scalingOnly, double fac) {
+    int kp1 = filter.getOrder() + 1;
+    int kp1_dm1 = kp1*kp1;
+    int kp1_d = kp1*kp1_dm1;
+    VectorXd tmp_1 = VectorXd::Zero(8*kp1_d);
+    VectorXd tmp_2 = VectorXd::Zero(8*kp1_d);
+    double *inp[3] = { in, tmp_1.data(), tmp_2.data() };
+    double *outp[3] = { tmp_1.data(), tmp_2.data(), out };
+    int in_str[3] = { in_stride, kp1_d, kp1_d };
+    int out_str[3] = { kp1_d, kp1_d, out_stride };
+    int ftlim[3] = { 8, 8, 8 };
+    if (scalingOnly) {
+        ftlim[0] = 1;
+        ftlim[1] = 2;
+        ftlim[2] = 4;
+    }
+    for (int i = 0; i < 3; i++) {
+        int mask = 1 << i;
+        for (int gt = 0; gt < 8; gt++) {
+            double overwrite = (i == 2) ? fac : 0.0;
+            for (int ft = 0; ft < ftlim[i]; ft++) {
+                if ((gt | mask) == (ft | mask)) {
+                    int fIdx = 2 * ((gt >> i) & 1) + ((ft >> i) & 1);
+                    const MatrixXd &sub = filter.getSubFilter(fIdx, oper);
+                    MathUtils::applyFilter(outp[i] + gt*out_str[i], inp[i] + ft*in_str[i],
+                                           sub, kp1, kp1_dm1, overwrite);
+                    overwrite = 1.0;
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Fused 3D multiwavelet transform", "[mw_filter], [mw_transform]") {
+    getLegendreFilterCache(lfilters);
+    for (int k = 1; k < 14; k++) {
+        const MWFilter &filter = lfilters.get(k);
+        int kp1 = k + 1;
+        int kp1_d = kp1*kp1*kp1;
+        int stride = kp1_d + 3;
+        VectorXd in = VectorXd::Random(8*stride);
+        for (int oper = Compression; oper <= Reconstruction; oper++) {
+            const MatrixXd &filters = filter.getPackedSubFilters(oper);
+            for (int scalingOnly = 0; scalingOnly < 2; scalingOnly++) {
+                for (int fac = 0; fac < 2; fac++) {
+                    VectorXd out = VectorXd::Random(8*stride);
+                    VectorXd ref = out;
+                    MathUtils::mwTransform3D(out.data(), stride, in.data(), stride,
+                                             filters, kp1, scalingOnly, fac);
+                    transform3D(ref.data(), stride, in.data(), stride,
+                                filter, oper, scalingOnly, fac);
+                    // Bit for bit identical, including the padding between blocks
+                    for (int i = 0; i < 8*stride; i++) {
+                        REQUIRE( out(i) == ref(i) );
+                    }
+                }
+            }
+        }
+    }
+}
+
 } // namespace
@@ -0,0 +1,106 @@
+#include "catch.hpp"
+
+#include "factory_functions.h"
+#include "MWProjector.h"
+#include "MWOverlap.h"
+
+using namespace Eigen;
+
+namespace mw_overlap {
+
+template<int D> void testOverlapMatrix();
+
+SCENARIO("Overlap matrix of MW functions", "[mw_overlap], [trees]") {
+    GIVEN("a set of MW functions in 1D") {
+        testOverlapMatrix<1>();
+    }
+    GIVEN("a set of MW functions in 2D") {
+        testOverlapMatrix<2>();
+    }
+    GIVEN("a set of MW functions in 3D") {
+        testOverlapMatrix<3>();
+    }
+}
+
+template<int D> void testOverlapMatrix() {
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    // Gaussians projected with different precision get different grids
+    const int nFuncs = 4;
+    const double exps[nFuncs] = {110.0, 50.0, 20.0, 80.0};
+    const double pos[nFuncs][3] = {{-0.25, 0.35, 1.05},
+                                   {-0.20, 0.50, 1.05},
+                                   { 0.10, 0.30, 0.95},
+                                   {-0.30, 0.40, 1.00}};
+    const double precs[nFuncs] = {1.0e-5, 1.0e-3, 1.0e-4, 1.0e-6};
+
+    FunctionTreeVector<D> funcs;
+    for (int i = 0; i < nFuncs; i++) {
+        GaussFunc<D> gauss(exps[i], 1.0, pos[i]);
+        MWProjector<D> Q(precs[i]);
+        FunctionTree<D> *tree = new FunctionTree<D>(*mra);
+        Q(*tree, gauss);
+        funcs.push_back(1.0 + i, tree);
+    }
+
+    MatrixXd ref = MatrixXd::Zero(nFuncs, nFuncs);
+    for (int i = 0; i < nFuncs; i++) {
+        for (int j = 0; j < nFuncs; j++) {
+            double c_ij = funcs.getCoef(i)*funcs.getCoef(j);
+            ref(i, j) = c_ij*funcs.getFunc(i).dot(funcs.getFunc(j));
+        }
+    }
+
+    WHEN("the overlap is computed between two sets") {
+        FunctionTreeVector<D> bra;
+        bra.push_back(funcs.getCoef(2), funcs[2]);
+        bra.push_back(funcs.getCoef(0), funcs[0]);
+        MWOverlap<D> S;
+        MatrixXd S_bk = S(bra, funcs);
+        THEN("it equals the pairwise dot products") {
+            REQUIRE( S_bk.rows() == 2 );
+            REQUIRE( S_bk.cols() == nFuncs );
+            for (int j = 0; j < nFuncs; j++) {
+                REQUIRE( S_bk(0, j) == Approx(ref(2, j)) );
+                REQUIRE( S_bk(1, j) == Approx(ref(0, j)) );
+            }
+        }
+    }
+    WHEN("the overlap is computed within one set") {
+        MWOverlap<D> S;
+        MatrixXd S_kk = S(funcs);
+        THEN("it equals the pairwise dot products") {
+            for (int i = 0; i < nFuncs; i++) {
+                for (int j = 0; j < nFuncs; j++) {
+                    REQUIRE( S_kk(i, j) == Approx(ref(i, j)) );
+                }
+            }
+        }
+        THEN("it is exactly symmetric") {
+            for (int i = 0; i < nFuncs; i++) {
+                for (int j = 0; j < i; j++) {
+                    REQUIRE( S_kk(i, j) == S_kk(j, i) );
+                }
+            }
+        }
+#ifdef OPENMP
+        THEN("it is independent of the number of threads") {
+            int nThreads = omp_get_max_threads();
+            omp_set_num_threads(1);
+            MatrixXd S_1 = S(funcs);
+            omp_set_num_threads(nThreads);
+            for (int i = 0; i < nFuncs; i++) {
+                for (int j = 0; j < nFuncs; j++) {
+                    REQUIRE( S_1(i, j) == S_kk(i, j) );
+                }
+            }
+        }
+#endif
+    }
+
+    funcs.clear(true);
+    finalize(&mra);
+}
+
+} // namespace
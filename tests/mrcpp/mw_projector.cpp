@@ -2,6 +2,9 @@
 
 #include "factory_functions.h"
 #include "MWProjector.h"
+#include "GaussExp.h"
+#include "GaussPoly.h"
+#include "AnalyticFunction.h"
 
 namespace mw_projector {
 
@@ -84,4 +87,193 @@ template<int D> void testProjectFunction() {
     finalize(&func);
 }
 
+/* The adaptive build splits nodes and sums norms in parallel, the resulting
+ * grid and coefficients must be identical for any number of threads. */
+TEST_CASE("Adaptive projection is independent of thread count", "[mw_projector], [tree_builder]") {
+    GaussFunc<3> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<3> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-5;
+    MWProjector<3> Q(prec);
+    FunctionTree<3> ref_tree(*mra);
+    FunctionTree<3> tree(*mra);
+
+#ifdef OPENMP
+    int nThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    Q(ref_tree, *func);
+    omp_set_num_threads(nThreads);
+#else
+    Q(ref_tree, *func);
+#endif
+    Q(tree, *func);
+
+    REQUIRE( tree.getNNodes() == ref_tree.getNNodes() );
+    REQUIRE( tree.getNEndNodes() == ref_tree.getNEndNodes() );
+    REQUIRE( tree.getSquareNorm() == ref_tree.getSquareNorm() );
+    for (int n = 0; n < tree.getNEndNodes(); n++) {
+        const MWNode<3> &node = tree.getEndMWNode(n);
+        const MWNode<3> &ref_node = ref_tree.getEndMWNode(n);
+        REQUIRE( node.getNodeIndex() == ref_node.getNodeIndex() );
+        REQUIRE( node.getSquareNorm() == ref_node.getSquareNorm() );
+    }
+
+    finalize(&mra);
+    finalize(&func);
+}
+
+/* Projection with a made up cost model, the nodes are then computed as
+ * cost balanced tasks. The result must be the same as with the default
+ * schedule. */
+template<int D>
+class CostProjectionCalculator : public ProjectionCalculator<D> {
+public:
+    CostProjectionCalculator(const RepresentableFunction<D> &inp_func)
+        : ProjectionCalculator<D>(inp_func) { }
+protected:
+    void getNodeCosts(const MWNodeVector &nodeVec, std::vector<double> &costs) const {
+        costs.resize(nodeVec.size());
+        for (int n = 0; n < nodeVec.size(); n++) {
+            costs[n] = 1.0 + (n%7)*(n%7)*(n%7);
+        }
+    }
+};
+
+TEST_CASE("Cost balanced node scheduling", "[mw_projector], [tree_builder]") {
+    GaussFunc<3> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<3> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-4;
+    MWProjector<3> Q(prec);
+    FunctionTree<3> ref_tree(*mra);
+    Q(ref_tree, *func);
+
+    TreeBuilder<3> builder;
+    WaveletAdaptor<3> adaptor(prec, MaxScale);
+    CostProjectionCalculator<3> calculator(*func);
+    FunctionTree<3> tree(*mra);
+    builder.build(tree, calculator, adaptor, -1);
+    tree.mwTransform(BottomUp);
+    tree.calcSquareNorm();
+
+    REQUIRE( tree.getNNodes() == ref_tree.getNNodes() );
+    REQUIRE( tree.getNEndNodes() == ref_tree.getNEndNodes() );
+    REQUIRE( tree.getSquareNorm() == ref_tree.getSquareNorm() );
+
+    finalize(&mra);
+    finalize(&func);
+}
+
+TEST_CASE("Batched evaluation of Gaussian expansions", "[mw_projector], [gaussians]") {
+    const double pos_a[3] = {-0.25, 0.35, 1.05};
+    const double pos_b[3] = { 0.10, 0.30, 0.95};
+    const int pow_a[3] = {1, 0, 2};
+    const int pow_b[3] = {0, 2, 1};
+
+    GaussFunc<3> func_a(10.0, 1.5, pos_a, pow_a);
+    GaussFunc<3> func_b(200.0, 2.0, pos_b);
+    GaussFunc<3> func_c(5.0, -0.5, pos_b, pow_b);
+    func_b.calcScreening(5.0);
+    GaussPoly<3> poly_c(func_c);
+
+    GaussExp<3> gexp;
+    gexp.append(func_a);
+    gexp.append(func_b);
+    gexp.append(poly_c);
+
+    const int nPts = 500;
+    Eigen::MatrixXd pts(3, nPts);
+    for (int i = 0; i < nPts; i++) {
+        pts(0, i) = -0.2 + 0.0013*i;
+        pts(1, i) =  0.5 - 0.0007*i;
+        pts(2, i) =  1.2 - 0.0011*(i%300);
+    }
+
+    Eigen::VectorXd values(nPts);
+    gexp.evalfBatch(pts.data(), nPts, values.data());
+    for (int i = 0; i < nPts; i++) {
+        const double ref = gexp.evalf(pts.col(i).data());
+        REQUIRE( values(i) == Approx(ref) );
+    }
+    // The screened term is zero on part of the points
+    func_b.evalfBatch(pts.data(), nPts, values.data());
+    int nZero = 0;
+    for (int i = 0; i < nPts; i++) {
+        const double ref = func_b.evalf(pts.col(i).data());
+        REQUIRE( values(i) == Approx(ref) );
+        if (ref == 0.0) nZero++;
+    }
+    REQUIRE( nZero > 0 );
+}
+
+TEST_CASE("Tensor grid evaluation of Gaussian expansions", "[mw_projector], [gaussians]") {
+    const double pos_a[3] = {-0.25, 0.35, 1.05};
+    const double pos_b[3] = { 0.10, 0.30, 0.95};
+    const int pow_a[3] = {1, 0, 2};
+
+    GaussFunc<3> func_a(10.0, 1.5, pos_a, pow_a);
+    GaussFunc<3> func_b(200.0, 2.0, pos_b);
+    func_b.calcScreening(5.0);
+
+    GaussExp<3> gexp;
+    gexp.append(func_a);
+    gexp.append(func_b);
+
+    const int nPts = 7;
+    Eigen::MatrixXd pts(nPts, 3);
+    for (int i = 0; i < nPts; i++) {
+        pts(i, 0) = -0.1 + 0.05*i;
+        pts(i, 1) =  0.2 + 0.03*i;
+        pts(i, 2) =  0.9 + 0.04*i;
+    }
+    auto f = [&gexp] (const double *r) -> double { return gexp.evalf(r); };
+    AnalyticFunction<3> func(f);
+
+    const int nTot = nPts*nPts*nPts;
+    Eigen::VectorXd values(nTot);
+    Eigen::VectorXd ref_values(nTot);
+    gexp.evalfTensor(pts.data(), nPts, values.data());
+    func.evalfTensor(pts.data(), nPts, ref_values.data());
+
+    int n = 0;
+    for (int i = 0; i < nPts; i++) {
+        for (int j = 0; j < nPts; j++) {
+            for (int k = 0; k < nPts; k++) {
+                const double r[3] = {pts(k, 0), pts(j, 1), pts(i, 2)};
+                const double ref = gexp.evalf(r);
+                REQUIRE( ref_values(n) == ref );
+                REQUIRE( values(n) == Approx(ref) );
+                n++;
+            }
+        }
+    }
+
+    // Values are unchanged when the terms are looked up in a cell list
+    Eigen::VectorXd screen_values(nTot);
+    gexp.setupScreening();
+    gexp.evalfTensor(pts.data(), nPts, screen_values.data());
+    gexp.clearScreening();
+    for (int i = 0; i < nTot; i++) {
+        REQUIRE( screen_values(i) == values(i) );
+    }
+
+    MultiResolutionAnalysis<3> *mra = 0;
+    initialize(&mra);
+    GridGenerator<3> G;
+    MWProjector<3> Q;
+    FunctionTree<3> tree(*mra);
+    FunctionTree<3> ref_tree(*mra);
+    G(tree, gexp);
+    G(ref_tree, tree);
+    Q(tree, gexp);
+    Q(ref_tree, func);
+    REQUIRE( tree.integrate() == Approx(ref_tree.integrate()) );
+    REQUIRE( tree.getSquareNorm() == Approx(ref_tree.getSquareNorm()) );
+    finalize(&mra);
+}
+
 } // namespace
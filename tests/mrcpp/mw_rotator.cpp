@@ -0,0 +1,100 @@
+#include "catch.hpp"
+
+#include "factory_functions.h"
+#include "MWProjector.h"
+#include "MWAdder.h"
+#include "MWRotator.h"
+
+using namespace Eigen;
+
+namespace mw_rotator {
+
+template<int D> void testRotation();
+
+SCENARIO("Rotating a set of MW functions", "[mw_rotator], [tree_builder]") {
+    GIVEN("a set of MW functions in 1D") {
+        testRotation<1>();
+    }
+    GIVEN("a set of MW functions in 2D") {
+        testRotation<2>();
+    }
+    GIVEN("a set of MW functions in 3D") {
+        testRotation<3>();
+    }
+}
+
+template<int D> void testRotation() {
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-4;
+    const int nInp = 3;
+    const double exps[nInp] = {110.0, 50.0, 20.0};
+    const double pos[nInp][3] = {{-0.25, 0.35, 1.05},
+                                 {-0.20, 0.50, 1.05},
+                                 { 0.10, 0.30, 0.95}};
+
+    MWProjector<D> Q(prec);
+    FunctionTreeVector<D> inp;
+    for (int j = 0; j < nInp; j++) {
+        GaussFunc<D> gauss(exps[j], 1.0, pos[j]);
+        FunctionTree<D> *tree = new FunctionTree<D>(*mra);
+        Q(*tree, gauss);
+        inp.push_back(1.0 + 0.5*j, tree);
+    }
+
+    // Last input does not contribute
+    const int nOut = 2;
+    MatrixXd U(nOut, nInp);
+    U << 0.8, -0.6, 0.0,
+         0.6,  0.8, 0.0;
+
+    FunctionTreeVector<D> ref;
+    MWAdder<D> add(prec);
+    for (int i = 0; i < nOut; i++) {
+        FunctionTreeVector<D> sum_vec;
+        for (int j = 0; j < nInp; j++) {
+            if (U(i, j) == 0.0) continue;
+            sum_vec.push_back(U(i, j)*inp.getCoef(j), inp[j]);
+        }
+        FunctionTree<D> *tree = new FunctionTree<D>(*mra);
+        add(*tree, sum_vec);
+        ref.push_back(tree);
+    }
+
+    WHEN("the set is rotated") {
+        FunctionTreeVector<D> out;
+        for (int i = 0; i < nOut; i++) {
+            out.push_back(new FunctionTree<D>(*mra));
+        }
+        MWRotator<D> rot(prec);
+        rot(out, U, inp);
+        THEN("each output equals the adaptive sum") {
+            for (int i = 0; i < nOut; i++) {
+                FunctionTree<D> &out_i = out.getFunc(i);
+                FunctionTree<D> &ref_i = ref.getFunc(i);
+                const double ref_norm = ref_i.getSquareNorm();
+                REQUIRE( out_i.integrate() == Approx(ref_i.integrate()) );
+                REQUIRE( out_i.getSquareNorm() == Approx(ref_norm) );
+                REQUIRE( out_i.dot(ref_i) == Approx(ref_norm) );
+            }
+        }
+        THEN("the outputs are no larger than the adaptive sums") {
+            for (int i = 0; i < nOut; i++) {
+                REQUIRE( out.getFunc(i).getNNodes() <= ref.getFunc(i).getNNodes() );
+            }
+        }
+        THEN("the input trees are left without generated nodes") {
+            for (int j = 0; j < nInp; j++) {
+                REQUIRE( inp.getFunc(j).getNGenNodes() == 0 );
+            }
+        }
+        out.clear(true);
+    }
+
+    ref.clear(true);
+    inp.clear(true);
+    finalize(&mra);
+}
+
+} // namespace
@@ -2,13 +2,25 @@
 
 #include "factory_functions.h"
 #include "PoissonOperator.h"
+#include "OperatorCache.h"
 #include "MWOperator.h"
 #include "MWConvolution.h"
+#include "ConvolutionCalculator.h"
+#include "WaveletAdaptor.h"
+#include "TreeBuilder.h"
 #include "OperatorAdaptor.h"
 #include "MWProjector.h"
+#include "MWAdder.h"
 #include "BandWidth.h"
 #include "CrossCorrelationCalculator.h"
 #include "GaussFunc.h"
+#include "GreensKernel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <dirent.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -138,4 +150,290 @@ TEST_CASE("Apply Poisson's operator", "[apply_poisson], [poisson_operator], [mw_
     finalize(&mra);
 }
 
+TEST_CASE("Merged Poisson operator terms", "[merge_terms], [poisson_operator], [mw_operator]") {
+    double proj_prec = 1.0e-4;
+    double apply_prec = 1.0e-3;
+    double build_prec = 1.0e-4;
+
+    MultiResolutionAnalysis<3> *mra = 0;
+    GaussFunc<3> *fFunc = 0;
+
+    initialize(&fFunc);
+    initialize(&mra);
+
+    MWProjector<3> Q(proj_prec);
+    PoissonOperator P(*mra, build_prec);
+    MWConvolution<3> apply(apply_prec);
+
+    FunctionTree<3> fTree(*mra);
+    Q(fTree, *fFunc);
+
+    SECTION("merging reduces the number of terms at coarse scales") {
+        P.calcBandWidths(apply_prec);
+        vector<int> nMerged;
+        for (int depth = 0; depth < P.getMaxBandWidths().size(); depth++) {
+            nMerged.push_back(P.getNTerms(depth));
+        }
+        P.clearBandWidths();
+
+        P.setMergeTerms(false);
+        P.calcBandWidths(apply_prec);
+        int nReduced = 0;
+        for (int depth = 0; depth < nMerged.size(); depth++) {
+            REQUIRE( nMerged[depth] <= P.getNTerms(depth) );
+            if (nMerged[depth] < P.getNTerms(depth)) nReduced++;
+        }
+        P.clearBandWidths();
+        REQUIRE( nReduced > 0 );
+    }
+    SECTION("merged and unmerged application agree") {
+        FunctionTree<3> gTree_1(*mra);
+        apply(gTree_1, P, fTree);
+
+        P.setMergeTerms(false);
+        FunctionTree<3> gTree_2(*mra);
+        apply(gTree_2, P, fTree);
+
+        MWAdder<3> add;
+        FunctionTree<3> dTree(*mra);
+        add(dTree, 1.0, gTree_1, -1.0, gTree_2);
+
+        double norm = sqrt(gTree_2.getSquareNorm());
+        double error = sqrt(dTree.getSquareNorm());
+        REQUIRE( error < apply_prec*norm );
+    }
+
+    finalize(&fFunc);
+    finalize(&mra);
+}
+
+/* Two terms with the same exponent and 1D weights 1 and -2. The second term
+ * is merged into the first with weight -2 at every depth, so the merged 3D
+ * factor is 1 + (-2)^3 = -7. */
+class SignedKernel : public GreensKernel {
+public:
+    SignedKernel(double a) : GreensKernel(1.0e-4, -1.0, -1.0), alpha(a) {
+        initializeKernel();
+    }
+protected:
+    double alpha;
+
+    void initializeKernel() {
+        double coef = sqrt(this->alpha/pi);
+        GaussFunc<1> term_0(this->alpha, coef);
+        GaussFunc<1> term_1(this->alpha, -2.0*coef);
+        this->append(term_0);
+        this->append(term_1);
+    }
+};
+
+class SignedOperator : public ConvolutionOperator<3> {
+public:
+    SignedOperator(const MultiResolutionAnalysis<3> &mra, double a, double pr)
+            : ConvolutionOperator<3>(mra, pr) {
+        int oldlevel = TelePrompter::setPrintLevel(0);
+        SignedKernel kernel(a);
+        initializeOperator(kernel);
+        TelePrompter::setPrintLevel(oldlevel);
+    }
+};
+
+TEST_CASE("Merged operator terms with negative factor", "[merge_terms_sign], [poisson_operator], [mw_operator]") {
+    double proj_prec = 1.0e-4;
+    double apply_prec = 1.0e-3;
+    double build_prec = 1.0e-4;
+
+    MultiResolutionAnalysis<3> *mra = 0;
+    GaussFunc<3> *fFunc = 0;
+
+    initialize(&fFunc);
+    initialize(&mra);
+
+    MWProjector<3> Q(proj_prec);
+    const double alpha = 1.0e6;
+    SignedOperator O(*mra, alpha, build_prec);
+    MWConvolution<3> apply(apply_prec);
+
+    FunctionTree<3> fTree(*mra);
+    Q(fTree, *fFunc);
+
+    O.calcBandWidths(apply_prec);
+    int nNegative = 0;
+    for (int depth = 0; depth < O.getMaxBandWidths().size(); depth++) {
+        for (int n = 0; n < O.getNTerms(depth); n++) {
+            if (O.getTermFactor(depth, n, 3) < 0.0) nNegative++;
+        }
+    }
+    O.clearBandWidths();
+    REQUIRE( nNegative > 0 );
+
+    FunctionTree<3> gTree_1(*mra);
+    apply(gTree_1, O, fTree);
+
+    O.setMergeTerms(false);
+    FunctionTree<3> gTree_2(*mra);
+    apply(gTree_2, O, fTree);
+
+    MWAdder<3> add;
+    FunctionTree<3> dTree(*mra);
+    add(dTree, 1.0, gTree_1, -1.0, gTree_2);
+
+    double norm = sqrt(gTree_2.getSquareNorm());
+    double error = sqrt(dTree.getSquareNorm());
+    REQUIRE( error < apply_prec*norm );
+
+    // Convolution of two Gaussians: f*K = -7 f' with f' of exponent b
+    double a = fFunc->getExp();
+    double b = a*alpha/(a + alpha);
+    double E_ana = -7.0*pow(2.0*b/(a + b), 1.5)*fTree.getSquareNorm();
+    REQUIRE( gTree_1.dot(fTree) == Approx(E_ana).epsilon(apply_prec) );
+
+    finalize(&fFunc);
+    finalize(&mra);
+}
+
+/* Convolution with either the cost model of ConvolutionCalculator, which
+ * computes the nodes as cost balanced tasks, or no costs, which gives the
+ * default guided schedule. Counts the work vectors that were balanced. */
+template<int D>
+class ScheduledConvolutionCalculator : public ConvolutionCalculator<D> {
+public:
+    ScheduledConvolutionCalculator(double p,
+                                   ConvolutionOperator<D> &o,
+                                   FunctionTree<D> &f,
+                                   bool b)
+        : ConvolutionCalculator<D>(p, o, f),
+          balanced(b),
+          nBalanced(0) { }
+
+    int getNBalanced() const { return this->nBalanced; }
+
+protected:
+    bool balanced;
+    mutable int nBalanced;
+
+    void getNodeCosts(const MWNodeVector &nodeVec, vector<double> &costs) const {
+        if (not this->balanced) return;
+        ConvolutionCalculator<D>::getNodeCosts(nodeVec, costs);
+        if (costs.size() == nodeVec.size()) this->nBalanced++;
+        for (int n = 0; n < costs.size(); n++) {
+            if (costs[n] < 1.0) FAIL("Invalid node cost");
+        }
+    }
+};
+
+void applyScheduled(FunctionTree<3> &out,
+                    PoissonOperator &oper,
+                    FunctionTree<3> &inp,
+                    double prec,
+                    bool balanced,
+                    int &nBalanced) {
+    oper.calcBandWidths(prec);
+    WaveletAdaptor<3> adaptor(prec, MaxScale);
+    ScheduledConvolutionCalculator<3> calculator(prec, oper, inp, balanced);
+    TreeBuilder<3> builder;
+    builder.build(out, calculator, adaptor, -1);
+    nBalanced = calculator.getNBalanced();
+
+    oper.clearBandWidths();
+    out.mwTransform(TopDown, false);
+    out.mwTransform(BottomUp);
+    out.calcSquareNorm();
+    inp.deleteGenerated();
+}
+
+TEST_CASE("Cost balanced Poisson application", "[balanced_poisson], [poisson_operator], [mw_operator]") {
+    double proj_prec = 1.0e-4;
+    double apply_prec = 1.0e-3;
+    double build_prec = 1.0e-4;
+
+    MultiResolutionAnalysis<3> *mra = 0;
+    GaussFunc<3> *fFunc = 0;
+
+    initialize(&fFunc);
+    initialize(&mra);
+
+    MWProjector<3> Q(proj_prec);
+    PoissonOperator P(*mra, build_prec);
+
+    FunctionTree<3> fTree(*mra);
+    Q(fTree, *fFunc);
+
+    int nBalanced = 0;
+    FunctionTree<3> gTree_1(*mra);
+    applyScheduled(gTree_1, P, fTree, apply_prec, true, nBalanced);
+    REQUIRE( nBalanced > 0 );
+
+    int nDefault = 0;
+    FunctionTree<3> gTree_2(*mra);
+    applyScheduled(gTree_2, P, fTree, apply_prec, false, nDefault);
+    REQUIRE( nDefault == 0 );
+
+    REQUIRE( gTree_1.getNNodes() == gTree_2.getNNodes() );
+    REQUIRE( gTree_1.getNEndNodes() == gTree_2.getNEndNodes() );
+    REQUIRE( gTree_1.getSquareNorm() == Approx(gTree_2.getSquareNorm()) );
+    REQUIRE( gTree_1.dot(fTree) == Approx(gTree_2.dot(fTree)) );
+
+    finalize(&fFunc);
+    finalize(&mra);
+}
+
+/** Points the operator cache to a new temporary directory. The directory
+ * is removed and the cache disabled again when the scope is left, also if
+ * a check fails. */
+class TemporaryCacheDir {
+public:
+    TemporaryCacheDir() {
+        char tmpl[] = "/tmp/mrcpp_cache_XXXXXX";
+        if (mkdtemp(tmpl) == 0) FAIL("Unable to create cache directory");
+        this->dir = tmpl;
+        OperatorCache::setDirectory(this->dir);
+    }
+    ~TemporaryCacheDir() {
+        OperatorCache::setDirectory("");
+        DIR *d = opendir(this->dir.c_str());
+        if (d == 0) return;
+        struct dirent *entry;
+        while ((entry = readdir(d)) != 0) {
+            string name = entry->d_name;
+            if (name == "." or name == "..") continue;
+            remove((this->dir + "/" + name).c_str());
+        }
+        closedir(d);
+        rmdir(this->dir.c_str());
+    }
+private:
+    string dir;
+};
+
+TEST_CASE("Poisson operator cache", "[operator_cache], [poisson_operator], [mw_operator]") {
+    double build_prec = 1.0e-3;
+
+    MultiResolutionAnalysis<3> *mra = 0;
+    initialize(&mra);
+
+    {
+        TemporaryCacheDir cacheDir;
+        PoissonOperator P_1(*mra, build_prec);
+        string fname = OperatorCache::getFileName(P_1.getCacheKey());
+        REQUIRE( ifstream(fname.c_str()).good() );
+
+        // Same parameters, the operator trees are read from the cache
+        PoissonOperator P_2(*mra, build_prec);
+        REQUIRE( P_1.size() == P_2.size() );
+        for (int i = 0; i < P_1.size(); i++) {
+            stringstream buf_1, buf_2;
+            REQUIRE( P_1.getComponent(i).saveTree(buf_1) );
+            REQUIRE( P_2.getComponent(i).saveTree(buf_2) );
+            REQUIRE( buf_1.str() == buf_2.str() );
+        }
+
+        REQUIRE( P_1.getCacheKey() == P_2.getCacheKey() );
+        PoissonOperator P_3(*mra, 10.0*build_prec);
+        REQUIRE( P_1.getCacheKey() != P_3.getCacheKey() );
+    }
+    REQUIRE( not OperatorCache::isEnabled() );
+    finalize(&mra);
+}
+
 } // namespace
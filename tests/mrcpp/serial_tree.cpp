@@ -0,0 +1,472 @@
+#include "catch.hpp"
+
+#include "factory_functions.h"
+#include "MWProjector.h"
+#include "SerialFunctionTree.h"
+#include "NodeOccupancy.h"
+#include "ProjectedNode.h"
+#include "HilbertIterator.h"
+#include "Timer.h"
+
+namespace serial_tree {
+
+template<int D> void testPackNodeData();
+
+SCENARIO("Packing SerialFunctionTree node data", "[serial_tree], [trees]") {
+    GIVEN("a projected Gaussian in 1D") {
+        testPackNodeData<1>();
+    }
+    GIVEN("a projected Gaussian in 2D") {
+        testPackNodeData<2>();
+    }
+    GIVEN("a projected Gaussian in 3D") {
+        testPackNodeData<3>();
+    }
+}
+
+template<int D> void testPackNodeData() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    FunctionTree<D> f_tree(*mra);
+    Q(f_tree, *func);
+
+    SerialFunctionTree<D> *f_stree = f_tree.getSerialFunctionTree();
+    int nChunks = f_stree->nodeChunks.size();
+    f_stree->packNodeData(nChunks);
+
+    WHEN("the node data is packed") {
+        int nSlots = nChunks*f_stree->maxNodesPerChunk;
+        THEN("there is one entry per node slot") {
+            REQUIRE( f_stree->nodeStatus.size() == nSlots );
+            REQUIRE( f_stree->nodeParentIx.size() == nSlots );
+            REQUIRE( f_stree->nodeChildIx.size() == nSlots );
+            REQUIRE( f_stree->nodeNorms.size() == nSlots*f_stree->getNNormsPerNode() );
+        }
+        THEN("all nodes of the tree are marked as occupied") {
+            int nOccupied = 0;
+            for (int i = 0; i < nSlots; i++) {
+                if (f_stree->nodeStatus[i] != 0) nOccupied++;
+            }
+            REQUIRE( nOccupied == f_tree.getNNodes() );
+        }
+    }
+    WHEN("the node data and coefficients are unpacked into a new tree") {
+        FunctionTree<D> g_tree(*mra);
+        SerialFunctionTree<D> *g_stree = g_tree.getSerialFunctionTree();
+        g_stree->nodeStatus = f_stree->nodeStatus;
+        g_stree->nodeParentIx = f_stree->nodeParentIx;
+        g_stree->nodeChildIx = f_stree->nodeChildIx;
+        g_stree->nodeNorms = f_stree->nodeNorms;
+        g_stree->allocChunks(nChunks);
+        int nCoefs = f_stree->sizeNodeCoeff*f_stree->maxNodesPerChunk;
+        for (int i = 0; i < nChunks; i++) {
+            for (int j = 0; j < nCoefs; j++) {
+                g_stree->nodeCoeffChunks[i][j] = f_stree->nodeCoeffChunks[i][j];
+            }
+        }
+        g_stree->unpackNodeData(nChunks);
+
+        THEN("the trees have the same structure") {
+            REQUIRE( g_tree.getNNodes() == f_tree.getNNodes() );
+            REQUIRE( g_tree.getNEndNodes() == f_tree.getNEndNodes() );
+            REQUIRE( g_tree.getDepth() == f_tree.getDepth() );
+        }
+        THEN("the trees have the same norm") {
+            REQUIRE( g_tree.getSquareNorm() == Approx(f_tree.getSquareNorm()) );
+        }
+        THEN("the trees represent the same function") {
+            const double r[3] = {-0.2, 0.5, 1.0};
+            REQUIRE( g_tree.evalf(r) == Approx(f_tree.evalf(r)) );
+            REQUIRE( g_tree.integrate() == Approx(f_tree.integrate()) );
+            REQUIRE( g_tree.dot(f_tree) == Approx(f_tree.getSquareNorm()) );
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+template<int D> void testNodeMap();
+
+SCENARIO("Looking up SerialFunctionTree nodes by NodeIndex", "[serial_tree_node_map], [serial_tree], [trees]") {
+    GIVEN("a projected Gaussian in 1D") {
+        testNodeMap<1>();
+    }
+    GIVEN("a projected Gaussian in 2D") {
+        testNodeMap<2>();
+    }
+    GIVEN("a projected Gaussian in 3D") {
+        testNodeMap<3>();
+    }
+}
+
+template<int D> void testNodeMap() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    FunctionTree<D> tree(*mra);
+    Q(tree, *func);
+
+    SerialFunctionTree<D> *stree = tree.getSerialFunctionTree();
+    std::vector<MWNode<D> *> nodeTable;
+    tree.makeNodeTable(nodeTable);
+
+    THEN("the node map is only kept on request") {
+        REQUIRE( not stree->hasNodeMap() );
+        stree->enableNodeMap();
+        REQUIRE( stree->hasNodeMap() );
+    }
+    THEN("all nodes are found with and without the node map") {
+        stree->enableNodeMap();
+        int nFound = 0;
+        for (int i = 0; i < nodeTable.size(); i++) {
+            if (tree.findNode(nodeTable[i]->getNodeIndex()) == nodeTable[i]) nFound++;
+        }
+        REQUIRE( nFound == tree.getNNodes() );
+        stree->disableNodeMap();
+        nFound = 0;
+        for (int i = 0; i < nodeTable.size(); i++) {
+            if (tree.findNode(nodeTable[i]->getNodeIndex()) == nodeTable[i]) nFound++;
+        }
+        REQUIRE( nFound == tree.getNNodes() );
+    }
+    THEN("nodes below the end nodes are not found") {
+        stree->enableNodeMap();
+        MWNode<D> &endNode = tree.getEndMWNode(0);
+        NodeIndex<D> idx(endNode.getNodeIndex(), 0);
+        REQUIRE( tree.findNode(idx) == 0 );
+        REQUIRE( &tree.getNode(idx) != 0 );
+        REQUIRE( tree.findNode(idx) == 0 );
+        tree.deleteGenerated();
+    }
+    WHEN("the end nodes are split") {
+        stree->enableNodeMap();
+        int nNodes = tree.getNNodes();
+        MWNode<D> &endNode = tree.getEndMWNode(0);
+        endNode.createChildren();
+        NodeIndex<D> idx(endNode.getNodeIndex(), 0);
+        THEN("the new nodes are found") {
+            REQUIRE( tree.findNode(idx) == &endNode.getMWChild(0) );
+        }
+        AND_WHEN("the new nodes are deleted again") {
+            endNode.deleteChildren();
+            THEN("they are no longer found") {
+                REQUIRE( tree.getNNodes() == nNodes );
+                REQUIRE( tree.findNode(idx) == 0 );
+            }
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+SCENARIO("Growing a SerialFunctionTree beyond max_nodes", "[serial_tree_growth], [serial_tree], [trees]") {
+    MultiResolutionAnalysis<1> *mra = 0;
+    initialize(&mra);
+
+    GIVEN("a 1D tree created with room for 64 nodes") {
+        const int maxNodes = 64;
+        FunctionTree<1> tree(*mra, maxNodes);
+        SerialFunctionTree<1> *stree = tree.getSerialFunctionTree();
+        WHEN("the tree is split uniformly to depth 7") {
+            for (int d = 0; d < 7; d++) {
+                std::vector<MWNode<1> *> nodes = *tree.getEndNodeTable();
+                for (int i = 0; i < nodes.size(); i++) {
+                    nodes[i]->createChildren();
+                }
+                tree.resetEndNodeTable();
+            }
+            THEN("the node storage has grown") {
+                REQUIRE( tree.getNNodes() == 255 );
+                REQUIRE( tree.getNNodes() > maxNodes );
+                REQUIRE( stree->nodeOccupancy.size() >= tree.getNNodes() );
+                REQUIRE( stree->nodeChunks.size() == stree->nodeOccupancy.getNChunks() );
+            }
+            AND_WHEN("the tree is cropped back to the root") {
+                tree.getRootMWNode(0).deleteChildren();
+                THEN("only the root remains occupied") {
+                    int nOccupied = 0;
+                    for (int i = 0; i < stree->nodeOccupancy.size(); i++) {
+                        if (stree->nodeOccupancy.isOccupied(i)) nOccupied++;
+                    }
+                    REQUIRE( nOccupied == 1 );
+                    REQUIRE( tree.getNNodes() == 1 );
+                }
+            }
+        }
+    }
+    finalize(&mra);
+}
+
+template<int D> void testCompact();
+
+SCENARIO("Compacting a fragmented SerialFunctionTree", "[serial_tree_compact], [serial_tree], [trees]") {
+    GIVEN("a cropped Gaussian in 1D") {
+        testCompact<1>();
+    }
+    GIVEN("a cropped Gaussian in 2D") {
+        testCompact<2>();
+    }
+    GIVEN("a cropped Gaussian in 3D") {
+        testCompact<3>();
+    }
+}
+
+template<int D> void testCompact() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    //uniform grid that is mostly cropped away after projection
+    const int depth = 7 - 2*D;
+    FunctionTree<D> tree(*mra);
+    for (int d = 0; d < depth; d++) {
+        std::vector<MWNode<D> *> nodes = *tree.getEndNodeTable();
+        for (int i = 0; i < nodes.size(); i++) {
+            nodes[i]->createChildren();
+        }
+        tree.resetEndNodeTable();
+    }
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    Q(tree, *func);
+    tree.crop(prec);
+
+    const double r[3] = {-0.2, 0.5, 1.0};
+    const double ref_val = tree.evalf(r);
+    const double ref_int = tree.integrate();
+    const double ref_norm = tree.getSquareNorm();
+    const int nNodes = tree.getNNodes();
+    const int nEndNodes = tree.getNEndNodes();
+
+    SerialFunctionTree<D> *stree = tree.getSerialFunctionTree();
+    const int nChunks = stree->nodeChunks.size();
+
+    WHEN("the tree is compacted") {
+        int nUsed = stree->compact();
+        THEN("the nodes occupy the leading chunks") {
+            //chunks are small in 1D and 2D, the 3D tree fits in one chunk
+            if (D < 3) REQUIRE( nUsed < nChunks );
+            REQUIRE( nUsed <= nChunks );
+            int nOccupied = 0;
+            int lastIx = -1;
+            for (int i = 0; i < stree->nodeOccupancy.size(); i++) {
+                if (not stree->nodeOccupancy.isOccupied(i)) continue;
+                nOccupied++;
+                lastIx = i;
+            }
+            REQUIRE( nOccupied == nNodes );
+            REQUIRE( lastIx < nUsed*stree->maxNodesPerChunk );
+            REQUIRE( (nUsed - 1)*stree->maxNodesPerChunk <= lastIx );
+        }
+        THEN("the tree has the same structure") {
+            REQUIRE( tree.getNNodes() == nNodes );
+            REQUIRE( tree.getNEndNodes() == nEndNodes );
+            REQUIRE( tree.getSquareNorm() == Approx(ref_norm) );
+        }
+        THEN("the tree represents the same function") {
+            REQUIRE( tree.evalf(r) == Approx(ref_val) );
+            REQUIRE( tree.integrate() == Approx(ref_int) );
+            REQUIRE( tree.dot(tree) == Approx(ref_norm) );
+        }
+        AND_WHEN("the tree is compacted again") {
+            //the MPI senders compact the source tree before every transfer
+            std::vector<MWNode<D> *> endNodes = *tree.getEndNodeTable();
+            const double int_1 = tree.integrate();
+            int nUsed_2 = stree->compact();
+            THEN("the nodes stay in place") {
+                REQUIRE( nUsed_2 == nUsed );
+                REQUIRE( tree.getNEndNodes() == endNodes.size() );
+                int nMoved = 0;
+                for (int i = 0; i < endNodes.size(); i++) {
+                    if (&tree.getEndMWNode(i) != endNodes[i]) nMoved++;
+                }
+                REQUIRE( nMoved == 0 );
+                REQUIRE( tree.integrate() == int_1 );
+            }
+        }
+        AND_WHEN("the tree is refined after compaction") {
+            Q(tree, *func);
+            THEN("new nodes are allocated consistently") {
+                REQUIRE( tree.integrate() == Approx(ref_int) );
+                REQUIRE( stree->nodeChunks.size() == stree->nodeOccupancy.getNChunks() );
+            }
+        }
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+template<int D> void testNodeArrays();
+
+SCENARIO("Traversing SerialFunctionTree metadata arrays", "[serial_tree_arrays], [serial_tree], [trees]") {
+    GIVEN("a cropped Gaussian in 1D") {
+        testNodeArrays<1>();
+    }
+    GIVEN("a cropped Gaussian in 2D") {
+        testNodeArrays<2>();
+    }
+    GIVEN("a cropped Gaussian in 3D") {
+        testNodeArrays<3>();
+    }
+}
+
+template<int D> void testNodeArrays() {
+    GaussFunc<D> *func = 0;
+    initialize(&func);
+    MultiResolutionAnalysis<D> *mra = 0;
+    initialize(&mra);
+
+    //cropping leaves released sibling groups behind in the arrays
+    const int depth = 7 - 2*D;
+    FunctionTree<D> tree(*mra);
+    for (int d = 0; d < depth; d++) {
+        std::vector<MWNode<D> *> nodes = *tree.getEndNodeTable();
+        for (int i = 0; i < nodes.size(); i++) {
+            nodes[i]->createChildren();
+        }
+        tree.resetEndNodeTable();
+    }
+    const double prec = 1.0e-3;
+    MWProjector<D> Q(prec);
+    Q(tree, *func);
+    tree.crop(prec);
+
+    //GenNodes below the end nodes must not be part of the tables
+    const double r[3] = {-0.2, 0.5, 1.0};
+    tree.evalf(r);
+
+    SerialFunctionTree<D> *stree = tree.getSerialFunctionTree();
+    std::vector<MWNode<D> *> refNodes;
+    std::vector<MWNode<D> *> refEndNodes;
+    HilbertIterator<D> it(&tree);
+    it.setReturnGenNodes(false);
+    while (it.next()) {
+        refNodes.push_back(&it.getNode());
+        if (it.getNode().isEndNode()) refEndNodes.push_back(&it.getNode());
+    }
+
+    THEN("the nodes keep their metadata in the arrays") {
+        int nWrong = 0;
+        for (int i = 0; i < refNodes.size(); i++) {
+            const MWNode<D> &node = *refNodes[i];
+            int sIx = node.getSerialIx();
+            if (stree->getNode(sIx) != &node) nWrong++;
+            if (stree->isEndNode(sIx) != node.isEndNode()) nWrong++;
+            if (stree->getNodeNorms(sIx)[0] != node.getSquareNorm()) nWrong++;
+            if (node.isRootNode() and stree->getParentIx(sIx) != -1) nWrong++;
+            if (not node.isRootNode() and stree->getParentIx(sIx) != node.getMWParent().getSerialIx()) nWrong++;
+        }
+        REQUIRE( nWrong == 0 );
+    }
+    THEN("the node tables are found in Hilbert order") {
+        std::vector<MWNode<D> *> nodes;
+        REQUIRE( stree->makeNodeTable(nodes) );
+        REQUIRE( nodes == refNodes );
+
+        std::vector<std::vector<MWNode<D> *> > nodesAtDepth;
+        REQUIRE( stree->makeNodeTable(nodesAtDepth) );
+        int nNodes = 0;
+        for (int d = 0; d < nodesAtDepth.size(); d++) {
+            for (int i = 0; i < nodesAtDepth[d].size(); i++) {
+                if (nodesAtDepth[d][i]->getDepth() == d) nNodes++;
+            }
+        }
+        REQUIRE( nNodes == tree.getNNodes() );
+
+        std::vector<MWNode<D> *> endNodes;
+        REQUIRE( stree->makeEndNodeTable(endNodes) );
+        REQUIRE( endNodes == refEndNodes );
+        REQUIRE( *tree.getEndNodeTable() == refEndNodes );
+    }
+    finalize(&mra);
+    finalize(&func);
+}
+
+/* Siblings released by different threads: exactly one of them must see the
+ * whole group as free, otherwise the group ends up on two free-lists. */
+TEST_CASE("Releasing sibling groups from several threads", "[serial_tree_release], [serial_tree], [trees]") {
+    const int tDim = 8;
+    const int nodesPerChunk = 4096;
+    const int nChunks = 4;
+    const int nGroups = nChunks*nodesPerChunk/tDim;
+
+    NodeOccupancy occupancy;
+    occupancy.setChunkSize(nodesPerChunk);
+    for (int c = 0; c < nChunks; c++) {
+        occupancy.addChunk();
+    }
+
+    for (int n = 0; n < 10; n++) {
+        occupancy.setOccupied(0, nChunks*nodesPerChunk);
+        std::vector<int> nReleased(nGroups, 0);
+#pragma omp parallel for schedule(static, 1)
+        for (int sIx = 0; sIx < nChunks*nodesPerChunk; sIx++) {
+            int first = sIx - sIx%tDim;
+            if (occupancy.setFreeInRun(sIx, first, tDim)) {
+#pragma omp atomic
+                nReleased[sIx/tDim]++;
+            }
+        }
+        int nWrong = 0;
+        for (int g = 0; g < nGroups; g++) {
+            if (nReleased[g] != 1) nWrong++;
+        }
+        REQUIRE( nWrong == 0 );
+        REQUIRE( occupancy.isFree(0, tDim) );
+    }
+}
+
+/* Micro-benchmark for concurrent node allocation. Hidden from the default
+ * test run, execute with: unit_tests.x "[.benchmark]" */
+TEST_CASE("Thread scaling of SerialFunctionTree node allocation", "[.benchmark], [serial_tree]") {
+    MultiResolutionAnalysis<3> *mra = 0;
+    initialize(&mra);
+
+    const int depth = 3;
+    const int nRepeat = 10;
+    for (int nThreads = 1; nThreads <= omp_get_max_threads(); nThreads *= 2) {
+        int nNodes = 0;
+        int nGenNodes = 0;
+        Timer timer;
+        for (int n = 0; n < nRepeat; n++) {
+            FunctionTree<3> tree(*mra);
+            for (int d = 0; d < depth; d++) {
+                std::vector<MWNode<3> *> nodes = *tree.getEndNodeTable();
+                int nEnd = nodes.size();
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+                for (int i = 0; i < nEnd; i++) {
+                    nodes[i]->createChildren();
+                }
+                tree.resetEndNodeTable();
+            }
+            std::vector<MWNode<3> *> &nodes = *tree.getEndNodeTable();
+            int nEnd = nodes.size();
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+            for (int i = 0; i < nEnd; i++) {
+                nodes[i]->genChildren();
+            }
+            nNodes = tree.getNNodes();
+            nGenNodes = tree.getNGenNodes();
+            tree.deleteGenerated();
+        }
+        timer.stop();
+        println(0, "threads " << nThreads << "  nodes " << nNodes << "  gen nodes " << nGenNodes << "  time " << timer.getWallTime());
+
+        int nRoots = mra->getWorldBox().size();
+        REQUIRE( nNodes == nRoots*(1 + 8 + 64 + 512) );
+        REQUIRE( nGenNodes == nRoots*512*8 );
+    }
+    finalize(&mra);
+}
+
+} // namespace